@@ -22,10 +22,14 @@
  */
 
 #include "adapter.h"
+#include "adapter_internal.h"
 #include "device.h"
 #include "device_internal.h"
+#include "device_index.h"
+#include "scan_table.h"
 #include "logger.h"
 #include "utility.h"
+#include "dbus_transport.h"
 #include "advertisement.h"
 #include "application.h"
 
@@ -33,6 +37,7 @@ static const char *const TAG = "Adapter";
 static const char *const BLUEZ_DBUS = "org.bluez";
 static const char *const INTERFACE_ADAPTER = "org.bluez.Adapter1";
 static const char *const INTERFACE_DEVICE = "org.bluez.Device1";
+static const char *const INTERFACE_CHARACTERISTIC = "org.bluez.GattCharacteristic1";
 static const char *const INTERFACE_OBJECT_MANAGER = "org.freedesktop.DBus.ObjectManager";
 static const char *const INTERFACE_GATT_MANAGER = "org.bluez.GattManager1";
 static const char *const INTERFACE_PROPERTIES = "org.freedesktop.DBus.Properties";
@@ -40,6 +45,7 @@ static const char *const INTERFACE_PROPERTIES = "org.freedesktop.DBus.Properties
 static const char *const METHOD_START_DISCOVERY = "StartDiscovery";
 static const char *const METHOD_STOP_DISCOVERY = "StopDiscovery";
 static const char *const METHOD_REMOVE_DEVICE = "RemoveDevice";
+static const char *const METHOD_DISCONNECT = "Disconnect";
 static const char *const METHOD_SET_DISCOVERY_FILTER = "SetDiscoveryFilter";
 
 static const char *const ADAPTER_PROPERTY_POWERED = "Powered";
@@ -54,10 +60,23 @@ static const char *const DEVICE_PROPERTY_RSSI = "RSSI";
 static const char *const DEVICE_PROPERTY_UUIDS = "UUIDs";
 static const char *const DEVICE_PROPERTY_MANUFACTURER_DATA = "ManufacturerData";
 static const char *const DEVICE_PROPERTY_SERVICE_DATA = "ServiceData";
+static const char *const DEVICE_PROPERTY_TXPOWER = "TxPower";
+static const char *const DEVICE_PROPERTY_ADDRESS = "Address";
+static const char *const DEVICE_PROPERTY_ADVERTISING_DATA = "AdvertisingData";
+static const char *const DEVICE_PROPERTY_ADVERTISING_FLAGS = "AdvertisingFlags";
 
 static const char *const SIGNAL_PROPERTIES_CHANGED = "PropertiesChanged";
 
 static const guint MAC_ADDRESS_LENGTH = 17;
+static const guint DISCOVERY_DISPATCH_BATCH_SIZE = 16;
+static const guint DISCOVERY_SHEDDING_SAMPLE_RATE = 10;
+static const guint DEFAULT_BULK_REMOVAL_WINDOW = 8;
+static const guint ADAPTIVE_DISCOVERY_MIN_WINDOW_MS = 500;
+static const guint ADAPTIVE_DISCOVERY_MIN_OFF_MS = 1000;
+static const guint ADAPTIVE_DISCOVERY_WINDOW_MARGIN = 2;
+static const guint PROPERTY_FETCH_DELAY_MS = 20;
+static const guint PROPERTY_FETCH_BATCH_THRESHOLD = 32;
+static const guint PROPERTY_FETCH_WINDOW = 8;
 
 static const char *discovery_state_names[] = {
         [BINC_DISCOVERY_STOPPED] = "stopped",
@@ -72,6 +91,45 @@ typedef struct binc_discovery_filter {
     const char *pattern;
 } DiscoveryFilter;
 
+struct binc_discovery_session {
+    Adapter *adapter; // Borrowed
+    DiscoveryFilter filter;
+    DiscoverySessionResultCallback callback;
+    gboolean removed;
+    void *user_data; // Borrowed
+};
+
+typedef struct binc_discovery_event {
+    char *path; // Owned
+    GVariant *parameters; // Owned
+    gint64 queued_at;
+} DiscoveryEvent;
+
+typedef struct binc_load_shedding {
+    guint max_queue_depth;
+    gint64 max_lag;
+    gboolean overloaded;
+    guint sample_counter;
+    guint64 shed_count;
+    GHashTable *exempt_addresses; // Owned
+} LoadShedding;
+
+typedef struct binc_adaptive_discovery {
+    guint target_latency;
+    guint window;
+    guint period;
+    gboolean scanning;
+    guint timeout_id;
+    GHashTable *watched_addresses; // Owned
+} AdaptiveDiscovery;
+
+typedef struct binc_discovery_candidate {
+    Device *device; // Borrowed
+    short rssi;
+    const char *name; // Borrowed
+    const char *address; // Borrowed
+} DiscoveryCandidate;
+
 struct binc_adapter {
     const char *path; // Owned
     const char *address; // Owned
@@ -83,9 +141,17 @@ struct binc_adapter {
     gboolean discovering;
     DiscoveryState discovery_state;
     DiscoveryFilter discovery_filter;
+    GList *discovery_sessions; // Owned
+    gboolean delivering_discovery_result;
+    GQueue *discovery_events; // Owned
+    guint discovery_dispatch_id;
+    gint discovery_priority;
+    LoadShedding load_shedding;
+    AdaptiveDiscovery adaptive_discovery;
 
     GDBusConnection *connection;  // Borrowed
     guint device_prop_changed;
+    guint char_prop_changed;
     guint adapter_prop_changed;
     guint iface_added;
     guint iface_removed;
@@ -94,9 +160,19 @@ struct binc_adapter {
     AdapterDeviceRemovalCallback deviceRemovalCallback;
     AdapterDiscoveryStateChangeCallback discoveryStateCallback;
     AdapterPoweredStateChangeCallback poweredStateCallback;
+    AdapterLoadSheddingCallback loadSheddingCallback;
     RemoteCentralConnectionStateCallback centralStateCallback;
     void *user_data; // Borrowed
     GHashTable *devices_cache; // Owned
+    DeviceIndex *device_index; // Owned
+    ScanTable *scan_table; // Owned
+    GHashTable *pending_property_fetches; // Owned
+    guint property_fetch_id;
+    guint property_fetches_in_flight;
+    GCancellable *cancellable; // Owned
+    guint pending_calls;
+    gboolean freed;
+    guint admin_sockets;
 
     Advertisement *advertisement; // Borrowed
 };
@@ -104,42 +180,128 @@ struct binc_adapter {
 static void remove_signal_subscribers(Adapter *adapter) {
     g_assert(adapter != NULL);
 
-    g_dbus_connection_signal_unsubscribe(adapter->connection, adapter->device_prop_changed);
-    adapter->device_prop_changed = 0;
-    g_dbus_connection_signal_unsubscribe(adapter->connection, adapter->adapter_prop_changed);
-    adapter->adapter_prop_changed = 0;
-    g_dbus_connection_signal_unsubscribe(adapter->connection, adapter->iface_added);
-    adapter->iface_added = 0;
-    g_dbus_connection_signal_unsubscribe(adapter->connection, adapter->iface_removed);
-    adapter->iface_removed = 0;
+    // Called again from binc_adapter_free() after a shutdown, so skip what is already unsubscribed
+    guint *subscriptions[] = {&adapter->device_prop_changed, &adapter->char_prop_changed,
+                              &adapter->adapter_prop_changed, &adapter->iface_added, &adapter->iface_removed};
+    for (guint i = 0; i < G_N_ELEMENTS(subscriptions); i++) {
+        if (*subscriptions[i] != 0) {
+            binc_dbus_signal_unsubscribe(adapter->connection, *subscriptions[i]);
+            *subscriptions[i] = 0;
+        }
+    }
 }
 
-static void free_discovery_filter(Adapter *adapter) {
-    g_assert(adapter != NULL);
+static void free_discovery_filter(DiscoveryFilter *filter) {
+    g_assert(filter != NULL);
 
-    if (adapter->discovery_filter.services != NULL) {
-        for (guint i = 0; i < adapter->discovery_filter.services->len; i++) {
-            char *uuid_filter = g_ptr_array_index(adapter->discovery_filter.services, i);
+    if (filter->services != NULL) {
+        for (guint i = 0; i < filter->services->len; i++) {
+            char *uuid_filter = g_ptr_array_index(filter->services, i);
             g_free(uuid_filter);
         }
-        g_ptr_array_free(adapter->discovery_filter.services, TRUE);
-        adapter->discovery_filter.services = NULL;
+        g_ptr_array_free(filter->services, TRUE);
+        filter->services = NULL;
     }
 
-    if (adapter->discovery_filter.pattern != NULL) {
-        g_free((char *) adapter->discovery_filter.pattern);
-        adapter->discovery_filter.pattern = NULL;
+    if (filter->pattern != NULL) {
+        g_free((char *) filter->pattern);
+        filter->pattern = NULL;
+    }
+}
+
+static void init_discovery_filter(DiscoveryFilter *filter, short rssi_threshold, const GPtrArray *service_uuids,
+                                  const char *pattern) {
+    g_assert(filter != NULL);
+
+    filter->services = g_ptr_array_new();
+    filter->rssi = rssi_threshold;
+    filter->pattern = g_strdup(pattern);
+
+    if (service_uuids != NULL) {
+        for (guint i = 0; i < service_uuids->len; i++) {
+            char *uuid = g_ptr_array_index(service_uuids, i);
+            g_assert(g_uuid_string_is_valid(uuid));
+            g_ptr_array_add(filter->services, g_strdup(uuid));
+        }
     }
 }
 
+static void discovery_event_free(DiscoveryEvent *event) {
+    g_assert(event != NULL);
+
+    g_free(event->path);
+    event->path = NULL;
+    g_variant_unref(event->parameters);
+    event->parameters = NULL;
+    g_free(event);
+}
+
+static void discovery_session_free(DiscoverySession *session) {
+    g_assert(session != NULL);
+
+    free_discovery_filter(&session->filter);
+    session->adapter = NULL;
+    g_free(session);
+}
+
+// Stop everything the adapter would still do by itself, so it doesn't call bluetoothd anymore
+static void stop_background_work(Adapter *adapter) {
+    remove_signal_subscribers(adapter);
+
+    if (adapter->discovery_dispatch_id != 0) {
+        g_source_remove(adapter->discovery_dispatch_id);
+        adapter->discovery_dispatch_id = 0;
+    }
+
+    if (adapter->property_fetch_id != 0) {
+        g_source_remove(adapter->property_fetch_id);
+        adapter->property_fetch_id = 0;
+    }
+
+    // A GetAll reply would schedule the fetch of the remaining devices again
+    g_hash_table_remove_all(adapter->pending_property_fetches);
+
+    if (adapter->adaptive_discovery.timeout_id != 0) {
+        g_source_remove(adapter->adaptive_discovery.timeout_id);
+        adapter->adaptive_discovery.timeout_id = 0;
+    }
+
+    g_cancellable_cancel(adapter->cancellable);
+}
+
 void binc_adapter_free(Adapter *adapter) {
     g_assert(adapter != NULL);
+    g_assert(adapter->admin_sockets == 0);
 
-    remove_signal_subscribers(adapter);
+    stop_background_work(adapter);
+
+    if (adapter->discovery_events != NULL) {
+        g_queue_free_full(adapter->discovery_events, (GDestroyNotify) discovery_event_free);
+        adapter->discovery_events = NULL;
+    }
+
+    if (adapter->pending_property_fetches != NULL) {
+        g_hash_table_destroy(adapter->pending_property_fetches);
+        adapter->pending_property_fetches = NULL;
+    }
+
+    if (adapter->adaptive_discovery.watched_addresses != NULL) {
+        g_hash_table_destroy(adapter->adaptive_discovery.watched_addresses);
+        adapter->adaptive_discovery.watched_addresses = NULL;
+    }
+
+    if (adapter->load_shedding.exempt_addresses != NULL) {
+        g_hash_table_destroy(adapter->load_shedding.exempt_addresses);
+        adapter->load_shedding.exempt_addresses = NULL;
+    }
 
     if (adapter->discovery_filter.services != NULL) {
-        free_discovery_filter(adapter);
-        adapter->discovery_filter.services = NULL;
+        free_discovery_filter(&adapter->discovery_filter);
+    }
+
+    if (adapter->discovery_sessions != NULL) {
+        g_list_free_full(adapter->discovery_sessions, (GDestroyNotify) discovery_session_free);
+        adapter->discovery_sessions = NULL;
     }
 
     if (adapter->devices_cache != NULL) {
@@ -147,6 +309,16 @@ void binc_adapter_free(Adapter *adapter) {
         adapter->devices_cache = NULL;
     }
 
+    if (adapter->device_index != NULL) {
+        binc_device_index_free(adapter->device_index);
+        adapter->device_index = NULL;
+    }
+
+    if (adapter->scan_table != NULL) {
+        binc_scan_table_free(adapter->scan_table);
+        adapter->scan_table = NULL;
+    }
+
     g_free((char *) adapter->path);
     adapter->path = NULL;
 
@@ -158,8 +330,162 @@ void binc_adapter_free(Adapter *adapter) {
         adapter->alias = NULL;
     }
 
-    adapter->connection = NULL;
-    g_free(adapter);
+    // The calls were cancelled, but their callbacks still use the adapter so it is freed when the last one is done
+    g_object_unref(adapter->cancellable);
+    adapter->cancellable = NULL;
+    adapter->freed = TRUE;
+    if (adapter->pending_calls == 0) {
+        g_free(adapter);
+    }
+}
+
+// Returns FALSE if the adapter was freed while the call was in flight, the reply is released then
+static gboolean binc_internal_adapter_call_done(Adapter *adapter, GVariant *value, GError **error) {
+    g_assert(adapter->pending_calls > 0);
+
+    adapter->pending_calls--;
+    if (!adapter->freed) return TRUE;
+
+    if (value != NULL) {
+        g_variant_unref(value);
+    }
+    g_clear_error(error);
+    if (adapter->pending_calls == 0) {
+        g_free(adapter);
+    }
+    return FALSE;
+}
+
+typedef struct binc_adapter_shutdown {
+    Adapter *adapter; // Owned until the teardown is finished
+    GDBusConnection *connection; // Borrowed
+    gint64 started_at;
+    guint deadline_id;
+    guint in_flight;
+    guint disconnected;
+    guint failed;
+    gboolean finished;
+    AdapterShutdownCallback callback;
+    void *user_data; // Borrowed
+} AdapterShutdown;
+
+static void finish_shutdown(AdapterShutdown *shutdown) {
+    if (shutdown->finished) return;
+    shutdown->finished = TRUE;
+
+    if (shutdown->deadline_id != 0) {
+        g_source_remove(shutdown->deadline_id);
+        shutdown->deadline_id = 0;
+    }
+
+    // The cache is destroyed in one pass and the index and scan table are freed as a whole, without per device
+    // maintenance. The only per device work left are the signals of devices that didn't disconnect in time, and
+    // those must be unsubscribed because they would be delivered to freed devices otherwise.
+    binc_adapter_free(shutdown->adapter);
+    shutdown->adapter = NULL;
+
+    guint elapsed = (guint) ((g_get_monotonic_time() - shutdown->started_at) / G_TIME_SPAN_MILLISECOND);
+    log_debug(TAG, "shutdown took %u ms, %u disconnected, %u failed, %u timed out", elapsed,
+              shutdown->disconnected, shutdown->failed, shutdown->in_flight);
+    if (shutdown->callback != NULL) {
+        shutdown->callback(shutdown->disconnected, shutdown->failed, shutdown->in_flight, elapsed,
+                           shutdown->user_data);
+    }
+
+    // Replies that arrive after the deadline still need the shutdown
+    if (shutdown->in_flight == 0) {
+        g_free(shutdown);
+    }
+}
+
+static gboolean binc_internal_shutdown_deadline(gpointer user_data) {
+    AdapterShutdown *shutdown = (AdapterShutdown *) user_data;
+    g_assert(shutdown != NULL);
+
+    shutdown->deadline_id = 0;
+    finish_shutdown(shutdown);
+    return G_SOURCE_REMOVE;
+}
+
+static void binc_internal_shutdown_disconnect_cb(__attribute__((unused)) GObject *source_object,
+                                                 GAsyncResult *res,
+                                                 gpointer user_data) {
+    AdapterShutdown *shutdown = (AdapterShutdown *) user_data;
+    g_assert(shutdown != NULL);
+
+    GError *error = NULL;
+    GVariant *value = binc_dbus_call_finish(shutdown->connection, res, &error);
+    if (value != NULL) {
+        g_variant_unref(value);
+    }
+
+    shutdown->in_flight--;
+    if (shutdown->finished) {
+        g_clear_error(&error);
+        if (shutdown->in_flight == 0) {
+            g_free(shutdown);
+        }
+        return;
+    }
+
+    if (error != NULL) {
+        log_debug(TAG, "failed to call '%s' (error %d: %s)", METHOD_DISCONNECT, error->code, error->message);
+        g_clear_error(&error);
+        shutdown->failed++;
+    } else {
+        shutdown->disconnected++;
+    }
+
+    if (shutdown->in_flight == 0) {
+        finish_shutdown(shutdown);
+    }
+}
+
+void binc_adapter_shutdown(Adapter *adapter, guint deadline_ms, AdapterShutdownCallback callback, void *user_data) {
+    g_assert(adapter != NULL);
+    g_assert(adapter->admin_sockets == 0);
+    g_assert(deadline_ms > 0);
+
+    AdapterShutdown *shutdown = g_new0(AdapterShutdown, 1);
+    shutdown->adapter = adapter;
+    shutdown->connection = adapter->connection;
+    shutdown->started_at = g_get_monotonic_time();
+    shutdown->callback = callback;
+    shutdown->user_data = user_data;
+
+    // No more signals, timers or calls for this adapter, so the cache doesn't change while we are tearing down
+    stop_background_work(adapter);
+
+    // Disconnect all devices at once instead of one after another
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, adapter->devices_cache);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Device *device = (Device *) value;
+        ConnectionState state = binc_device_get_connection_state(device);
+        if (state == BINC_CONNECTED || state == BINC_CONNECTING) {
+            shutdown->in_flight++;
+            binc_dbus_call(adapter->connection,
+                           BLUEZ_DBUS,
+                           binc_device_get_path(device),
+                           INTERFACE_DEVICE,
+                           METHOD_DISCONNECT,
+                           NULL,
+                           NULL,
+                           G_DBUS_CALL_FLAGS_NONE,
+                           (gint) deadline_ms,
+                           NULL,
+                           (GAsyncReadyCallback) binc_internal_shutdown_disconnect_cb,
+                           shutdown);
+        }
+    }
+
+    log_debug(TAG, "shutting down adapter '%s', disconnecting %u devices", adapter->path, shutdown->in_flight);
+    if (shutdown->in_flight == 0) {
+        finish_shutdown(shutdown);
+        return;
+    }
+    shutdown->deadline_id = g_timeout_add(deadline_ms, binc_internal_shutdown_deadline, shutdown);
 }
 
 static void binc_internal_adapter_call_method_cb(__attribute__((unused)) GObject *source_object,
@@ -169,7 +495,8 @@ static void binc_internal_adapter_call_method_cb(__attribute__((unused)) GObject
     g_assert(adapter != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(adapter->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(adapter->connection, res, &error);
+    if (!binc_internal_adapter_call_done(adapter, value, &error)) return;
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -184,18 +511,19 @@ static void binc_internal_adapter_call_method(Adapter *adapter, const char *meth
     g_assert(adapter != NULL);
     g_assert(method != NULL);
 
-    g_dbus_connection_call(adapter->connection,
-                           BLUEZ_DBUS,
-                           adapter->path,
-                           INTERFACE_ADAPTER,
-                           method,
-                           parameters,
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_adapter_call_method_cb,
-                           adapter);
+    adapter->pending_calls++;
+    binc_dbus_call(adapter->connection,
+                   BLUEZ_DBUS,
+                   adapter->path,
+                   INTERFACE_ADAPTER,
+                   method,
+                   parameters,
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   adapter->cancellable,
+                   (GAsyncReadyCallback) binc_internal_adapter_call_method_cb,
+                   adapter);
 }
 
 static void binc_internal_set_discovery_state(Adapter *adapter, DiscoveryState discovery_state) {
@@ -203,6 +531,12 @@ static void binc_internal_set_discovery_state(Adapter *adapter, DiscoveryState d
     if (adapter->discovery_state == discovery_state) return;
 
     adapter->discovery_state = discovery_state;
+
+    // Advertisements from different scan periods must not be used to estimate advertising intervals
+    if (discovery_state == BINC_DISCOVERY_STARTED) {
+        binc_scan_table_start_epoch(adapter->scan_table);
+    }
+
     if (adapter->discoveryStateCallback != NULL) {
         adapter->discoveryStateCallback(adapter, adapter->discovery_state, NULL);
     }
@@ -257,30 +591,30 @@ static void binc_internal_adapter_changed(__attribute__((unused)) GDBusConnectio
         g_variant_iter_free(properties_invalidated);
 }
 
-static gboolean matches_discovery_filter(Adapter *adapter, Device *device) {
-    g_assert(adapter != NULL);
-    g_assert(device != NULL);
+static gboolean matches_discovery_filter(const DiscoveryFilter *filter, const DiscoveryCandidate *candidate) {
+    g_assert(filter != NULL);
+    g_assert(candidate != NULL);
 
-    if (binc_device_get_rssi(device) < adapter->discovery_filter.rssi) return FALSE;
+    if (candidate->rssi < filter->rssi) return FALSE;
 
-    const char *pattern = adapter->discovery_filter.pattern;
+    const char *pattern = filter->pattern;
     if (pattern != NULL) {
-        const char *name = binc_device_get_name(device);
-        const char *addr = binc_device_get_address(device);
+        const char *name = candidate->name;
+        const char *addr = candidate->address;
         gboolean name_matches = (name != NULL) && g_str_has_prefix(name, pattern);
         gboolean addr_matches = (addr != NULL) && g_str_has_prefix(addr, pattern);
         if (!(name_matches || addr_matches))
             return FALSE;
     }
 
-    GPtrArray *services_filter = adapter->discovery_filter.services;
+    GPtrArray *services_filter = filter->services;
     if (services_filter != NULL) {
         guint count = services_filter->len;
         if (count == 0) return TRUE;
 
         for (guint i = 0; i < count; i++) {
             const char *uuid_filter = g_ptr_array_index(services_filter, i);
-            if (binc_device_has_service(device, uuid_filter)) {
+            if (binc_device_has_service(candidate->device, uuid_filter)) {
                 return TRUE;
             }
         }
@@ -289,18 +623,95 @@ static gboolean matches_discovery_filter(Adapter *adapter, Device *device) {
     return TRUE;
 }
 
+static void purge_removed_discovery_sessions(Adapter *adapter) {
+    GList *iterator = adapter->discovery_sessions;
+    while (iterator != NULL) {
+        GList *next = iterator->next;
+        DiscoverySession *session = (DiscoverySession *) iterator->data;
+        if (session->removed) {
+            adapter->discovery_sessions = g_list_delete_link(adapter->discovery_sessions, iterator);
+            discovery_session_free(session);
+        }
+        iterator = next;
+    }
+}
+
 static void deliver_discovery_result(Adapter *adapter, Device *device) {
     g_assert(adapter != NULL);
     g_assert(device != NULL);
 
-    if (binc_device_get_connection_state(device) == BINC_DISCONNECTED) {
-        // Double check if the device matches the discovery filter
-        if (!matches_discovery_filter(adapter, device)) return;
+    if (binc_device_get_connection_state(device) != BINC_DISCONNECTED) return;
+
+    // Look up the device properties once and evaluate every filter against them
+    DiscoveryCandidate candidate = {
+            .device = device,
+            .rssi = binc_device_get_rssi(device),
+            .name = binc_device_get_name(device),
+            .address = binc_device_get_address(device)
+    };
 
-        if (adapter->discoveryResultCallback != NULL) {
-            adapter->discoveryResultCallback(adapter, device);
+    adapter->delivering_discovery_result = TRUE;
+
+    // Double check if the device matches the discovery filter
+    if (adapter->discoveryResultCallback != NULL && matches_discovery_filter(&adapter->discovery_filter, &candidate)) {
+        adapter->discoveryResultCallback(adapter, device);
+    }
+
+    for (GList *iterator = adapter->discovery_sessions; iterator; iterator = iterator->next) {
+        DiscoverySession *session = (DiscoverySession *) iterator->data;
+        if (!session->removed && matches_discovery_filter(&session->filter, &candidate)) {
+            session->callback(adapter, session, device);
         }
     }
+
+    // Sessions removed from within a callback are only freed once we are done iterating
+    adapter->delivering_discovery_result = FALSE;
+    purge_removed_discovery_sessions(adapter);
+}
+
+static void binc_internal_update_device_property(Adapter *adapter, Device *device,
+                                                const char *property_name, GVariant *property_value) {
+    g_assert(adapter != NULL);
+    g_assert(device != NULL);
+
+    binc_internal_device_update_property(device, property_name, property_value);
+
+    // Keep the query indexes in sync with the properties they are built on
+    if (g_str_equal(property_name, DEVICE_PROPERTY_RSSI)) {
+        binc_device_index_update_rssi(adapter->device_index, device);
+        binc_scan_table_update_rssi(adapter->scan_table, device);
+    } else if (g_str_equal(property_name, DEVICE_PROPERTY_MANUFACTURER_DATA)) {
+        binc_device_index_update_manufacturer_data(adapter->device_index, device);
+        binc_scan_table_update_payload(adapter->scan_table, device);
+    } else if (g_str_equal(property_name, DEVICE_PROPERTY_SERVICE_DATA) ||
+               g_str_equal(property_name, DEVICE_PROPERTY_ADVERTISING_DATA)) {
+        binc_scan_table_update_payload(adapter->scan_table, device);
+    } else if (g_str_equal(property_name, DEVICE_PROPERTY_UUIDS)) {
+        binc_device_index_update_services(adapter->device_index, device);
+    } else if (g_str_equal(property_name, DEVICE_PROPERTY_TXPOWER)) {
+        binc_scan_table_update_tx_power(adapter->scan_table, device);
+    } else if (g_str_equal(property_name, DEVICE_PROPERTY_ADDRESS)) {
+        binc_scan_table_update_address(adapter->scan_table, device);
+    }
+}
+
+static void cache_device(Adapter *adapter, Device *device) {
+    g_assert(adapter != NULL);
+    g_assert(device != NULL);
+
+    // A device that replaces a known device keeps its id
+    const char *path = binc_device_get_path(device);
+    Device *existing = g_hash_table_lookup(adapter->devices_cache, path);
+    if (existing != NULL) {
+        binc_device_index_remove(adapter->device_index, existing);
+        guint id = binc_device_get_id(existing);
+        binc_scan_table_replace(adapter->scan_table, id, device);
+        binc_device_set_id(device, id);
+    } else {
+        binc_device_set_id(device, binc_scan_table_add(adapter->scan_table, device));
+    }
+
+    g_hash_table_insert(adapter->devices_cache, g_strdup(path), device);
 }
 
 static void deliver_device_removal(Adapter *adapter, Device *device) {
@@ -312,6 +723,17 @@ static void deliver_device_removal(Adapter *adapter, Device *device) {
    }
 }
 
+static void purge_device(Adapter *adapter, const char *device_path) {
+    Device *device = g_hash_table_lookup(adapter->devices_cache, device_path);
+    if (device != NULL) {
+        deliver_device_removal(adapter, device);
+        binc_device_index_remove(adapter->device_index, device);
+        binc_scan_table_remove(adapter->scan_table, binc_device_get_id(device));
+        g_hash_table_remove(adapter->pending_property_fetches, device_path);
+        g_hash_table_remove(adapter->devices_cache, device_path);
+    }
+}
+
 static void binc_internal_device_disappeared(__attribute__((unused)) GDBusConnection *conn,
                                              __attribute__((unused)) const gchar *sender_name,
                                              __attribute__((unused)) const gchar *object_path,
@@ -333,11 +755,7 @@ static void binc_internal_device_disappeared(__attribute__((unused)) GDBusConnec
         if (g_str_equal(interface_name, INTERFACE_DEVICE)) {
             log_debug(TAG, "Device %s removed", object);
 
-            Device *device = g_hash_table_lookup(adapter->devices_cache, object);
-            if (device != NULL) {
-  	            deliver_device_removal(adapter, device);
-                g_hash_table_remove(adapter->devices_cache, object);
-            }
+            purge_device(adapter, object);
         }
     }
 
@@ -371,19 +789,16 @@ static void binc_internal_device_appeared(__attribute__((unused)) GDBusConnectio
                 break;
 
             Device *device = binc_device_create(object, adapter);
+            cache_device(adapter, device);
 
             char *property_name = NULL;
             GVariantIter iter;
             GVariant *property_value = NULL;
             g_variant_iter_init(&iter, properties);
             while (g_variant_iter_loop(&iter, "{&sv}", &property_name, &property_value)) {
-                binc_internal_device_update_property(device, property_name, property_value);
+                binc_internal_update_device_property(adapter, device, property_name, property_value);
             }
 
-            g_hash_table_insert(adapter->devices_cache,
-                                g_strdup(binc_device_get_path(device)),
-                                device);
-
             if (adapter->discovery_state == BINC_DISCOVERY_STARTED && binc_device_get_connection_state(device) == BINC_DISCONNECTED) {
                 deliver_discovery_result(adapter, device);
             }
@@ -403,30 +818,133 @@ static void binc_internal_device_appeared(__attribute__((unused)) GDBusConnectio
         g_variant_iter_free(interfaces);
 }
 
+typedef struct binc_property_fetch {
+    Adapter *adapter; // Borrowed
+    GHashTable *paths; // Owned
+} PropertyFetch;
+
+static void property_fetch_free(PropertyFetch *fetch) {
+    g_hash_table_destroy(fetch->paths);
+    g_free(fetch);
+}
+
+static void apply_device_properties(Adapter *adapter, const char *path, GVariant *properties) {
+    // The device may have been removed while its properties were being fetched
+    Device *device = g_hash_table_lookup(adapter->devices_cache, path);
+    if (device == NULL) return;
+
+    const char *property_name = NULL;
+    GVariant *property_value = NULL;
+    GVariantIter iter;
+    g_variant_iter_init(&iter, properties);
+    while (g_variant_iter_loop(&iter, "{&sv}", &property_name, &property_value)) {
+        binc_internal_update_device_property(adapter, device, property_name, property_value);
+    }
+}
+
+static void schedule_property_fetch(Adapter *adapter);
+
 static void binc_internal_device_getall_properties_cb(__attribute__((unused)) GObject *source_object,
                                                       GAsyncResult *res,
                                                       gpointer user_data) {
 
-    Device *device = (Device *) user_data;
-    g_assert(device != NULL);
+    PropertyFetch *fetch = (PropertyFetch *) user_data;
+    g_assert(fetch != NULL);
+    Adapter *adapter = fetch->adapter;
 
     GError *error = NULL;
-    GVariant *result = g_dbus_connection_call_finish(binc_device_get_dbus_connection(device), res, &error);
+    GVariant *result = binc_dbus_call_finish(adapter->connection, res, &error);
+    adapter->property_fetches_in_flight--;
+    if (!binc_internal_adapter_call_done(adapter, result, &error)) {
+        property_fetch_free(fetch);
+        return;
+    }
 
     if (error != NULL) {
         log_error(TAG, "failed to call '%s' (error %d: %s)", "GetAll", error->code, error->message);
         g_clear_error(&error);
     }
 
+    if (result != NULL) {
+        g_assert(g_str_equal(g_variant_get_type_string(result), "(a{sv})"));
+        GVariant *properties = g_variant_get_child_value(result, 0);
+
+        GHashTableIter iter;
+        gpointer path;
+        g_hash_table_iter_init(&iter, fetch->paths);
+        while (g_hash_table_iter_next(&iter, &path, NULL)) {
+            apply_device_properties(adapter, (const char *) path, properties);
+        }
+
+        g_variant_unref(properties);
+        g_variant_unref(result);
+    }
+    property_fetch_free(fetch);
+
+    // Devices that didn't fit in the window are still waiting
+    if (g_hash_table_size(adapter->pending_property_fetches) > 0) {
+        schedule_property_fetch(adapter);
+    }
+}
+
+static void binc_internal_device_getall_properties(Adapter *adapter, const char *path) {
+    PropertyFetch *fetch = g_new0(PropertyFetch, 1);
+    fetch->adapter = adapter;
+    fetch->paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g_hash_table_add(fetch->paths, g_strdup(path));
+
+    adapter->pending_calls++;
+    adapter->property_fetches_in_flight++;
+    binc_dbus_call(adapter->connection,
+                   BLUEZ_DBUS,
+                   path,
+                   INTERFACE_PROPERTIES,
+                   "GetAll",
+                   g_variant_new("(s)", INTERFACE_DEVICE),
+                   G_VARIANT_TYPE("(a{sv})"),
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   adapter->cancellable,
+                   (GAsyncReadyCallback) binc_internal_device_getall_properties_cb,
+                   fetch);
+}
+
+static void binc_internal_managed_devices_cb(__attribute__((unused)) GObject *source_object,
+                                             GAsyncResult *res,
+                                             gpointer user_data) {
+
+    PropertyFetch *fetch = (PropertyFetch *) user_data;
+    g_assert(fetch != NULL);
+    Adapter *adapter = fetch->adapter;
+
+    GError *error = NULL;
+    GVariant *result = binc_dbus_call_finish(adapter->connection, res, &error);
+    if (!binc_internal_adapter_call_done(adapter, result, &error)) {
+        property_fetch_free(fetch);
+        return;
+    }
+
+    if (error != NULL) {
+        log_error(TAG, "failed to call '%s' (error %d: %s)", "GetManagedObjects", error->code, error->message);
+        g_clear_error(&error);
+    }
+
     if (result != NULL) {
         GVariantIter *iter = NULL;
-        const char *property_name = NULL;
-        GVariant *property_value = NULL;
+        const char *object_path = NULL;
+        GVariant *ifaces_and_properties = NULL;
 
-        g_assert(g_str_equal(g_variant_get_type_string(result), "(a{sv})"));
-        g_variant_get(result, "(a{sv})", &iter);
-        while (g_variant_iter_loop(iter, "{&sv}", &property_name, &property_value)) {
-            binc_internal_device_update_property(device, property_name, property_value);
+        g_assert(g_str_equal(g_variant_get_type_string(result), "(a{oa{sa{sv}}})"));
+        g_variant_get(result, "(a{oa{sa{sv}}})", &iter);
+        while (g_variant_iter_loop(iter, "{&o@a{sa{sv}}}", &object_path, &ifaces_and_properties)) {
+            if (!g_hash_table_contains(fetch->paths, object_path)) continue;
+
+            GVariant *properties = g_variant_lookup_value(ifaces_and_properties, INTERFACE_DEVICE,
+                                                          G_VARIANT_TYPE("a{sv}"));
+            if (properties != NULL) {
+                apply_device_properties(adapter, object_path, properties);
+                g_variant_unref(properties);
+            }
         }
 
         if (iter != NULL) {
@@ -434,23 +952,249 @@ static void binc_internal_device_getall_properties_cb(__attribute__((unused)) GO
         }
         g_variant_unref(result);
     }
+    property_fetch_free(fetch);
 }
 
-static void binc_internal_device_getall_properties(Adapter *adapter, Device *device) {
-    g_dbus_connection_call(adapter->connection,
-                           BLUEZ_DBUS,
-                           binc_device_get_path(device),
-                           INTERFACE_PROPERTIES,
-                           "GetAll",
-                           g_variant_new("(s)", INTERFACE_DEVICE),
-                           G_VARIANT_TYPE("(a{sv})"),
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_device_getall_properties_cb,
-                           device);
+static gboolean binc_internal_fetch_pending_properties(gpointer user_data) {
+    Adapter *adapter = (Adapter *) user_data;
+    g_assert(adapter != NULL);
+
+    adapter->property_fetch_id = 0;
+    guint count = g_hash_table_size(adapter->pending_property_fetches);
+
+    // Getting all objects of bluetoothd includes every cached device and GATT tree, so it only pays off for
+    // large bursts. Smaller ones are fetched one by one with a limited number of calls outstanding.
+    if (count < PROPERTY_FETCH_BATCH_THRESHOLD) {
+        GHashTableIter iter;
+        gpointer path;
+        g_hash_table_iter_init(&iter, adapter->pending_property_fetches);
+        while (adapter->property_fetches_in_flight < PROPERTY_FETCH_WINDOW &&
+               g_hash_table_iter_next(&iter, &path, NULL)) {
+            binc_internal_device_getall_properties(adapter, (const char *) path);
+            g_hash_table_iter_remove(&iter);
+        }
+        return G_SOURCE_REMOVE;
+    }
+
+    log_debug(TAG, "fetching properties of %u new devices at once", count);
+    PropertyFetch *fetch = g_new0(PropertyFetch, 1);
+    fetch->adapter = adapter;
+    fetch->paths = adapter->pending_property_fetches;
+    adapter->pending_property_fetches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    adapter->pending_calls++;
+    binc_dbus_call(adapter->connection,
+                   BLUEZ_DBUS,
+                   "/",
+                   INTERFACE_OBJECT_MANAGER,
+                   "GetManagedObjects",
+                   NULL,
+                   G_VARIANT_TYPE("(a{oa{sa{sv}}})"),
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   adapter->cancellable,
+                   (GAsyncReadyCallback) binc_internal_managed_devices_cb,
+                   fetch);
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Unknown devices tend to show up in bursts, e.g. when bluetoothd starts or discovery starts in a busy area.
+ * So requests are collected for a short while and a burst is answered by one GetManagedObjects call
+ * instead of a GetAll call per device.
+ */
+static void schedule_property_fetch(Adapter *adapter) {
+    if (adapter->property_fetch_id == 0) {
+        adapter->property_fetch_id = g_timeout_add(PROPERTY_FETCH_DELAY_MS, binc_internal_fetch_pending_properties,
+                                                   adapter);
+    }
 }
 
+static void request_device_properties(Adapter *adapter, const Device *device) {
+    g_hash_table_add(adapter->pending_property_fetches, g_strdup(binc_device_get_path(device)));
+    schedule_property_fetch(adapter);
+}
+
+static void binc_internal_device_process_changes(Adapter *adapter, Device *device, GVariant *parameters) {
+    GVariantIter *properties_changed = NULL;
+    GVariantIter *properties_invalidated = NULL;
+    const char *iface = NULL;
+    const char *property_name = NULL;
+    GVariant *property_value = NULL;
+
+    gboolean isDiscoveryResult = FALSE;
+    ConnectionState oldState = binc_device_get_connection_state(device);
+    g_assert(g_str_equal(g_variant_get_type_string(parameters), "(sa{sv}as)"));
+    g_variant_get(parameters, "(&sa{sv}as)", &iface, &properties_changed, &properties_invalidated);
+    while (g_variant_iter_loop(properties_changed, "{&sv}", &property_name, &property_value)) {
+        binc_internal_update_device_property(adapter, device, property_name, property_value);
+        if (g_str_equal(property_name, DEVICE_PROPERTY_RSSI) ||
+            g_str_equal(property_name, DEVICE_PROPERTY_MANUFACTURER_DATA) ||
+            g_str_equal(property_name, DEVICE_PROPERTY_SERVICE_DATA)) {
+            isDiscoveryResult = TRUE;
+        }
+    }
+    if (adapter->discovery_state == BINC_DISCOVERY_STARTED && isDiscoveryResult) {
+        deliver_discovery_result(adapter, device);
+    }
+
+    if (binc_device_get_bonding_state(device) == BINC_BONDED && binc_device_get_rssi(device) == -255) {
+        binc_device_set_is_central(device, TRUE);
+    }
+
+    if (binc_device_is_central(device)) {
+        ConnectionState newState = binc_device_get_connection_state(device);
+        if (oldState != newState) {
+            if (adapter->centralStateCallback != NULL) {
+                adapter->centralStateCallback(adapter, device);
+            }
+        }
+    }
+
+    if (properties_changed != NULL)
+        g_variant_iter_free(properties_changed);
+
+    if (properties_invalidated != NULL)
+        g_variant_iter_free(properties_invalidated);
+}
+
+static gboolean is_advertising_property(const char *property_name) {
+    return g_str_equal(property_name, DEVICE_PROPERTY_RSSI) ||
+           g_str_equal(property_name, DEVICE_PROPERTY_MANUFACTURER_DATA) ||
+           g_str_equal(property_name, DEVICE_PROPERTY_SERVICE_DATA) ||
+           g_str_equal(property_name, DEVICE_PROPERTY_TXPOWER) ||
+           g_str_equal(property_name, DEVICE_PROPERTY_ADVERTISING_DATA) ||
+           g_str_equal(property_name, DEVICE_PROPERTY_ADVERTISING_FLAGS);
+}
+
+/**
+ * Check if a PropertiesChanged signal only carries advertising data. These updates can be handled
+ * after the traffic of connected devices, like connection state changes, notifications and GATT replies.
+ */
+static gboolean is_advertising_update(GVariant *parameters) {
+    GVariant *changed = g_variant_get_child_value(parameters, 1);
+    GVariant *invalidated = g_variant_get_child_value(parameters, 2);
+    gboolean result = g_variant_n_children(changed) > 0 && g_variant_n_children(invalidated) == 0;
+
+    GVariantIter iter;
+    const char *property_name = NULL;
+    GVariant *property_value = NULL;
+    g_variant_iter_init(&iter, changed);
+    while (result && g_variant_iter_next(&iter, "{&sv}", &property_name, &property_value)) {
+        result = is_advertising_property(property_name);
+        g_variant_unref(property_value);
+    }
+
+    g_variant_unref(invalidated);
+    g_variant_unref(changed);
+    return result;
+}
+
+static void binc_internal_set_overloaded(Adapter *adapter, gboolean overloaded) {
+    LoadShedding *shedding = &adapter->load_shedding;
+    if (shedding->overloaded == overloaded) return;
+
+    shedding->overloaded = overloaded;
+    shedding->sample_counter = 0;
+    if (overloaded) {
+        log_debug(TAG, "discovery overloaded (%u queued), shedding advertising updates",
+                  g_queue_get_length(adapter->discovery_events));
+    } else {
+        log_debug(TAG, "discovery recovered, %lu advertising updates shed so far",
+                  (unsigned long) shedding->shed_count);
+    }
+
+    if (adapter->loadSheddingCallback != NULL) {
+        adapter->loadSheddingCallback(adapter, overloaded, shedding->shed_count);
+    }
+}
+
+/**
+ * Check the depth of the discovery queue and the age of its oldest event against the thresholds.
+ * Overload mode is left again once both have dropped below half of their threshold, ignoring disabled thresholds.
+ */
+static void binc_internal_update_overload_state(Adapter *adapter, gint64 now) {
+    LoadShedding *shedding = &adapter->load_shedding;
+    if (shedding->max_queue_depth == 0 && shedding->max_lag == 0) return;
+
+    guint depth = g_queue_get_length(adapter->discovery_events);
+    DiscoveryEvent *oldest = g_queue_peek_head(adapter->discovery_events);
+    gint64 lag = oldest != NULL ? now - oldest->queued_at : 0;
+
+    gboolean depth_exceeded = shedding->max_queue_depth > 0 && depth >= shedding->max_queue_depth;
+    gboolean lag_exceeded = shedding->max_lag > 0 && lag >= shedding->max_lag;
+    if (!shedding->overloaded && (depth_exceeded || lag_exceeded)) {
+        binc_internal_set_overloaded(adapter, TRUE);
+    } else if (shedding->overloaded && !depth_exceeded && !lag_exceeded) {
+        // A disabled threshold doesn't keep the adapter in overload mode
+        gboolean depth_recovered = shedding->max_queue_depth == 0 || depth <= shedding->max_queue_depth / 2;
+        gboolean lag_recovered = shedding->max_lag == 0 || lag <= shedding->max_lag / 2;
+        if (depth_recovered && lag_recovered) {
+            binc_internal_set_overloaded(adapter, FALSE);
+        }
+    }
+}
+
+static gboolean should_shed(Adapter *adapter, Device *device) {
+    LoadShedding *shedding = &adapter->load_shedding;
+    if (!shedding->overloaded) return FALSE;
+
+    const char *address = binc_device_get_address(device);
+    if (address != NULL && g_hash_table_contains(shedding->exempt_addresses, address)) return FALSE;
+
+    // Let a sample of the updates through so all devices keep being reported, albeit less often
+    if (++shedding->sample_counter >= DISCOVERY_SHEDDING_SAMPLE_RATE) {
+        shedding->sample_counter = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean binc_internal_dispatch_discovery_events(gpointer user_data) {
+    Adapter *adapter = (Adapter *) user_data;
+    g_assert(adapter != NULL);
+
+    // Handle a limited batch so higher priority sources get a chance to run in between
+    for (guint i = 0; i < DISCOVERY_DISPATCH_BATCH_SIZE; i++) {
+        DiscoveryEvent *event = g_queue_pop_head(adapter->discovery_events);
+        if (event == NULL) break;
+
+        // The device may have been removed while the event was waiting
+        Device *device = g_hash_table_lookup(adapter->devices_cache, event->path);
+        if (device != NULL) {
+            binc_internal_device_process_changes(adapter, device, event->parameters);
+        }
+        discovery_event_free(event);
+    }
+
+    binc_internal_update_overload_state(adapter, g_get_monotonic_time());
+    if (g_queue_is_empty(adapter->discovery_events)) {
+        adapter->discovery_dispatch_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void binc_internal_queue_discovery_event(Adapter *adapter, Device *device, GVariant *parameters) {
+    gint64 now = g_get_monotonic_time();
+    binc_internal_update_overload_state(adapter, now);
+    if (should_shed(adapter, device)) {
+        adapter->load_shedding.shed_count++;
+        return;
+    }
+
+    DiscoveryEvent *event = g_new0(DiscoveryEvent, 1);
+    event->path = g_strdup(binc_device_get_path(device));
+    event->parameters = g_variant_ref(parameters);
+    event->queued_at = now;
+    g_queue_push_tail(adapter->discovery_events, event);
+
+    if (adapter->discovery_dispatch_id == 0) {
+        adapter->discovery_dispatch_id = g_idle_add_full(adapter->discovery_priority,
+                                                         binc_internal_dispatch_discovery_events,
+                                                         adapter, NULL);
+    }
+}
 
 static void binc_internal_device_changed(__attribute__((unused)) GDBusConnection *conn,
                                          __attribute__((unused)) const gchar *sender,
@@ -460,12 +1204,6 @@ static void binc_internal_device_changed(__attribute__((unused)) GDBusConnection
                                          GVariant *parameters,
                                          void *user_data) {
 
-    GVariantIter *properties_changed = NULL;
-    GVariantIter *properties_invalidated = NULL;
-    const char *iface = NULL;
-    const char *property_name = NULL;
-    GVariant *property_value = NULL;
-
     Adapter *adapter = (Adapter *) user_data;
     g_assert(adapter != NULL);
 
@@ -473,91 +1211,94 @@ static void binc_internal_device_changed(__attribute__((unused)) GDBusConnection
     if (device == NULL) {
         if (g_str_has_prefix(path, adapter->path)) {
             device = binc_device_create(path, adapter);
-            g_hash_table_insert(adapter->devices_cache, g_strdup(binc_device_get_path(device)), device);
-            binc_internal_device_getall_properties(adapter, device);
+            cache_device(adapter, device);
+            request_device_properties(adapter, device);
         }
+    } else if (is_advertising_update(parameters)) {
+        binc_scan_table_record_arrival(adapter->scan_table, device, g_get_monotonic_time());
+        binc_internal_queue_discovery_event(adapter, device, parameters);
     } else {
-        gboolean isDiscoveryResult = FALSE;
-        ConnectionState oldState = binc_device_get_connection_state(device);
-        g_assert(g_str_equal(g_variant_get_type_string(parameters), "(sa{sv}as)"));
-        g_variant_get(parameters, "(&sa{sv}as)", &iface, &properties_changed, &properties_invalidated);
-        while (g_variant_iter_loop(properties_changed, "{&sv}", &property_name, &property_value)) {
-            binc_internal_device_update_property(device, property_name, property_value);
-            if (g_str_equal(property_name, DEVICE_PROPERTY_RSSI) ||
-                g_str_equal(property_name, DEVICE_PROPERTY_MANUFACTURER_DATA) ||
-                g_str_equal(property_name, DEVICE_PROPERTY_SERVICE_DATA)) {
-                isDiscoveryResult = TRUE;
-            }
-        }
-        if (adapter->discovery_state == BINC_DISCOVERY_STARTED && isDiscoveryResult) {
-            deliver_discovery_result(adapter, device);
-        }
-
-        if (binc_device_get_bonding_state(device) == BINC_BONDED && binc_device_get_rssi(device) == -255) {
-            binc_device_set_is_central(device, TRUE);
-        }
-
-        if (binc_device_is_central(device)) {
-            ConnectionState newState = binc_device_get_connection_state(device);
-            if (oldState != newState) {
-                if (adapter->centralStateCallback != NULL) {
-                    adapter->centralStateCallback(adapter, device);
-                }
-            }
-        }
+        binc_internal_device_process_changes(adapter, device, parameters);
     }
+}
 
-    if (properties_changed != NULL)
-        g_variant_iter_free(properties_changed);
+static void binc_internal_characteristic_changed(__attribute__((unused)) GDBusConnection *conn,
+                                                 __attribute__((unused)) const gchar *sender,
+                                                 const gchar *path,
+                                                 __attribute__((unused)) const gchar *interface,
+                                                 __attribute__((unused)) const gchar *signal,
+                                                 GVariant *parameters,
+                                                 void *user_data) {
 
-    if (properties_invalidated != NULL)
-        g_variant_iter_free(properties_invalidated);
+    Adapter *adapter = (Adapter *) user_data;
+    g_assert(adapter != NULL);
+
+    // Characteristic paths look like <device path>/serviceXXXX/charYYYY
+    gchar *service_path = g_path_get_dirname(path);
+    gchar *device_path = g_path_get_dirname(service_path);
+    Device *device = g_hash_table_lookup(adapter->devices_cache, device_path);
+    if (device != NULL) {
+        binc_device_handle_characteristic_changed(device, path, parameters);
+    }
+    g_free(device_path);
+    g_free(service_path);
 }
 
 static void setup_signal_subscribers(Adapter *adapter) {
-    adapter->device_prop_changed = g_dbus_connection_signal_subscribe(adapter->connection,
-                                                                      BLUEZ_DBUS,
-                                                                      INTERFACE_PROPERTIES,
-                                                                      SIGNAL_PROPERTIES_CHANGED,
-                                                                      NULL,
-                                                                      INTERFACE_DEVICE,
-                                                                      G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                      binc_internal_device_changed,
-                                                                      adapter,
-                                                                      NULL);
-
-    adapter->adapter_prop_changed = g_dbus_connection_signal_subscribe(adapter->connection,
-                                                                       BLUEZ_DBUS,
-                                                                       INTERFACE_PROPERTIES,
-                                                                       SIGNAL_PROPERTIES_CHANGED,
-                                                                       adapter->path,
-                                                                       INTERFACE_ADAPTER,
-                                                                       G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                       binc_internal_adapter_changed,
-                                                                       adapter,
-                                                                       NULL);
-
-    adapter->iface_added = g_dbus_connection_signal_subscribe(adapter->connection,
+    adapter->device_prop_changed = binc_dbus_signal_subscribe(adapter->connection,
                                                               BLUEZ_DBUS,
-                                                              INTERFACE_OBJECT_MANAGER,
-                                                              "InterfacesAdded",
-                                                              NULL,
+                                                              INTERFACE_PROPERTIES,
+                                                              SIGNAL_PROPERTIES_CHANGED,
                                                               NULL,
+                                                              INTERFACE_DEVICE,
                                                               G_DBUS_SIGNAL_FLAGS_NONE,
-                                                              binc_internal_device_appeared,
+                                                              binc_internal_device_changed,
                                                               adapter,
                                                               NULL);
 
-    adapter->iface_removed = g_dbus_connection_signal_subscribe(adapter->connection,
-                                                                BLUEZ_DBUS,
-                                                                INTERFACE_OBJECT_MANAGER,
-                                                                "InterfacesRemoved",
-                                                                NULL,
-                                                                NULL,
-                                                                G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                binc_internal_device_disappeared,
-                                                                adapter,
-                                                                NULL);
+    adapter->char_prop_changed = binc_dbus_signal_subscribe(adapter->connection,
+                                                            BLUEZ_DBUS,
+                                                            INTERFACE_PROPERTIES,
+                                                            SIGNAL_PROPERTIES_CHANGED,
+                                                            NULL,
+                                                            INTERFACE_CHARACTERISTIC,
+                                                            G_DBUS_SIGNAL_FLAGS_NONE,
+                                                            binc_internal_characteristic_changed,
+                                                            adapter,
+                                                            NULL);
+
+    adapter->adapter_prop_changed = binc_dbus_signal_subscribe(adapter->connection,
+                                                               BLUEZ_DBUS,
+                                                               INTERFACE_PROPERTIES,
+                                                               SIGNAL_PROPERTIES_CHANGED,
+                                                               adapter->path,
+                                                               INTERFACE_ADAPTER,
+                                                               G_DBUS_SIGNAL_FLAGS_NONE,
+                                                               binc_internal_adapter_changed,
+                                                               adapter,
+                                                               NULL);
+
+    adapter->iface_added = binc_dbus_signal_subscribe(adapter->connection,
+                                                      BLUEZ_DBUS,
+                                                      INTERFACE_OBJECT_MANAGER,
+                                                      "InterfacesAdded",
+                                                      NULL,
+                                                      NULL,
+                                                      G_DBUS_SIGNAL_FLAGS_NONE,
+                                                      binc_internal_device_appeared,
+                                                      adapter,
+                                                      NULL);
+
+    adapter->iface_removed = binc_dbus_signal_subscribe(adapter->connection,
+                                                        BLUEZ_DBUS,
+                                                        INTERFACE_OBJECT_MANAGER,
+                                                        "InterfacesRemoved",
+                                                        NULL,
+                                                        NULL,
+                                                        G_DBUS_SIGNAL_FLAGS_NONE,
+                                                        binc_internal_device_disappeared,
+                                                        adapter,
+                                                        NULL);
 }
 
 const char *binc_adapter_get_name(const Adapter *adapter) {
@@ -578,11 +1319,19 @@ static Adapter *binc_adapter_create(GDBusConnection *connection, const char *pat
 
     Adapter *adapter = g_new0(Adapter, 1);
     adapter->connection = connection;
+    adapter->cancellable = g_cancellable_new();
     adapter->path = g_strdup(path);
     adapter->alias = NULL;
     adapter->discovery_filter.rssi = -255;
     adapter->devices_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
                                                    g_free, (GDestroyNotify) binc_device_free);
+    adapter->device_index = binc_device_index_create();
+    adapter->scan_table = binc_scan_table_create();
+    adapter->pending_property_fetches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    adapter->discovery_events = g_queue_new();
+    adapter->discovery_priority = G_PRIORITY_DEFAULT_IDLE;
+    adapter->load_shedding.exempt_addresses = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    adapter->adaptive_discovery.watched_addresses = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
     adapter->user_data = NULL;
     setup_signal_subscribers(adapter);
     return adapter;
@@ -610,17 +1359,17 @@ GPtrArray *binc_adapter_find_all(GDBusConnection *dbusConnection) {
     log_debug(TAG, "finding adapters");
 
     GError *error = NULL;
-    GVariant *result = g_dbus_connection_call_sync(dbusConnection,
-                                                   BLUEZ_DBUS,
-                                                   "/",
-                                                   INTERFACE_OBJECT_MANAGER,
-                                                   "GetManagedObjects",
-                                                   NULL,
-                                                   G_VARIANT_TYPE("(a{oa{sa{sv}}})"),
-                                                   G_DBUS_CALL_FLAGS_NONE,
-                                                   -1,
-                                                   NULL,
-                                                   &error);
+    GVariant *result = binc_dbus_call_sync(dbusConnection,
+                                           BLUEZ_DBUS,
+                                           "/",
+                                           INTERFACE_OBJECT_MANAGER,
+                                           "GetManagedObjects",
+                                           NULL,
+                                           G_VARIANT_TYPE("(a{oa{sa{sv}}})"),
+                                           G_DBUS_CALL_FLAGS_NONE,
+                                           -1,
+                                           NULL,
+                                           &error);
 
     if (result) {
         GVariantIter *iter;
@@ -665,14 +1414,14 @@ GPtrArray *binc_adapter_find_all(GDBusConnection *dbusConnection) {
                 } else if (g_str_equal(interface_name, INTERFACE_DEVICE)) {
                     Adapter *adapter = binc_internal_get_adapter_by_path(binc_adapters, object_path);
                     Device *device = binc_device_create(object_path, adapter);
-                    g_hash_table_insert(adapter->devices_cache, g_strdup(binc_device_get_path(device)), device);
+                    cache_device(adapter, device);
 
                     char *property_name;
                     GVariantIter iter4;
                     GVariant *property_value;
                     g_variant_iter_init(&iter4, properties);
                     while (g_variant_iter_loop(&iter4, "{&sv}", &property_name, &property_value)) {
-                        binc_internal_device_update_property(device, property_name, property_value);
+                        binc_internal_update_device_property(adapter, device, property_name, property_value);
                     }
                     log_debug(TAG, "found device %s '%s'", object_path, binc_device_get_name(device));
                 }
@@ -740,7 +1489,8 @@ static void binc_internal_start_discovery_cb(__attribute__((unused)) GObject *so
     g_assert(adapter != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(adapter->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(adapter->connection, res, &error);
+    if (!binc_internal_adapter_call_done(adapter, value, &error)) return;
 
     if (error != NULL) {
         log_error(TAG, "failed to call '%s' (error %d: %s)", METHOD_START_DISCOVERY, error->code, error->message);
@@ -763,18 +1513,19 @@ void binc_adapter_start_discovery(Adapter *adapter) {
 
     if (adapter->discovery_state == BINC_DISCOVERY_STOPPED) {
         binc_internal_set_discovery_state(adapter, BINC_DISCOVERY_STARTING);
-        g_dbus_connection_call(adapter->connection,
-                               BLUEZ_DBUS,
-                               adapter->path,
-                               INTERFACE_ADAPTER,
-                               METHOD_START_DISCOVERY,
-                               NULL,
-                               NULL,
-                               G_DBUS_CALL_FLAGS_NONE,
-                               -1,
-                               NULL,
-                               (GAsyncReadyCallback) binc_internal_start_discovery_cb,
-                               adapter);
+        adapter->pending_calls++;
+        binc_dbus_call(adapter->connection,
+                       BLUEZ_DBUS,
+                       adapter->path,
+                       INTERFACE_ADAPTER,
+                       METHOD_START_DISCOVERY,
+                       NULL,
+                       NULL,
+                       G_DBUS_CALL_FLAGS_NONE,
+                       -1,
+                       adapter->cancellable,
+                       (GAsyncReadyCallback) binc_internal_start_discovery_cb,
+                       adapter);
     }
 }
 
@@ -785,7 +1536,8 @@ static void binc_internal_stop_discovery_cb(__attribute__((unused)) GObject *sou
     g_assert(adapter != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(adapter->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(adapter->connection, res, &error);
+    if (!binc_internal_adapter_call_done(adapter, value, &error)) return;
 
     if (error != NULL) {
         log_error(TAG, "failed to call '%s' (error %d: %s)", METHOD_STOP_DISCOVERY, error->code, error->message);
@@ -806,18 +1558,19 @@ void binc_adapter_stop_discovery(Adapter *adapter) {
 
     if (adapter->discovery_state == BINC_DISCOVERY_STARTED) {
         binc_internal_set_discovery_state(adapter, BINC_DISCOVERY_STOPPING);
-        g_dbus_connection_call(adapter->connection,
-                               BLUEZ_DBUS,
-                               adapter->path,
-                               INTERFACE_ADAPTER,
-                               METHOD_STOP_DISCOVERY,
-                               NULL,
-                               NULL,
-                               G_DBUS_CALL_FLAGS_NONE,
-                               -1,
-                               NULL,
-                               (GAsyncReadyCallback) binc_internal_stop_discovery_cb,
-                               adapter);
+        adapter->pending_calls++;
+        binc_dbus_call(adapter->connection,
+                       BLUEZ_DBUS,
+                       adapter->path,
+                       INTERFACE_ADAPTER,
+                       METHOD_STOP_DISCOVERY,
+                       NULL,
+                       NULL,
+                       G_DBUS_CALL_FLAGS_NONE,
+                       -1,
+                       adapter->cancellable,
+                       (GAsyncReadyCallback) binc_internal_stop_discovery_cb,
+                       adapter);
     }
 }
 
@@ -830,6 +1583,140 @@ void binc_adapter_remove_device(Adapter *adapter, Device *device) {
                                       g_variant_new("(o)", binc_device_get_path(device)));
 }
 
+typedef struct binc_bulk_removal {
+    Adapter *adapter; // Borrowed
+    GQueue *pending_paths; // Owned
+    guint window;
+    guint in_flight;
+    guint removed;
+    guint failed;
+    guint total;
+    AdapterBulkRemovalProgressCallback progress_callback;
+    void *user_data; // Borrowed
+} BulkRemoval;
+
+static void bulk_removal_free(BulkRemoval *bulkRemoval) {
+    g_assert(bulkRemoval != NULL);
+
+    g_queue_free_full(bulkRemoval->pending_paths, g_free);
+    bulkRemoval->pending_paths = NULL;
+    g_free(bulkRemoval);
+}
+
+typedef struct binc_bulk_removal_call {
+    BulkRemoval *bulkRemoval; // Borrowed
+    char *device_path; // Owned
+} BulkRemovalCall;
+
+static void bulk_removal_send_next(BulkRemoval *bulkRemoval);
+
+static void binc_internal_bulk_remove_cb(__attribute__((unused)) GObject *source_object,
+                                         GAsyncResult *res,
+                                         gpointer user_data) {
+    BulkRemovalCall *call = (BulkRemovalCall *) user_data;
+    g_assert(call != NULL);
+
+    BulkRemoval *bulkRemoval = call->bulkRemoval;
+    Adapter *adapter = bulkRemoval->adapter;
+    char *device_path = call->device_path;
+    g_free(call);
+    bulkRemoval->in_flight--;
+
+    GError *error = NULL;
+    GVariant *value = binc_dbus_call_finish(adapter->connection, res, &error);
+    if (!binc_internal_adapter_call_done(adapter, value, &error)) {
+        g_free(device_path);
+        if (bulkRemoval->in_flight == 0) {
+            bulk_removal_free(bulkRemoval);
+        }
+        return;
+    }
+    if (value != NULL) {
+        g_variant_unref(value);
+    }
+
+    if (error != NULL) {
+        log_error(TAG, "failed to remove %s (error %d: %s)", device_path, error->code, error->message);
+        g_clear_error(&error);
+        bulkRemoval->failed++;
+    } else {
+        // Don't wait for InterfacesRemoved to drop the device from the cache
+        purge_device(adapter, device_path);
+        bulkRemoval->removed++;
+    }
+    g_free(device_path);
+
+    if (bulkRemoval->progress_callback != NULL) {
+        bulkRemoval->progress_callback(adapter, bulkRemoval->removed, bulkRemoval->failed, bulkRemoval->total,
+                                       bulkRemoval->user_data);
+    }
+
+    if (bulkRemoval->removed + bulkRemoval->failed == bulkRemoval->total) {
+        log_debug(TAG, "bulk removal done, %u removed, %u failed", bulkRemoval->removed, bulkRemoval->failed);
+        bulk_removal_free(bulkRemoval);
+        return;
+    }
+
+    bulk_removal_send_next(bulkRemoval);
+}
+
+static void bulk_removal_send_next(BulkRemoval *bulkRemoval) {
+    // Keep at most 'window' RemoveDevice calls outstanding so bluetoothd isn't flooded
+    while (bulkRemoval->in_flight < bulkRemoval->window && !g_queue_is_empty(bulkRemoval->pending_paths)) {
+        BulkRemovalCall *call = g_new0(BulkRemovalCall, 1);
+        call->bulkRemoval = bulkRemoval;
+        call->device_path = g_queue_pop_head(bulkRemoval->pending_paths);
+        bulkRemoval->in_flight++;
+        bulkRemoval->adapter->pending_calls++;
+        binc_dbus_call(bulkRemoval->adapter->connection,
+                       BLUEZ_DBUS,
+                       bulkRemoval->adapter->path,
+                       INTERFACE_ADAPTER,
+                       METHOD_REMOVE_DEVICE,
+                       g_variant_new("(o)", call->device_path),
+                       NULL,
+                       G_DBUS_CALL_FLAGS_NONE,
+                       -1,
+                       bulkRemoval->adapter->cancellable,
+                       (GAsyncReadyCallback) binc_internal_bulk_remove_cb,
+                       call);
+    }
+}
+
+guint binc_adapter_remove_devices(Adapter *adapter, AdapterDeviceFilter filter, guint window,
+                                  AdapterBulkRemovalProgressCallback progress_callback, void *user_data) {
+    g_assert(adapter != NULL);
+    g_assert(filter != NULL);
+
+    BulkRemoval *bulkRemoval = g_new0(BulkRemoval, 1);
+    bulkRemoval->adapter = adapter;
+    bulkRemoval->pending_paths = g_queue_new();
+    bulkRemoval->window = window > 0 ? window : DEFAULT_BULK_REMOVAL_WINDOW;
+    bulkRemoval->progress_callback = progress_callback;
+    bulkRemoval->user_data = user_data;
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, adapter->devices_cache);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Device *device = (Device *) value;
+        if (filter(adapter, device, user_data)) {
+            g_queue_push_tail(bulkRemoval->pending_paths, g_strdup(binc_device_get_path(device)));
+        }
+    }
+
+    bulkRemoval->total = g_queue_get_length(bulkRemoval->pending_paths);
+    if (bulkRemoval->total == 0) {
+        bulk_removal_free(bulkRemoval);
+        return 0;
+    }
+
+    guint total = bulkRemoval->total;
+    log_debug(TAG, "removing %u devices, %u at a time", total, bulkRemoval->window);
+    bulk_removal_send_next(bulkRemoval);
+    return total;
+}
+
 GList *binc_adapter_get_devices(const Adapter *adapter) {
     g_assert (adapter != NULL);
     return g_hash_table_get_values(adapter->devices_cache);
@@ -854,46 +1741,285 @@ GList *binc_adapter_get_connected_devices(const Adapter *adapter) {
     return result;
 }
 
-void binc_adapter_set_discovery_filter(Adapter *adapter, short rssi_threshold, const GPtrArray *service_uuids,
-                                       const char *pattern) {
+GList *binc_adapter_find_devices_by_manufacturer(const Adapter *adapter, guint16 company_id, short min_rssi) {
     g_assert(adapter != NULL);
-    g_assert(rssi_threshold >= -127);
-    g_assert(rssi_threshold <= 20);
+    return binc_device_index_find_by_manufacturer(adapter->device_index, company_id, min_rssi);
+}
 
-    // Setup discovery filter so we can double-check the results later
-    if (adapter->discovery_filter.services != NULL) {
-        free_discovery_filter(adapter);
+GList *binc_adapter_find_devices_by_service(const Adapter *adapter, const char *service_uuid, short min_rssi) {
+    g_assert(adapter != NULL);
+    g_assert(g_uuid_string_is_valid(service_uuid));
+    return binc_device_index_find_by_service(adapter->device_index, service_uuid, min_rssi);
+}
+
+GList *binc_adapter_find_devices_by_rssi(const Adapter *adapter, short min_rssi) {
+    g_assert(adapter != NULL);
+    return binc_device_index_find_by_rssi(adapter->device_index, min_rssi);
+}
+
+GList *binc_adapter_get_strongest_devices(const Adapter *adapter, guint count) {
+    g_assert(adapter != NULL);
+    return binc_device_index_get_strongest(adapter->device_index, count);
+}
+
+Device *binc_adapter_get_device_by_id(const Adapter *adapter, guint id) {
+    g_assert(adapter != NULL);
+    return binc_scan_table_get_device(adapter->scan_table, id);
+}
+
+void binc_adapter_get_scan_state(const Adapter *adapter, ScanStateView *view) {
+    g_assert(adapter != NULL);
+    g_assert(view != NULL);
+    binc_scan_table_get_view(adapter->scan_table, view);
+}
+
+GList *binc_adapter_find_devices_not_seen_since(const Adapter *adapter, guint max_age_seconds) {
+    g_assert(adapter != NULL);
+    return binc_scan_table_find_not_seen_since(adapter->scan_table, max_age_seconds);
+}
+
+guint binc_adapter_get_advertising_interval(const Adapter *adapter, const Device *device) {
+    g_assert(adapter != NULL);
+    g_assert(device != NULL);
+    return binc_scan_table_get_adv_interval(adapter->scan_table, device);
+}
+
+void binc_adapter_watch_device(Adapter *adapter, const char *address) {
+    g_assert(adapter != NULL);
+    g_assert(address != NULL);
+    g_assert(strlen(address) == MAC_ADDRESS_LENGTH);
+
+    g_hash_table_add(adapter->adaptive_discovery.watched_addresses, g_ascii_strup(address, -1));
+}
+
+void binc_adapter_unwatch_device(Adapter *adapter, const char *address) {
+    g_assert(adapter != NULL);
+    g_assert(address != NULL);
+
+    char *key = g_ascii_strup(address, -1);
+    g_hash_table_remove(adapter->adaptive_discovery.watched_addresses, key);
+    g_free(key);
+}
+
+static gboolean collect_watched_interval(Adapter *adapter, const Device *device, guint *max_interval) {
+    guint interval = device != NULL ? binc_scan_table_get_adv_interval(adapter->scan_table, device) : 0;
+    if (interval == 0) return FALSE;
+
+    *max_interval = MAX(*max_interval, interval);
+    return TRUE;
+}
+
+static void plan_adaptive_discovery(Adapter *adapter) {
+    AdaptiveDiscovery *discovery = &adapter->adaptive_discovery;
+    gboolean all_known = TRUE;
+    guint max_interval = 0;
+
+    // Devices that are only cached never advertise, so without watched devices there is nothing to plan for
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, discovery->watched_addresses);
+    while (all_known && g_hash_table_iter_next(&iter, &key, NULL)) {
+        Device *device = binc_adapter_get_device_by_address(adapter, (const char *) key);
+        all_known = collect_watched_interval(adapter, device, &max_interval);
+    }
+    all_known = all_known && max_interval > 0;
+
+    // A window of a few intervals still catches a device when one of its advertisements is lost.
+    // A device then waits at most the off time plus one interval, so the period is the target latency.
+    guint window = MAX(max_interval * ADAPTIVE_DISCOVERY_WINDOW_MARGIN, ADAPTIVE_DISCOVERY_MIN_WINDOW_MS);
+    if (!all_known || window + ADAPTIVE_DISCOVERY_MIN_OFF_MS > discovery->target_latency) {
+        window = discovery->target_latency;
+    }
+
+    if (window != discovery->window) {
+        log_debug(TAG, "adaptive discovery: scanning %u ms every %u ms", window, discovery->target_latency);
+    }
+    discovery->window = window;
+    discovery->period = discovery->target_latency;
+}
+
+static gboolean binc_internal_adaptive_discovery_next(gpointer user_data) {
+    Adapter *adapter = (Adapter *) user_data;
+    g_assert(adapter != NULL);
+
+    AdaptiveDiscovery *discovery = &adapter->adaptive_discovery;
+    if (discovery->scanning && discovery->window < discovery->period) {
+        discovery->scanning = FALSE;
+        binc_adapter_stop_discovery(adapter);
+        discovery->timeout_id = g_timeout_add(discovery->period - discovery->window,
+                                              binc_internal_adaptive_discovery_next, adapter);
+    } else {
+        plan_adaptive_discovery(adapter);
+        discovery->scanning = TRUE;
+        binc_adapter_start_discovery(adapter);
+        discovery->timeout_id = g_timeout_add(discovery->window, binc_internal_adaptive_discovery_next, adapter);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+void binc_adapter_start_adaptive_discovery(Adapter *adapter, guint target_latency_ms) {
+    g_assert(adapter != NULL);
+    g_assert(target_latency_ms > 0);
+
+    AdaptiveDiscovery *discovery = &adapter->adaptive_discovery;
+    if (discovery->timeout_id != 0) {
+        g_source_remove(discovery->timeout_id);
+        discovery->timeout_id = 0;
+    }
+
+    discovery->target_latency = target_latency_ms;
+    discovery->scanning = FALSE;
+    binc_internal_adaptive_discovery_next(adapter);
+}
+
+void binc_adapter_stop_adaptive_discovery(Adapter *adapter) {
+    g_assert(adapter != NULL);
+
+    AdaptiveDiscovery *discovery = &adapter->adaptive_discovery;
+    if (discovery->timeout_id == 0) return;
+
+    g_source_remove(discovery->timeout_id);
+    discovery->timeout_id = 0;
+    discovery->target_latency = 0;
+    discovery->window = 0;
+    discovery->period = 0;
+    discovery->scanning = FALSE;
+    binc_adapter_stop_discovery(adapter);
+}
+
+void binc_adapter_get_adaptive_discovery_plan(const Adapter *adapter, guint *window_ms, guint *period_ms) {
+    g_assert(adapter != NULL);
+    g_assert(window_ms != NULL);
+    g_assert(period_ms != NULL);
+
+    *window_ms = adapter->adaptive_discovery.window;
+    *period_ms = adapter->adaptive_discovery.period;
+}
+
+static void merge_discovery_filter(const DiscoveryFilter *filter, guint index, short *rssi, GPtrArray *uuids,
+                                   gboolean *all_services, const char **pattern) {
+    if (filter->rssi < *rssi) {
+        *rssi = filter->rssi;
+    }
+
+    if (filter->services == NULL || filter->services->len == 0) {
+        *all_services = TRUE;
+    } else {
+        for (guint i = 0; i < filter->services->len; i++) {
+            char *uuid = g_ptr_array_index(filter->services, i);
+            if (!g_ptr_array_find_with_equal_func(uuids, uuid, g_str_equal, NULL)) {
+                g_ptr_array_add(uuids, uuid);
+            }
+        }
+    }
+
+    // Bluez only takes a single pattern, so different patterns can only be checked by us
+    if (index == 0) {
+        *pattern = filter->pattern;
+    } else if (g_strcmp0(*pattern, filter->pattern) != 0) {
+        *pattern = NULL;
+    }
+}
+
+/**
+ * Program Bluez with the union of the discovery filters of all consumers. Every consumer's own filter is
+ * checked again when a discovery result is delivered.
+ */
+static void binc_internal_apply_discovery_filter(Adapter *adapter) {
+    g_assert(adapter != NULL);
+
+    short rssi = 20;
+    gboolean all_services = FALSE;
+    const char *pattern = NULL;
+    GPtrArray *uuids = g_ptr_array_new();
+    guint count = 0;
+
+    if (adapter->discovery_sessions == NULL || adapter->discoveryResultCallback != NULL) {
+        merge_discovery_filter(&adapter->discovery_filter, count++, &rssi, uuids, &all_services, &pattern);
+    }
+
+    for (GList *iterator = adapter->discovery_sessions; iterator; iterator = iterator->next) {
+        DiscoverySession *session = (DiscoverySession *) iterator->data;
+        if (session->removed) continue;
+        merge_discovery_filter(&session->filter, count++, &rssi, uuids, &all_services, &pattern);
     }
-    adapter->discovery_filter.services = g_ptr_array_new();
-    adapter->discovery_filter.rssi = rssi_threshold;
-    adapter->discovery_filter.pattern = g_strdup(pattern);
 
     GVariantBuilder *arguments = g_variant_builder_new(G_VARIANT_TYPE_VARDICT);
     g_variant_builder_add(arguments, "{sv}", "Transport", g_variant_new_string("le"));
-    g_variant_builder_add(arguments, "{sv}", DEVICE_PROPERTY_RSSI, g_variant_new_int16(rssi_threshold));
+    if (rssi >= -127) {
+        g_variant_builder_add(arguments, "{sv}", DEVICE_PROPERTY_RSSI, g_variant_new_int16(rssi));
+    }
     g_variant_builder_add(arguments, "{sv}", "DuplicateData", g_variant_new_boolean(TRUE));
 
     if (pattern != NULL) {
         g_variant_builder_add(arguments, "{sv}", "Pattern", g_variant_new_string(pattern));
     }
 
-    if (service_uuids != NULL && service_uuids->len > 0) {
-        GVariantBuilder *uuids = g_variant_builder_new(G_VARIANT_TYPE_STRING_ARRAY);
-        for (guint i = 0; i < service_uuids->len; i++) {
-            char *uuid = g_ptr_array_index(service_uuids, i);
-            g_assert(g_uuid_string_is_valid(uuid));
-            g_variant_builder_add(uuids, "s", uuid);
-            g_ptr_array_add(adapter->discovery_filter.services, g_strdup(uuid));
+    if (!all_services && uuids->len > 0) {
+        GVariantBuilder *uuids_builder = g_variant_builder_new(G_VARIANT_TYPE_STRING_ARRAY);
+        for (guint i = 0; i < uuids->len; i++) {
+            g_variant_builder_add(uuids_builder, "s", g_ptr_array_index(uuids, i));
         }
-        g_variant_builder_add(arguments, "{sv}", DEVICE_PROPERTY_UUIDS, g_variant_builder_end(uuids));
-        g_variant_builder_unref(uuids);
+        g_variant_builder_add(arguments, "{sv}", DEVICE_PROPERTY_UUIDS, g_variant_builder_end(uuids_builder));
+        g_variant_builder_unref(uuids_builder);
     }
+    g_ptr_array_free(uuids, TRUE);
 
     GVariant *filter = g_variant_builder_end(arguments);
     g_variant_builder_unref(arguments);
     binc_internal_adapter_call_method(adapter, METHOD_SET_DISCOVERY_FILTER, g_variant_new_tuple(&filter, 1));
 }
 
+void binc_adapter_set_discovery_filter(Adapter *adapter, short rssi_threshold, const GPtrArray *service_uuids,
+                                       const char *pattern) {
+    g_assert(adapter != NULL);
+    g_assert(rssi_threshold >= -127);
+    g_assert(rssi_threshold <= 20);
+
+    // Setup discovery filter so we can double-check the results later
+    if (adapter->discovery_filter.services != NULL) {
+        free_discovery_filter(&adapter->discovery_filter);
+    }
+    init_discovery_filter(&adapter->discovery_filter, rssi_threshold, service_uuids, pattern);
+    binc_internal_apply_discovery_filter(adapter);
+}
+
+DiscoverySession *binc_adapter_add_discovery_session(Adapter *adapter, short rssi_threshold,
+                                                     const GPtrArray *service_uuids, const char *pattern,
+                                                     DiscoverySessionResultCallback callback, void *user_data) {
+    g_assert(adapter != NULL);
+    g_assert(rssi_threshold >= -127);
+    g_assert(rssi_threshold <= 20);
+    g_assert(callback != NULL);
+
+    DiscoverySession *session = g_new0(DiscoverySession, 1);
+    session->adapter = adapter;
+    session->callback = callback;
+    session->user_data = user_data;
+    init_discovery_filter(&session->filter, rssi_threshold, service_uuids, pattern);
+
+    adapter->discovery_sessions = g_list_append(adapter->discovery_sessions, session);
+    binc_internal_apply_discovery_filter(adapter);
+    return session;
+}
+
+void binc_adapter_remove_discovery_session(Adapter *adapter, DiscoverySession *session) {
+    g_assert(adapter != NULL);
+    g_assert(session != NULL);
+    g_assert(session->adapter == adapter);
+
+    session->removed = TRUE;
+    if (!adapter->delivering_discovery_result) {
+        purge_removed_discovery_sessions(adapter);
+    }
+    binc_internal_apply_discovery_filter(adapter);
+}
+
+void *binc_discovery_session_get_user_data(const DiscoverySession *session) {
+    g_assert(session != NULL);
+    return session->user_data;
+}
+
 static void binc_internal_set_property_cb(__attribute__((unused)) GObject *source_object,
                                           GAsyncResult *res,
                                           gpointer user_data) {
@@ -901,7 +2027,8 @@ static void binc_internal_set_property_cb(__attribute__((unused)) GObject *sourc
     g_assert(adapter != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(adapter->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(adapter->connection, res, &error);
+    if (!binc_internal_adapter_call_done(adapter, value, &error)) return;
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -917,18 +2044,19 @@ static void adapter_set_property(Adapter *adapter, const char *property, GVarian
     g_assert(property != NULL);
     g_assert(value != NULL);
 
-    g_dbus_connection_call(adapter->connection,
-                           BLUEZ_DBUS,
-                           adapter->path,
-                           INTERFACE_PROPERTIES,
-                           "Set",
-                           g_variant_new("(ssv)", INTERFACE_ADAPTER, property, value),
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_set_property_cb,
-                           adapter);
+    adapter->pending_calls++;
+    binc_dbus_call(adapter->connection,
+                   BLUEZ_DBUS,
+                   adapter->path,
+                   INTERFACE_PROPERTIES,
+                   "Set",
+                   g_variant_new("(ssv)", INTERFACE_ADAPTER, property, value),
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   adapter->cancellable,
+                   (GAsyncReadyCallback) binc_internal_set_property_cb,
+                   adapter);
 }
 
 void binc_adapter_power_on(Adapter *adapter) {
@@ -991,6 +2119,96 @@ void binc_adapter_set_discovery_cb(Adapter *adapter, AdapterDiscoveryResultCallb
     g_assert(callback != NULL);
 
     adapter->discoveryResultCallback = callback;
+
+    // The default filter only counts towards the Bluez filter when somebody is listening to it
+    if (adapter->discovery_sessions != NULL) {
+        binc_internal_apply_discovery_filter(adapter);
+    }
+}
+
+void binc_adapter_set_discovery_priority(Adapter *adapter, gint priority) {
+    g_assert(adapter != NULL);
+
+    adapter->discovery_priority = priority;
+    if (adapter->discovery_dispatch_id != 0) {
+        g_source_remove(adapter->discovery_dispatch_id);
+        adapter->discovery_dispatch_id = g_idle_add_full(adapter->discovery_priority,
+                                                         binc_internal_dispatch_discovery_events,
+                                                         adapter, NULL);
+    }
+}
+
+gint binc_adapter_get_discovery_priority(const Adapter *adapter) {
+    g_assert(adapter != NULL);
+    return adapter->discovery_priority;
+}
+
+void binc_adapter_set_load_shedding(Adapter *adapter, guint max_queue_depth, guint max_lag_ms) {
+    g_assert(adapter != NULL);
+
+    adapter->load_shedding.max_queue_depth = max_queue_depth;
+    adapter->load_shedding.max_lag = (gint64) max_lag_ms * G_TIME_SPAN_MILLISECOND;
+    if (max_queue_depth == 0 && max_lag_ms == 0) {
+        binc_internal_set_overloaded(adapter, FALSE);
+    }
+}
+
+void binc_adapter_add_load_shedding_exemption(Adapter *adapter, const char *address) {
+    g_assert(adapter != NULL);
+    g_assert(address != NULL);
+    g_assert(strlen(address) == MAC_ADDRESS_LENGTH);
+
+    g_hash_table_add(adapter->load_shedding.exempt_addresses, g_ascii_strup(address, -1));
+}
+
+void binc_adapter_remove_load_shedding_exemption(Adapter *adapter, const char *address) {
+    g_assert(adapter != NULL);
+    g_assert(address != NULL);
+
+    char *key = g_ascii_strup(address, -1);
+    g_hash_table_remove(adapter->load_shedding.exempt_addresses, key);
+    g_free(key);
+}
+
+gboolean binc_adapter_is_overloaded(const Adapter *adapter) {
+    g_assert(adapter != NULL);
+    return adapter->load_shedding.overloaded;
+}
+
+guint64 binc_adapter_get_shed_count(const Adapter *adapter) {
+    g_assert(adapter != NULL);
+    return adapter->load_shedding.shed_count;
+}
+
+void binc_adapter_get_stats(const Adapter *adapter, AdapterStats *stats) {
+    g_assert(adapter != NULL);
+    g_assert(stats != NULL);
+
+    stats->devices = g_hash_table_size(adapter->devices_cache);
+    stats->connected_devices = 0;
+    stats->discovery_queue_depth = g_queue_get_length(adapter->discovery_events);
+    stats->pending_property_fetches = g_hash_table_size(adapter->pending_property_fetches);
+    stats->overloaded = adapter->load_shedding.overloaded;
+    stats->shed_count = adapter->load_shedding.shed_count;
+    stats->notifications = 0;
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, adapter->devices_cache);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        Device *device = (Device *) value;
+        if (binc_device_get_connection_state(device) == BINC_CONNECTED) {
+            stats->connected_devices++;
+        }
+        stats->notifications += binc_device_get_notification_count(device);
+    }
+}
+
+void binc_adapter_set_load_shedding_cb(Adapter *adapter, AdapterLoadSheddingCallback callback) {
+    g_assert(adapter != NULL);
+    g_assert(callback != NULL);
+
+    adapter->loadSheddingCallback = callback;
 }
 
 void binc_adapter_set_device_removal_cb(Adapter *adapter, AdapterDeviceRemovalCallback callback) {
@@ -1061,6 +2279,17 @@ Device *binc_adapter_get_device_by_address(const Adapter *adapter, const char *a
     return device;
 }
 
+void binc_adapter_attach_admin_socket(Adapter *adapter) {
+    g_assert(adapter != NULL);
+    adapter->admin_sockets++;
+}
+
+void binc_adapter_detach_admin_socket(Adapter *adapter) {
+    g_assert(adapter != NULL);
+    g_assert(adapter->admin_sockets > 0);
+    adapter->admin_sockets--;
+}
+
 GDBusConnection *binc_adapter_get_dbus_connection(const Adapter *adapter) {
     g_assert(adapter != NULL);
     return adapter->connection;
@@ -1083,7 +2312,8 @@ static void binc_internal_start_advertising_cb(__attribute__((unused)) GObject *
     g_assert(adapter != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(adapter->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(adapter->connection, res, &error);
+    if (!binc_internal_adapter_call_done(adapter, value, &error)) return;
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -1091,6 +2321,12 @@ static void binc_internal_start_advertising_cb(__attribute__((unused)) GObject *
     if (error != NULL) {
         log_error(TAG, "failed to register advertisement (error %d: %s)", error->code, error->message);
         g_clear_error(&error);
+
+        // This adapter doesn't advertise it, so release its registration again
+        if (adapter->advertisement != NULL) {
+            binc_advertisement_unregister(adapter->advertisement, adapter);
+            adapter->advertisement = NULL;
+        }
     } else {
         log_debug(TAG, "started advertising (%s)", adapter->address);
     }
@@ -1103,17 +2339,18 @@ void binc_adapter_start_advertising(Adapter *adapter, Advertisement *advertiseme
     adapter->advertisement = advertisement;
     binc_advertisement_register(advertisement, adapter);
 
-    g_dbus_connection_call(binc_adapter_get_dbus_connection(adapter),
-                           "org.bluez",
-                           adapter->path,
-                           "org.bluez.LEAdvertisingManager1",
-                           "RegisterAdvertisement",
-                           g_variant_new("(oa{sv})", binc_advertisement_get_path(advertisement), NULL),
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_start_advertising_cb, adapter);
+    adapter->pending_calls++;
+    binc_dbus_call(binc_adapter_get_dbus_connection(adapter),
+                   "org.bluez",
+                   adapter->path,
+                   "org.bluez.LEAdvertisingManager1",
+                   "RegisterAdvertisement",
+                   g_variant_new("(oa{sv})", binc_advertisement_get_path(advertisement), NULL),
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   adapter->cancellable,
+                   (GAsyncReadyCallback) binc_internal_start_advertising_cb, adapter);
 }
 
 static void binc_internal_stop_advertising_cb(__attribute__((unused)) GObject *source_object,
@@ -1124,7 +2361,8 @@ static void binc_internal_stop_advertising_cb(__attribute__((unused)) GObject *s
     g_assert(adapter != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(adapter->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(adapter->connection, res, &error);
+    if (!binc_internal_adapter_call_done(adapter, value, &error)) return;
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -1133,7 +2371,9 @@ static void binc_internal_stop_advertising_cb(__attribute__((unused)) GObject *s
         log_error(TAG, "failed to unregister advertisement (error %d: %s)", error->code, error->message);
         g_clear_error(&error);
     } else {
-        binc_advertisement_unregister(adapter->advertisement, adapter);
+        if (adapter->advertisement != NULL) {
+            binc_advertisement_unregister(adapter->advertisement, adapter);
+        }
         log_debug(TAG, "stopped advertising");
     }
 
@@ -1143,17 +2383,18 @@ void binc_adapter_stop_advertising(Adapter *adapter, Advertisement *advertisemen
     g_assert(adapter != NULL);
     g_assert(advertisement != NULL);
 
-    g_dbus_connection_call(binc_adapter_get_dbus_connection(adapter),
-                           "org.bluez",
-                           adapter->path,
-                           "org.bluez.LEAdvertisingManager1",
-                           "UnregisterAdvertisement",
-                           g_variant_new("(o)", binc_advertisement_get_path(advertisement)),
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_stop_advertising_cb, adapter);
+    adapter->pending_calls++;
+    binc_dbus_call(binc_adapter_get_dbus_connection(adapter),
+                   "org.bluez",
+                   adapter->path,
+                   "org.bluez.LEAdvertisingManager1",
+                   "UnregisterAdvertisement",
+                   g_variant_new("(o)", binc_advertisement_get_path(advertisement)),
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   adapter->cancellable,
+                   (GAsyncReadyCallback) binc_internal_stop_advertising_cb, adapter);
 }
 
 static void binc_internal_register_appl_cb(__attribute__((unused)) GObject *source_object,
@@ -1163,7 +2404,8 @@ static void binc_internal_register_appl_cb(__attribute__((unused)) GObject *sour
     g_assert(adapter != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(adapter->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(adapter->connection, res, &error);
+    if (!binc_internal_adapter_call_done(adapter, value, &error)) return;
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -1180,17 +2422,18 @@ void binc_adapter_register_application(Adapter *adapter, Application *applicatio
     g_assert(adapter != NULL);
     g_assert(application != NULL);
 
-    g_dbus_connection_call(binc_adapter_get_dbus_connection(adapter),
-                           BLUEZ_DBUS,
-                           adapter->path,
-                           INTERFACE_GATT_MANAGER,
-                           "RegisterApplication",
-                           g_variant_new("(oa{sv})", binc_application_get_path(application), NULL),
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_register_appl_cb, adapter);
+    adapter->pending_calls++;
+    binc_dbus_call(binc_adapter_get_dbus_connection(adapter),
+                   BLUEZ_DBUS,
+                   adapter->path,
+                   INTERFACE_GATT_MANAGER,
+                   "RegisterApplication",
+                   g_variant_new("(oa{sv})", binc_application_get_path(application), NULL),
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   adapter->cancellable,
+                   (GAsyncReadyCallback) binc_internal_register_appl_cb, adapter);
 
 }
 
@@ -1202,7 +2445,8 @@ static void binc_internal_unregister_appl_cb(__attribute__((unused)) GObject *so
     g_assert(adapter != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(adapter->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(adapter->connection, res, &error);
+    if (!binc_internal_adapter_call_done(adapter, value, &error)) return;
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -1219,17 +2463,18 @@ void binc_adapter_unregister_application(Adapter *adapter, Application *applicat
     g_assert(adapter != NULL);
     g_assert(application != NULL);
 
-    g_dbus_connection_call(binc_adapter_get_dbus_connection(adapter),
-                           BLUEZ_DBUS,
-                           adapter->path,
-                           INTERFACE_GATT_MANAGER,
-                           "UnregisterApplication",
-                           g_variant_new("(o)", binc_application_get_path(application)),
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_unregister_appl_cb, adapter);
+    adapter->pending_calls++;
+    binc_dbus_call(binc_adapter_get_dbus_connection(adapter),
+                   BLUEZ_DBUS,
+                   adapter->path,
+                   INTERFACE_GATT_MANAGER,
+                   "UnregisterApplication",
+                   g_variant_new("(o)", binc_application_get_path(application)),
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   adapter->cancellable,
+                   (GAsyncReadyCallback) binc_internal_unregister_appl_cb, adapter);
 
 }
 
@@ -45,6 +45,48 @@ typedef void (*AdapterPoweredStateChangeCallback)(Adapter *adapter, gboolean sta
 
 typedef void (*RemoteCentralConnectionStateCallback)(Adapter *adapter, Device *device);
 
+typedef void (*AdapterLoadSheddingCallback)(Adapter *adapter, gboolean overloaded, guint64 shed_count);
+
+typedef void (*DiscoverySessionResultCallback)(Adapter *adapter, DiscoverySession *session, Device *device);
+
+typedef gboolean (*AdapterDeviceFilter)(Adapter *adapter, Device *device, void *user_data);
+
+typedef void (*AdapterBulkRemovalProgressCallback)(Adapter *adapter, guint removed, guint failed, guint total,
+                                                   void *user_data);
+
+typedef void (*AdapterShutdownCallback)(guint disconnected, guint failed, guint timed_out, guint teardown_ms,
+                                       void *user_data);
+
+/**
+ * Read-only view on the hot scan state of all cached devices
+ *
+ * Every array has size entries and is indexed by device id (see binc_device_get_id). Slots with a NULL device
+ * are unused. Addresses are packed into the lower 48 bits and last_seen is in g_get_monotonic_time() units,
+ * 0 means the device was not seen since it was added.
+ * The advertising interval is estimated in milliseconds, 0 means it is not known yet.
+ * The view is only valid until control returns to the main loop.
+ */
+typedef struct binc_scan_state_view {
+    guint size;
+    const Device *const *devices;
+    const guint64 *addresses;
+    const gint16 *rssi;
+    const gint16 *tx_power;
+    const gint64 *last_seen;
+    const guint32 *payload_hash;
+    const guint32 *adv_interval;
+} ScanStateView;
+
+// Counters and queue depths of an adapter, see binc_adapter_get_stats()
+typedef struct binc_adapter_stats {
+    guint devices;
+    guint connected_devices;
+    guint discovery_queue_depth;
+    guint pending_property_fetches;
+    gboolean overloaded;
+    guint64 shed_count;
+    guint64 notifications;
+} AdapterStats;
 
 Adapter *binc_adapter_get_default(GDBusConnection *dbusConnection);
 
@@ -54,18 +96,156 @@ GPtrArray *binc_adapter_find_all(GDBusConnection *dbusConnection);
 
 void binc_adapter_free(Adapter *adapter);
 
+/**
+ * Disconnect all connected devices and free the adapter
+ *
+ * All Disconnect calls are sent at once. The adapter is freed when all of them have completed, or when the
+ * deadline has passed, whichever comes first. The adapter must not be used after calling this function.
+ *
+ * @param adapter the adapter
+ * @param deadline_ms the maximum time to wait for the devices to disconnect
+ * @param callback called after the adapter has been freed, with the number of devices that disconnected,
+ * failed to disconnect or did not disconnect before the deadline, and the time the teardown took.
+ * Can be called before this function returns if no devices are connected.
+ * @param user_data passed to the callback
+ */
+void binc_adapter_shutdown(Adapter *adapter, guint deadline_ms, AdapterShutdownCallback callback, void *user_data);
+
 void binc_adapter_start_discovery(Adapter *adapter);
 
 void binc_adapter_stop_discovery(Adapter *adapter);
 
 void binc_adapter_set_discovery_filter(Adapter *adapter, short rssi_threshold, const GPtrArray *service_uuids, const char *pattern);
 
+/**
+ * Add a discovery session with its own filter and callback
+ *
+ * Several sessions can be active at the same time. Bluez is programmed with the union of all filters,
+ * and every discovery result is checked against each session's own filter before it is delivered.
+ * Starting and stopping discovery is still done for the adapter as a whole.
+ *
+ * @param adapter the adapter
+ * @param rssi_threshold the minimum RSSI, between -127 and 20
+ * @param service_uuids the service UUIDs to filter on, or NULL
+ * @param pattern the prefix of an address or name to filter on, or NULL
+ * @param callback the callback that receives the matching discovery results
+ * @param user_data user data for this session
+ * @return the session, which remains owned by the adapter
+ */
+DiscoverySession *binc_adapter_add_discovery_session(Adapter *adapter, short rssi_threshold,
+                                                     const GPtrArray *service_uuids, const char *pattern,
+                                                     DiscoverySessionResultCallback callback, void *user_data);
+
+/**
+ * Remove a discovery session. It is safe to call this from the session's callback.
+ */
+void binc_adapter_remove_discovery_session(Adapter *adapter, DiscoverySession *session);
+
+void *binc_discovery_session_get_user_data(const DiscoverySession *session);
+
 void binc_adapter_remove_device(Adapter *adapter, Device *device);
 
+/**
+ * Remove all cached devices matching a filter from Bluez, for example to clean up stale bonds
+ *
+ * The RemoveDevice calls are pipelined with at most 'window' calls outstanding. Every removed device is
+ * purged from the adapter's cache as soon as Bluez confirms the removal.
+ *
+ * @param adapter the adapter
+ * @param filter returns TRUE for devices that should be removed
+ * @param window the maximum number of outstanding RemoveDevice calls, or 0 for the default of 8
+ * @param progress_callback called after every reply; the removal is done when removed + failed == total. May be NULL.
+ * @param user_data passed to the filter and progress callback
+ * @return the number of devices that will be removed
+ */
+guint binc_adapter_remove_devices(Adapter *adapter, AdapterDeviceFilter filter, guint window,
+                                  AdapterBulkRemovalProgressCallback progress_callback, void *user_data);
+
 GList *binc_adapter_get_devices(const Adapter *adapter);
 
 GList *binc_adapter_get_connected_devices(const Adapter *adapter);
 
+/**
+ * Find the cached devices advertising manufacturer data for a company id
+ *
+ * The query is answered from an index that is kept up to date while devices are discovered.
+ *
+ * @param adapter the adapter
+ * @param company_id the Bluetooth SIG company identifier, e.g. 0x004C
+ * @param min_rssi only return devices with at least this RSSI, use -255 to include all devices
+ * @return an unordered list of devices, free with g_list_free()
+ */
+GList *binc_adapter_find_devices_by_manufacturer(const Adapter *adapter, guint16 company_id, short min_rssi);
+
+GList *binc_adapter_find_devices_by_service(const Adapter *adapter, const char *service_uuid, short min_rssi);
+
+GList *binc_adapter_find_devices_by_rssi(const Adapter *adapter, short min_rssi);
+
+/**
+ * Get the cached devices with the strongest RSSI
+ *
+ * @param adapter the adapter
+ * @param count the maximum number of devices to return
+ * @return a list of at most count devices sorted by descending RSSI, free with g_list_free()
+ */
+GList *binc_adapter_get_strongest_devices(const Adapter *adapter, guint count);
+
+Device *binc_adapter_get_device_by_id(const Adapter *adapter, guint id);
+
+void binc_adapter_get_scan_state(const Adapter *adapter, ScanStateView *view);
+
+/**
+ * Find the cached devices that have not been seen for a while
+ *
+ * A device is seen when its RSSI or advertising payload is updated. Devices that were never seen are included.
+ *
+ * @param adapter the adapter
+ * @param max_age_seconds the maximum time in seconds since the device was last seen
+ * @return an unordered list of devices, free with g_list_free()
+ */
+GList *binc_adapter_find_devices_not_seen_since(const Adapter *adapter, guint max_age_seconds);
+
+/**
+ * Get the estimated advertising interval of a device
+ *
+ * The estimate is learned from the arrival times of advertisements while discovery is running. It is only
+ * reliable once a discovery filter is set, see binc_adapter_set_discovery_filter(), because the filter asks
+ * Bluez for DuplicateData. Otherwise Bluez only reports advertisements that change the RSSI or payload and
+ * the estimate comes out too high.
+ *
+ * @param adapter the adapter
+ * @param device the device
+ * @return the interval in milliseconds, or 0 if it is not known yet
+ */
+guint binc_adapter_get_advertising_interval(const Adapter *adapter, const Device *device);
+
+void binc_adapter_watch_device(Adapter *adapter, const char *address);
+
+void binc_adapter_unwatch_device(Adapter *adapter, const char *address);
+
+/**
+ * Start discovery that switches itself on and off to save energy
+ *
+ * Scan windows are planned from the advertising intervals of the watched devices, so each of them is
+ * detected within the target latency while discovery is off as much as possible. Discovery runs
+ * continuously while no devices are watched or an interval is still unknown.
+ *
+ * @param adapter the adapter
+ * @param target_latency_ms the maximum time it may take to detect a watched device
+ */
+void binc_adapter_start_adaptive_discovery(Adapter *adapter, guint target_latency_ms);
+
+void binc_adapter_stop_adaptive_discovery(Adapter *adapter);
+
+/**
+ * Get the current plan of adaptive discovery
+ *
+ * @param adapter the adapter
+ * @param window_ms the time discovery is on per period
+ * @param period_ms the length of a period, equal to window_ms when discovery runs continuously
+ */
+void binc_adapter_get_adaptive_discovery_plan(const Adapter *adapter, guint *window_ms, guint *period_ms);
+
 Device *binc_adapter_get_device_by_path(const Adapter *adapter, const char *path); // make this internal
 
 Device *binc_adapter_get_device_by_address(const Adapter *adapter, const char *address);
@@ -106,6 +286,47 @@ Advertisement *binc_adapter_get_advertisement(const Adapter *adapter);
 
 void binc_adapter_set_discovery_cb(Adapter *adapter, AdapterDiscoveryResultCallback callback);
 
+/**
+ * Set the main loop priority at which advertising updates of discovered devices are handled
+ *
+ * Updates that only carry advertising data (RSSI, manufacturer data, service data, tx power) are queued and
+ * handled in small batches at this priority. Connection state changes, notifications and GATT replies keep
+ * being handled at G_PRIORITY_DEFAULT, so they are not delayed by a flood of discovery results.
+ *
+ * @param adapter the adapter
+ * @param priority the priority, defaults to G_PRIORITY_DEFAULT_IDLE
+ */
+void binc_adapter_set_discovery_priority(Adapter *adapter, gint priority);
+
+gint binc_adapter_get_discovery_priority(const Adapter *adapter);
+
+/**
+ * Shed advertising updates when the main loop can't keep up with them
+ *
+ * When more than max_queue_depth advertising updates are waiting, or the oldest one has been waiting for more than
+ * max_lag_ms, the adapter enters overload mode. In overload mode only 1 in 10 advertising updates is handled,
+ * except for devices that are exempted. Overload mode ends when both values are back below half their threshold.
+ *
+ * @param adapter the adapter
+ * @param max_queue_depth the maximum number of waiting advertising updates, or 0 to ignore the queue depth
+ * @param max_lag_ms the maximum waiting time in milliseconds, or 0 to ignore the lag
+ */
+void binc_adapter_set_load_shedding(Adapter *adapter, guint max_queue_depth, guint max_lag_ms);
+
+void binc_adapter_add_load_shedding_exemption(Adapter *adapter, const char *address);
+
+void binc_adapter_remove_load_shedding_exemption(Adapter *adapter, const char *address);
+
+gboolean binc_adapter_is_overloaded(const Adapter *adapter);
+
+guint64 binc_adapter_get_shed_count(const Adapter *adapter);
+
+// Fill in the current counters and queue depths.
+// Counting the connected devices and notifications visits every cached device.
+void binc_adapter_get_stats(const Adapter *adapter, AdapterStats *stats);
+
+void binc_adapter_set_load_shedding_cb(Adapter *adapter, AdapterLoadSheddingCallback callback);
+
 void binc_adapter_set_device_removal_cb(Adapter *adapter, AdapterDeviceRemovalCallback callback);
 
 void binc_adapter_set_discovery_state_cb(Adapter *adapter, AdapterDiscoveryStateChangeCallback callback);
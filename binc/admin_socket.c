@@ -0,0 +1,378 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gio/gio.h>
+#include "admin_socket.h"
+#include "adapter.h"
+#include "adapter_internal.h"
+#include "device.h"
+#include "logger.h"
+
+static const char *const TAG = "AdminSocket";
+
+// Queries are short, so a client sending longer lines is disconnected
+static const gsize MAX_QUERY_LENGTH = 256;
+static const gsize MAC_ADDRESS_LENGTH = 17;
+
+struct binc_admin_socket {
+    Adapter *adapter; // Borrowed
+    char *path; // Owned
+    GSocket *socket; // Owned
+    GSource *source; // Owned
+    GList *clients; // Owned
+    guint64 last_notifications;
+    gint64 last_stats_time;
+};
+
+typedef struct admin_client {
+    AdminSocket *admin; // Borrowed
+    GSocket *socket; // Owned
+    GSource *source; // Owned
+    GIOCondition condition;
+    GString *query; // Owned
+    GString *answer; // Owned
+} AdminClient;
+
+static const char *bonding_state_names[] = {
+        [BINC_BOND_NONE] = "none",
+        [BINC_BONDING] = "bonding",
+        [BINC_BONDED] = "bonded"
+};
+
+static void add_device_line(GString *answer, const Device *device) {
+    const char *name = binc_device_get_name(device);
+    g_string_append_printf(answer, "%s %s rssi=%d notifications=%lu name=%s\n",
+                           binc_device_get_address(device),
+                           binc_device_get_connection_state_name(device),
+                           binc_device_get_rssi(device),
+                           (unsigned long) binc_device_get_notification_count(device),
+                           name != NULL ? name : "-");
+}
+
+static void answer_devices(AdminSocket *admin, GString *answer) {
+    GList *devices = binc_adapter_get_devices(admin->adapter);
+    for (GList *iterator = devices; iterator; iterator = iterator->next) {
+        add_device_line(answer, (const Device *) iterator->data);
+    }
+    g_list_free(devices);
+}
+
+static void answer_stats(AdminSocket *admin, GString *answer) {
+    AdapterStats stats;
+    binc_adapter_get_stats(admin->adapter, &stats);
+
+    // The notification rate is averaged over the time since the previous stats query
+    gint64 now = g_get_monotonic_time();
+    guint rate = 0;
+    if (admin->last_stats_time > 0 && now > admin->last_stats_time && stats.notifications >= admin->last_notifications) {
+        rate = (guint) ((gint64) (stats.notifications - admin->last_notifications) * G_USEC_PER_SEC /
+                        (now - admin->last_stats_time));
+    }
+    admin->last_notifications = stats.notifications;
+    admin->last_stats_time = now;
+
+    g_string_append_printf(answer, "adapter=%s discovery=%s devices=%u connected=%u discovery_queue=%u "
+                                   "property_fetches=%u overloaded=%d shed=%lu notifications=%lu "
+                                   "notifications_per_second=%u\n",
+                           binc_adapter_get_address(admin->adapter),
+                           binc_adapter_get_discovery_state_name(admin->adapter),
+                           stats.devices,
+                           stats.connected_devices,
+                           stats.discovery_queue_depth,
+                           stats.pending_property_fetches,
+                           stats.overloaded,
+                           (unsigned long) stats.shed_count,
+                           (unsigned long) stats.notifications,
+                           rate);
+}
+
+static void answer_device(AdminSocket *admin, GString *answer, const char *address) {
+    // Queries come from outside the process, so don't let a malformed address hit the adapter's assertion
+    Device *device = NULL;
+    if (strlen(address) == MAC_ADDRESS_LENGTH) {
+        device = binc_adapter_get_device_by_address(admin->adapter, address);
+    }
+    if (device == NULL) {
+        g_string_append(answer, "error unknown device\n");
+        return;
+    }
+
+    const char *name = binc_device_get_name(device);
+    g_string_append_printf(answer, "address=%s\nname=%s\npath=%s\nid=%u\nstate=%s\nbonding=%s\nrssi=%d\n"
+                                   "tx_power=%d\nmtu=%u\nnotifications=%lu\n",
+                           binc_device_get_address(device),
+                           name != NULL ? name : "-",
+                           binc_device_get_path(device),
+                           binc_device_get_id(device),
+                           binc_device_get_connection_state_name(device),
+                           bonding_state_names[binc_device_get_bonding_state(device)],
+                           binc_device_get_rssi(device),
+                           binc_device_get_txpower(device),
+                           binc_device_get_mtu(device),
+                           (unsigned long) binc_device_get_notification_count(device));
+
+    guint interval = binc_adapter_get_advertising_interval(admin->adapter, device);
+    g_string_append_printf(answer, "advertising_interval_ms=%u\n", interval);
+
+    ScanStateView view;
+    binc_adapter_get_scan_state(admin->adapter, &view);
+    guint id = binc_device_get_id(device);
+    if (id > 0 && id < view.size && view.last_seen[id] > 0) {
+        g_string_append_printf(answer, "last_seen_ms=%ld\n",
+                               (long) ((g_get_monotonic_time() - view.last_seen[id]) / 1000));
+    }
+}
+
+static void answer_query(AdminSocket *admin, GString *answer, char *query) {
+    g_strstrip(query);
+    log_debug(TAG, "query '%s'", query);
+
+    if (g_str_equal(query, "devices")) {
+        answer_devices(admin, answer);
+    } else if (g_str_equal(query, "stats")) {
+        answer_stats(admin, answer);
+    } else if (g_str_has_prefix(query, "device ")) {
+        answer_device(admin, answer, g_strstrip(query + strlen("device ")));
+    } else if (strlen(query) > 0) {
+        g_string_append(answer, "error unknown query\n");
+    }
+    g_string_append_c(answer, '\n');
+}
+
+static void admin_client_free(AdminClient *client) {
+    g_assert(client != NULL);
+
+    if (client->source != NULL) {
+        g_source_destroy(client->source);
+        g_source_unref(client->source);
+        client->source = NULL;
+    }
+
+    if (client->socket != NULL) {
+        g_socket_close(client->socket, NULL);
+        g_object_unref(client->socket);
+        client->socket = NULL;
+    }
+
+    g_string_free(client->query, TRUE);
+    client->query = NULL;
+    g_string_free(client->answer, TRUE);
+    client->answer = NULL;
+    g_free(client);
+}
+
+static void close_client(AdminClient *client) {
+    AdminSocket *admin = client->admin;
+    admin->clients = g_list_remove(admin->clients, client);
+    admin_client_free(client);
+}
+
+static gboolean binc_internal_client_ready(GSocket *socket, GIOCondition condition, gpointer user_data);
+
+static void watch_client(AdminClient *client, GIOCondition condition) {
+    if (client->source != NULL) {
+        if (client->condition == condition) return;
+
+        g_source_destroy(client->source);
+        g_source_unref(client->source);
+    }
+
+    client->condition = condition;
+    client->source = g_socket_create_source(client->socket, condition, NULL);
+    g_source_set_callback(client->source, G_SOURCE_FUNC(binc_internal_client_ready), client, NULL);
+    g_source_attach(client->source, NULL);
+}
+
+// Returns FALSE if the client is gone
+static gboolean send_answer(AdminClient *client) {
+    while (client->answer->len > 0) {
+        GError *error = NULL;
+        gssize sent = g_socket_send(client->socket, client->answer->str, client->answer->len, NULL, &error);
+        if (sent < 0) {
+            gboolean would_block = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK);
+            g_clear_error(&error);
+            return would_block;
+        }
+        g_string_erase(client->answer, 0, sent);
+    }
+    return TRUE;
+}
+
+// Returns FALSE if the client is gone or sends a query that is too long
+static gboolean receive_queries(AdminClient *client) {
+    gchar buffer[128];
+    GError *error = NULL;
+    gssize received = g_socket_receive(client->socket, buffer, sizeof(buffer), NULL, &error);
+    if (received < 0) {
+        gboolean would_block = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK);
+        g_clear_error(&error);
+        return would_block;
+    }
+    if (received == 0) return FALSE;
+
+    g_string_append_len(client->query, buffer, received);
+    return client->query->len <= MAX_QUERY_LENGTH || memchr(client->query->str, '\n', client->query->len) != NULL;
+}
+
+// Returns FALSE if no complete query was received yet
+static gboolean answer_next_query(AdminClient *client) {
+    char *end = memchr(client->query->str, '\n', client->query->len);
+    if (end == NULL) return FALSE;
+
+    *end = '\0';
+    answer_query(client->admin, client->answer, client->query->str);
+    g_string_erase(client->query, 0, end - client->query->str + 1);
+    return TRUE;
+}
+
+static gboolean binc_internal_client_ready(GSocket *socket, GIOCondition condition, gpointer user_data) {
+    AdminClient *client = (AdminClient *) user_data;
+    g_assert(client != NULL);
+
+    // Only read while no answer is waiting, so a client that doesn't read its answers can't make them pile up
+    gboolean alive = (condition & (G_IO_ERR | G_IO_NVAL)) == 0;
+    if (alive && client->answer->len > 0) {
+        alive = send_answer(client);
+    } else if (alive && (condition & (G_IO_IN | G_IO_HUP)) != 0) {
+        alive = receive_queries(client);
+    }
+
+    while (alive && client->answer->len == 0 && answer_next_query(client)) {
+        alive = send_answer(client);
+    }
+
+    // The source of the client is replaced or destroyed, so this one is never dispatched again
+    if (alive) {
+        watch_client(client, client->answer->len > 0 ? G_IO_OUT : G_IO_IN);
+    } else {
+        close_client(client);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean binc_internal_admin_accept(GSocket *socket, GIOCondition condition, gpointer user_data) {
+    AdminSocket *admin = (AdminSocket *) user_data;
+    g_assert(admin != NULL);
+
+    GError *error = NULL;
+    GSocket *client_socket;
+    while ((client_socket = g_socket_accept(admin->socket, NULL, &error)) != NULL) {
+        g_socket_set_blocking(client_socket, FALSE);
+
+        AdminClient *client = g_new0(AdminClient, 1);
+        client->admin = admin;
+        client->socket = client_socket;
+        client->query = g_string_new(NULL);
+        client->answer = g_string_new(NULL);
+        watch_client(client, G_IO_IN);
+        admin->clients = g_list_prepend(admin->clients, client);
+    }
+
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+        log_error(TAG, "failed to accept client (error %d: %s)", error->code, error->message);
+    }
+    g_clear_error(&error);
+    return G_SOURCE_CONTINUE;
+}
+
+AdminSocket *binc_admin_socket_create(Adapter *adapter, const char *path) {
+    g_return_val_if_fail (adapter != NULL, NULL);
+    g_return_val_if_fail (path != NULL, NULL);
+
+    GError *error = NULL;
+    GSocket *socket = g_socket_new(G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, &error);
+    if (socket == NULL) {
+        log_error(TAG, "failed to create socket (error %d: %s)", error->code, error->message);
+        g_clear_error(&error);
+        return NULL;
+    }
+
+    // Remove the socket of a previous run, but never anything else that happens to live at the path
+    struct stat status;
+    if (lstat(path, &status) == 0) {
+        if (!S_ISSOCK(status.st_mode)) {
+            log_error(TAG, "'%s' exists and is not a socket", path);
+            g_object_unref(socket);
+            return NULL;
+        }
+        unlink(path);
+    }
+
+    // The socket exposes the state of all devices, so only the owner may connect
+    GSocketAddress *address = g_unix_socket_address_new(path);
+    gboolean bound = g_socket_bind(socket, address, FALSE, &error);
+    g_object_unref(address);
+    if (bound && chmod(path, S_IRUSR | S_IWUSR) != 0) {
+        log_error(TAG, "failed to restrict access to '%s' (%s)", path, g_strerror(errno));
+        g_object_unref(socket);
+        unlink(path);
+        return NULL;
+    }
+    if (!bound || !g_socket_listen(socket, &error)) {
+        log_error(TAG, "failed to listen on '%s' (error %d: %s)", path, error->code, error->message);
+        g_clear_error(&error);
+        g_object_unref(socket);
+        if (bound) unlink(path);
+        return NULL;
+    }
+    g_socket_set_blocking(socket, FALSE);
+
+    AdminSocket *admin = g_new0(AdminSocket, 1);
+    admin->adapter = adapter;
+    binc_adapter_attach_admin_socket(adapter);
+    admin->path = g_strdup(path);
+    admin->socket = socket;
+    admin->source = g_socket_create_source(socket, G_IO_IN, NULL);
+    g_source_set_callback(admin->source, G_SOURCE_FUNC(binc_internal_admin_accept), admin, NULL);
+    g_source_attach(admin->source, NULL);
+
+    log_debug(TAG, "listening on '%s'", path);
+    return admin;
+}
+
+void binc_admin_socket_free(AdminSocket *admin) {
+    g_assert(admin != NULL);
+
+    g_list_free_full(admin->clients, (GDestroyNotify) admin_client_free);
+    admin->clients = NULL;
+
+    g_source_destroy(admin->source);
+    g_source_unref(admin->source);
+    admin->source = NULL;
+
+    g_socket_close(admin->socket, NULL);
+    g_object_unref(admin->socket);
+    admin->socket = NULL;
+
+    unlink(admin->path);
+    g_free(admin->path);
+    admin->path = NULL;
+
+    binc_adapter_detach_admin_socket(admin->adapter);
+    admin->adapter = NULL;
+    g_free(admin);
+}
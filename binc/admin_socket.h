@@ -0,0 +1,59 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_ADMIN_SOCKET_H
+#define BINC_ADMIN_SOCKET_H
+
+#include <glib.h>
+#include "forward_decl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Serve queries about the live state of an adapter on a Unix domain socket
+ *
+ * The socket is served from the main context, so queries are answered from the in-memory state without locking.
+ * Every query is one line and every answer ends with an empty line. Supported queries are:
+ *
+ *   devices         one line per cached device
+ *   stats           counters and queue depths of the adapter
+ *   device <addr>   the state of one device
+ *
+ * For example: echo stats | socat - UNIX-CONNECT:/run/binc.sock
+ *
+ * @param adapter the adapter to report on, the admin socket must be freed before the adapter is freed or shut down
+ * @param path the path of the socket, an existing socket at this path is replaced
+ * @return the admin socket, or NULL if the socket could not be created
+ */
+AdminSocket *binc_admin_socket_create(Adapter *adapter, const char *path);
+
+// Close the socket and all client connections, and remove the socket file. Call this before freeing the adapter
+void binc_admin_socket_free(AdminSocket *admin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_ADMIN_SOCKET_H
@@ -25,6 +25,7 @@
 #include "adapter.h"
 #include "logger.h"
 #include "utility.h"
+#include "dbus_transport.h"
 
 static const char *const TAG = "Advertisement";
 
@@ -38,6 +39,7 @@ struct binc_advertisement {
     GHashTable *service_data; // Owned
     GHashTable *scan_response_service_data; // Owned
     guint registration_id;
+    guint register_count;
     guint32 min_interval;
     gboolean min_interval_enabled;
     guint32 max_interval;
@@ -201,6 +203,11 @@ void binc_advertisement_register(Advertisement *advertisement, const Adapter *ad
     g_assert(advertisement != NULL);
     g_assert(adapter != NULL);
 
+    // The same advertisement can be advertised on several adapters, but the object is only exported once
+    if (advertisement->register_count++ > 0) {
+        return;
+    }
+
     log_debug(TAG, "binc_advertisement_register_dynamic");
 
     // Use a GString to build the XML dynamically
@@ -289,10 +296,11 @@ void binc_advertisement_register(Advertisement *advertisement, const Adapter *ad
         log_debug(TAG, "failed to parse generated XML for dbus node: %s", error ? error->message : "unknown");
         if (error) g_clear_error(&error);
         g_free((gpointer)final_xml);
+        advertisement->register_count = 0;
         return;
     }
 
-    advertisement->registration_id = g_dbus_connection_register_object(
+    advertisement->registration_id = binc_dbus_register_object(
         binc_adapter_get_dbus_connection(adapter),
         advertisement->path,
         info->interfaces[0],
@@ -305,6 +313,7 @@ void binc_advertisement_register(Advertisement *advertisement, const Adapter *ad
     if (error != NULL) {
         log_debug(TAG, "registering advertisement failed: %s", error->message);
         g_clear_error(&error);
+        advertisement->register_count = 0;
     }
 
     g_dbus_node_info_unref(info);
@@ -314,11 +323,17 @@ void binc_advertisement_unregister(Advertisement *advertisement, const Adapter *
     g_assert(advertisement != NULL);
     g_assert(adapter != NULL);
 
-    gboolean result = g_dbus_connection_unregister_object(binc_adapter_get_dbus_connection(adapter),
-                                                          advertisement->registration_id);
+    // Keep the object exported while other adapters are still advertising it
+    if (advertisement->register_count == 0 || --advertisement->register_count > 0) {
+        return;
+    }
+
+    gboolean result = binc_dbus_unregister_object(binc_adapter_get_dbus_connection(adapter),
+                                                  advertisement->registration_id);
     if (!result) {
         log_debug(TAG, "failed to unregister advertisement");
     }
+    advertisement->registration_id = 0;
 }
 
 static void byte_array_free(GByteArray *byteArray) { g_byte_array_free(byteArray, TRUE); }
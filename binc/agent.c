@@ -26,6 +26,7 @@
 #include "device.h"
 #include "device_internal.h"
 #include "logger.h"
+#include "dbus_transport.h"
 #include <errno.h>
 #include <glib.h>
 #include <stdio.h>
@@ -188,11 +189,11 @@ static int bluez_register_agent(Agent *agent) {
         return EINVAL;
     }
 
-    agent->registration_id = g_dbus_connection_register_object(agent->connection,
-                                                               agent->path,
-                                                               info->interfaces[0],
-                                                               &agent_method_table,
-                                                               agent, NULL, &error);
+    agent->registration_id = binc_dbus_register_object(agent->connection,
+                                                       agent->path,
+                                                       info->interfaces[0],
+                                                       &agent_method_table,
+                                                       agent, NULL, &error);
     g_dbus_node_info_unref(info);
     return 0;
 }
@@ -204,17 +205,17 @@ static int binc_agentmanager_call_method(GDBusConnection *connection, const gcha
     GVariant *result;
     GError *error = NULL;
 
-    result = g_dbus_connection_call_sync(connection,
-                                         "org.bluez",
-                                         "/org/bluez",
-                                         "org.bluez.AgentManager1",
-                                         method,
-                                         param,
-                                         NULL,
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+    result = binc_dbus_call_sync(connection,
+                                 "org.bluez",
+                                 "/org/bluez",
+                                 "org.bluez.AgentManager1",
+                                 method,
+                                 param,
+                                 NULL,
+                                 G_DBUS_CALL_FLAGS_NONE,
+                                 -1,
+                                 NULL,
+                                 &error);
 
     if (result != NULL) {
         g_variant_unref(result);
@@ -289,7 +290,7 @@ void binc_agent_free(Agent *agent) {
     g_assert (agent != NULL);
     binc_agentmanager_unregister_agent(agent);
 
-    gboolean result = g_dbus_connection_unregister_object(agent->connection, agent->registration_id);
+    gboolean result = binc_dbus_unregister_object(agent->connection, agent->registration_id);
     if (!result) {
         log_debug(TAG, "could not unregister agent");
     }
@@ -26,6 +26,8 @@
 #include "logger.h"
 #include "characteristic.h"
 #include "utility.h"
+#include "dbus_transport.h"
+#include "ring_buffer.h"
 #include <errno.h>
 
 #define GATT_SERV_INTERFACE "org.bluez.GattService1"
@@ -48,6 +50,14 @@ static const gchar object_manager_xml[] =
         "    <method name='GetManagedObjects'>"
         "        <arg type='a{oa{sa{sv}}}' name='object_paths_interfaces_and_properties' direction='out'/>"
         "    </method>"
+        "    <signal name='InterfacesAdded'>"
+        "        <arg type='o' name='object_path'/>"
+        "        <arg type='a{sa{sv}}' name='interfaces_and_properties'/>"
+        "    </signal>"
+        "    <signal name='InterfacesRemoved'>"
+        "        <arg type='o' name='object_path'/>"
+        "        <arg type='as' name='interfaces'/>"
+        "    </signal>"
         "  </interface>"
         "</node>";
 
@@ -112,6 +122,11 @@ struct binc_application {
     guint registration_id;
     GDBusConnection *connection;
     GHashTable *services;
+    GHashTable *centrals; // Owned
+    guint next_service_id;
+    GDBusNodeInfo *service_info; // Owned
+    GDBusNodeInfo *characteristic_info; // Owned
+    GDBusNodeInfo *descriptor_info; // Owned
     onLocalCharacteristicWrite on_char_write;
     onLocalCharacteristicRead on_char_read;
     onLocalCharacteristicUpdated on_char_updated;
@@ -127,10 +142,11 @@ typedef struct binc_local_service {
     char *uuid;
     guint registration_id;
     GHashTable *characteristics;
+    guint next_char_id;
     Application *application;
 } LocalService;
 
-typedef struct local_characteristic {
+struct local_characteristic {
     char *service_uuid;
     char *service_path;
     char *uuid;
@@ -141,8 +157,48 @@ typedef struct local_characteristic {
     GList *flags;
     gboolean notifying;
     GHashTable *descriptors;
+    guint next_desc_id;
+    GHashTable *central_stats; // Owned
+    onLocalCharacteristicProvideValue value_provider;
+    LocalStream *stream; // Borrowed
     Application *application;
-} LocalCharacteristic;
+};
+
+// State of a remote central as seen in its read and write requests
+typedef struct local_central {
+    char *address;
+    char *adapter_path;
+    char *link_type;
+    guint16 mtu;
+    guint request_count;
+} LocalCentral;
+
+// Requests of a remote central for one characteristic
+typedef struct local_central_stats {
+    guint read_count;
+    guint write_count;
+} LocalCentralStats;
+
+// Default ATT mtu, used as long as no request reported the mtu
+static const guint16 DEFAULT_STREAM_MTU = 23;
+static const gsize DEFAULT_STREAM_BUFFER_SIZE = 4096;
+static const guint DEFAULT_STREAM_BURST = 4;
+static const guint DEFAULT_STREAM_INTERVAL_MS = 15;
+
+struct binc_local_stream {
+    Application *application; // Borrowed
+    LocalCharacteristic *rx; // Borrowed
+    LocalCharacteristic *tx; // Borrowed
+    RingBuffer *rx_buffer; // Owned
+    RingBuffer *tx_buffer; // Owned
+    guint16 mtu;
+    guint burst;
+    guint interval;
+    guint pacing_id;
+    onLocalStreamReadable on_readable;
+    onLocalStreamDrained on_drained;
+    void *user_data; // Borrowed
+};
 
 typedef struct local_descriptor {
     char *path;
@@ -157,14 +213,29 @@ typedef struct local_descriptor {
     Application *application;
 } LocalDescriptor;
 
+static void binc_local_central_free(LocalCentral *localCentral) {
+    g_assert(localCentral != NULL);
+
+    g_free(localCentral->address);
+    localCentral->address = NULL;
+
+    g_free(localCentral->link_type);
+    localCentral->link_type = NULL;
+
+    g_free(localCentral->adapter_path);
+    localCentral->adapter_path = NULL;
+
+    g_free(localCentral);
+}
+
 static void binc_local_desc_free(LocalDescriptor *localDescriptor) {
     g_assert(localDescriptor != NULL);
 
     log_debug(TAG, "freeing descriptor %s", localDescriptor->path);
 
     if (localDescriptor->registration_id != 0) {
-        gboolean result = g_dbus_connection_unregister_object(localDescriptor->application->connection,
-                                                              localDescriptor->registration_id);
+        gboolean result = binc_dbus_unregister_object(localDescriptor->application->connection,
+                                                      localDescriptor->registration_id);
         if (!result) {
             log_debug(TAG, "error: could not unregister descriptor %s", localDescriptor->path);
         }
@@ -204,14 +275,23 @@ static void binc_local_char_free(LocalCharacteristic *localCharacteristic) {
 
     log_debug(TAG, "freeing characteristic %s", localCharacteristic->path);
 
+    if (localCharacteristic->stream != NULL) {
+        binc_local_stream_free(localCharacteristic->stream);
+    }
+
     if (localCharacteristic->descriptors != NULL) {
         g_hash_table_destroy(localCharacteristic->descriptors);
         localCharacteristic->descriptors = NULL;
     }
 
+    if (localCharacteristic->central_stats != NULL) {
+        g_hash_table_destroy(localCharacteristic->central_stats);
+        localCharacteristic->central_stats = NULL;
+    }
+
     if (localCharacteristic->registration_id != 0) {
-        gboolean result = g_dbus_connection_unregister_object(localCharacteristic->application->connection,
-                                                              localCharacteristic->registration_id);
+        gboolean result = binc_dbus_unregister_object(localCharacteristic->application->connection,
+                                                      localCharacteristic->registration_id);
         if (!result) {
             log_debug(TAG, "error: could not unregister service %s", localCharacteristic->path);
         }
@@ -254,8 +334,8 @@ void binc_local_service_free(LocalService *localService) {
     }
 
     if (localService->registration_id != 0) {
-        gboolean result = g_dbus_connection_unregister_object(localService->application->connection,
-                                                              localService->registration_id);
+        gboolean result = binc_dbus_unregister_object(localService->application->connection,
+                                                      localService->registration_id);
         if (!result) {
             log_debug(TAG, "error: could not unregister service %s", localService->path);
         }
@@ -273,6 +353,7 @@ void binc_local_service_free(LocalService *localService) {
 
 typedef struct read_options {
     char *device;
+    char *adapter_path;
     guint16 mtu;
     guint16 offset;
     char *link_type;
@@ -281,6 +362,7 @@ typedef struct read_options {
 void read_options_free(ReadOptions *options) {
     if (options->link_type != NULL) g_free(options->link_type);
     if (options->device != NULL) g_free(options->device);
+    if (options->adapter_path != NULL) g_free(options->adapter_path);
     g_free(options);
 }
 
@@ -300,6 +382,7 @@ static ReadOptions *parse_read_options(GVariant *params) {
             options->mtu = g_variant_get_uint16(property_value);
         } else if (g_str_equal(property_name, "device")) {
             options->device = path_to_address(g_variant_get_string(property_value, NULL));
+            options->adapter_path = g_path_get_dirname(g_variant_get_string(property_value, NULL));
         } else if (g_str_equal(property_name, "link")) {
             options->link_type = g_strdup(g_variant_get_string(property_value, NULL));
         }
@@ -315,6 +398,7 @@ static ReadOptions *parse_read_options(GVariant *params) {
 typedef struct write_options {
     char *write_type;
     char *device;
+    char *adapter_path;
     guint16 mtu;
     guint16 offset;
     char *link_type;
@@ -323,6 +407,7 @@ typedef struct write_options {
 void write_options_free(WriteOptions *options) {
     if (options->link_type != NULL) g_free(options->link_type);
     if (options->device != NULL) g_free(options->device);
+    if (options->adapter_path != NULL) g_free(options->adapter_path);
     if (options->write_type != NULL) g_free(options->write_type);
     g_free(options);
 }
@@ -344,6 +429,7 @@ static WriteOptions *parse_write_options(GVariant *optionsVariant) {
             options->mtu = g_variant_get_uint16(property_value);
         } else if (g_str_equal(property_name, "device")) {
             options->device = path_to_address(g_variant_get_string(property_value, NULL));
+            options->adapter_path = g_path_get_dirname(g_variant_get_string(property_value, NULL));
         } else if (g_str_equal(property_name, "link")) {
             options->link_type = g_strdup(g_variant_get_string(property_value, NULL));
         }
@@ -355,6 +441,45 @@ static WriteOptions *parse_write_options(GVariant *optionsVariant) {
     return options;
 }
 
+static LocalCentral *track_central(Application *application, const char *address, const char *adapter_path,
+                                   guint16 mtu, const char *link_type) {
+    if (address == NULL) return NULL;
+
+    LocalCentral *localCentral = g_hash_table_lookup(application->centrals, address);
+    if (localCentral == NULL) {
+        localCentral = g_new0(LocalCentral, 1);
+        localCentral->address = g_strdup(address);
+        g_hash_table_insert(application->centrals, g_strdup(address), localCentral);
+        log_debug(TAG, "tracking central %s", address);
+    }
+
+    // A central may reconnect through another adapter when the application is registered on several
+    if (adapter_path != NULL && g_strcmp0(localCentral->adapter_path, adapter_path) != 0) {
+        g_free(localCentral->adapter_path);
+        localCentral->adapter_path = g_strdup(adapter_path);
+    }
+
+    // Bluez only passes the mtu and link type if it knows them, so keep the last known values
+    if (mtu > 0) {
+        localCentral->mtu = mtu;
+    }
+    if (link_type != NULL && g_strcmp0(localCentral->link_type, link_type) != 0) {
+        g_free(localCentral->link_type);
+        localCentral->link_type = g_strdup(link_type);
+    }
+    localCentral->request_count++;
+    return localCentral;
+}
+
+static LocalCentralStats *get_central_stats(LocalCharacteristic *characteristic, const char *address) {
+    LocalCentralStats *stats = g_hash_table_lookup(characteristic->central_stats, address);
+    if (stats == NULL) {
+        stats = g_new0(LocalCentralStats, 1);
+        g_hash_table_insert(characteristic->central_stats, g_strdup(address), stats);
+    }
+    return stats;
+}
+
 static void add_char_path(gpointer key, gpointer value, gpointer userdata) {
     LocalCharacteristic *localCharacteristic = (LocalCharacteristic *) value;
     g_variant_builder_add((GVariantBuilder *) userdata, "o", localCharacteristic->path);
@@ -409,6 +534,82 @@ static GVariant *binc_local_descriptor_get_flags(const LocalDescriptor *localDes
     return result;
 }
 
+static GVariant *binc_local_descriptor_get_interfaces(const LocalDescriptor *localDescriptor) {
+    GVariantBuilder *descriptors_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sa{sv}}"));
+    GVariantBuilder *desc_properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+
+    GByteArray *byteArray = localDescriptor->value;
+    GVariant *byteArrayVariant = NULL;
+    if (byteArray != NULL) {
+        byteArrayVariant = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, byteArray->data,
+                                                     byteArray->len, sizeof(guint8));
+        g_variant_builder_add(desc_properties_builder, "{sv}", "Value", byteArrayVariant);
+    }
+    g_variant_builder_add(desc_properties_builder, "{sv}", "UUID",
+                          g_variant_new_string(localDescriptor->uuid));
+    g_variant_builder_add(desc_properties_builder, "{sv}", "Characteristic",
+                          g_variant_new("o", localDescriptor->char_path));
+    g_variant_builder_add(desc_properties_builder, "{sv}", "Flags",
+                          binc_local_descriptor_get_flags(localDescriptor));
+
+    g_variant_builder_add(descriptors_builder, "{sa{sv}}", GATT_DESC_INTERFACE,
+                          desc_properties_builder);
+    g_variant_builder_unref(desc_properties_builder);
+    GVariant *result = g_variant_builder_end(descriptors_builder);
+    g_variant_builder_unref(descriptors_builder);
+    return result;
+}
+
+static GVariant *binc_local_characteristic_get_interfaces(const LocalCharacteristic *localCharacteristic) {
+    GVariantBuilder *characteristic_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sa{sv}}"));
+    GVariantBuilder *char_properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+
+    // Build characteristic properties
+    GByteArray *byteArray = localCharacteristic->value;
+    GVariant *byteArrayVariant = NULL;
+    if (byteArray != NULL) {
+        byteArrayVariant = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, byteArray->data,
+                                                     byteArray->len, sizeof(guint8));
+        g_variant_builder_add(char_properties_builder, "{sv}", "Value", byteArrayVariant);
+    }
+    g_variant_builder_add(char_properties_builder, "{sv}", "UUID",
+                          g_variant_new_string(localCharacteristic->uuid));
+    g_variant_builder_add(char_properties_builder, "{sv}", "Service",
+                          g_variant_new("o", localCharacteristic->service_path));
+    g_variant_builder_add(char_properties_builder, "{sv}", "Flags",
+                          binc_local_characteristic_get_flags(localCharacteristic));
+    g_variant_builder_add(char_properties_builder, "{sv}", "Notifying",
+                          g_variant_new("b", localCharacteristic->notifying));
+    g_variant_builder_add(char_properties_builder, "{sv}", "Descriptors",
+                          binc_local_characteristic_get_descriptors(localCharacteristic));
+
+    g_variant_builder_add(characteristic_builder, "{sa{sv}}", GATT_CHAR_INTERFACE,
+                          char_properties_builder);
+    g_variant_builder_unref(char_properties_builder);
+    GVariant *result = g_variant_builder_end(characteristic_builder);
+    g_variant_builder_unref(characteristic_builder);
+    return result;
+}
+
+static GVariant *binc_local_service_get_interfaces(const LocalService *localService) {
+    GVariantBuilder *service_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sa{sv}}"));
+
+    // Build service properties
+    GVariantBuilder *service_properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(service_properties_builder, "{sv}", "UUID",
+                          g_variant_new_string(localService->uuid));
+    g_variant_builder_add(service_properties_builder, "{sv}", "Primary",
+                          g_variant_new_boolean(TRUE));
+    g_variant_builder_add(service_properties_builder, "{sv}", "Characteristics",
+                          binc_local_service_get_characteristics(localService));
+
+    g_variant_builder_add(service_builder, "{sa{sv}}", GATT_SERV_INTERFACE, service_properties_builder);
+    g_variant_builder_unref(service_properties_builder);
+    GVariant *result = g_variant_builder_end(service_builder);
+    g_variant_builder_unref(service_builder);
+    return result;
+}
+
 static void add_descriptors(GVariantBuilder *builder,
                             LocalCharacteristic *localCharacteristic) {
     // NOTE that the CCCD is automatically added by Bluez so no need to add it.
@@ -419,34 +620,12 @@ static void add_descriptors(GVariantBuilder *builder,
         LocalDescriptor *localDescriptor = (LocalDescriptor *) value;
         log_debug(TAG, "adding %s", localDescriptor->path);
 
-        GVariantBuilder *descriptors_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sa{sv}}"));
-        GVariantBuilder *desc_properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
-
-        GByteArray *byteArray = localDescriptor->value;
-        GVariant *byteArrayVariant = NULL;
-        if (byteArray != NULL) {
-            byteArrayVariant = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, byteArray->data,
-                                                         byteArray->len, sizeof(guint8));
-            g_variant_builder_add(desc_properties_builder, "{sv}", "Value", byteArrayVariant);
-        }
-        g_variant_builder_add(desc_properties_builder, "{sv}", "UUID",
-                              g_variant_new_string(localDescriptor->uuid));
-        g_variant_builder_add(desc_properties_builder, "{sv}", "Characteristic",
-                              g_variant_new("o", localDescriptor->char_path));
-        g_variant_builder_add(desc_properties_builder, "{sv}", "Flags",
-                              binc_local_descriptor_get_flags(localDescriptor));
-
-        // Add the descriptor to result
-        g_variant_builder_add(descriptors_builder, "{sa{sv}}", GATT_DESC_INTERFACE,
-                              desc_properties_builder);
-        g_variant_builder_unref(desc_properties_builder);
-        g_variant_builder_add(builder, "{oa{sa{sv}}}", localDescriptor->path, descriptors_builder);
-        g_variant_builder_unref(descriptors_builder);
+        g_variant_builder_add(builder, "{o@a{sa{sv}}}", localDescriptor->path,
+                              binc_local_descriptor_get_interfaces(localDescriptor));
     }
 }
 
 static void add_characteristics(GVariantBuilder *builder, LocalService *localService) {
-    // Build service characteristics
     GHashTableIter iter;
     gpointer key, value;
     g_hash_table_iter_init(&iter, localService->characteristics);
@@ -454,35 +633,8 @@ static void add_characteristics(GVariantBuilder *builder, LocalService *localSer
         LocalCharacteristic *localCharacteristic = (LocalCharacteristic *) value;
         log_debug(TAG, "adding %s", localCharacteristic->path);
 
-        GVariantBuilder *characteristic_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sa{sv}}"));
-        GVariantBuilder *char_properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
-
-        // Build characteristic properties
-        GByteArray *byteArray = localCharacteristic->value;
-        GVariant *byteArrayVariant = NULL;
-        if (byteArray != NULL) {
-            byteArrayVariant = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, byteArray->data,
-                                                         byteArray->len, sizeof(guint8));
-            g_variant_builder_add(char_properties_builder, "{sv}", "Value", byteArrayVariant);
-        }
-        g_variant_builder_add(char_properties_builder, "{sv}", "UUID",
-                              g_variant_new_string(localCharacteristic->uuid));
-        g_variant_builder_add(char_properties_builder, "{sv}", "Service",
-                              g_variant_new("o", localService->path));
-        g_variant_builder_add(char_properties_builder, "{sv}", "Flags",
-                              binc_local_characteristic_get_flags(localCharacteristic));
-        g_variant_builder_add(char_properties_builder, "{sv}", "Notifying",
-                              g_variant_new("b", localCharacteristic->notifying));
-        g_variant_builder_add(char_properties_builder, "{sv}", "Descriptors",
-                              binc_local_characteristic_get_descriptors(localCharacteristic));
-
-        // Add the characteristic to result
-        g_variant_builder_add(characteristic_builder, "{sa{sv}}", GATT_CHAR_INTERFACE,
-                              char_properties_builder);
-        g_variant_builder_unref(char_properties_builder);
-        g_variant_builder_add(builder, "{oa{sa{sv}}}", localCharacteristic->path, characteristic_builder);
-        g_variant_builder_unref(characteristic_builder);
-
+        g_variant_builder_add(builder, "{o@a{sa{sv}}}", localCharacteristic->path,
+                              binc_local_characteristic_get_interfaces(localCharacteristic));
         add_descriptors(builder, localCharacteristic);
     }
 }
@@ -494,22 +646,9 @@ static void add_services(Application *application, GVariantBuilder *builder) {
     while (g_hash_table_iter_next(&iter, (gpointer) &key, &value)) {
         LocalService *localService = (LocalService *) value;
         log_debug(TAG, "adding %s", localService->path);
-        GVariantBuilder *service_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sa{sv}}"));
-
-        // Build service properties
-        GVariantBuilder *service_properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
-        g_variant_builder_add(service_properties_builder, "{sv}", "UUID",
-                              g_variant_new_string((char *) key));
-        g_variant_builder_add(service_properties_builder, "{sv}", "Primary",
-                              g_variant_new_boolean(TRUE));
-        g_variant_builder_add(service_properties_builder, "{sv}", "Characteristics",
-                              binc_local_service_get_characteristics(localService));
-
-        // Add the service to result
-        g_variant_builder_add(service_builder, "{sa{sv}}", GATT_SERV_INTERFACE, service_properties_builder);
-        g_variant_builder_unref(service_properties_builder);
-        g_variant_builder_add(builder, "{oa{sa{sv}}}", localService->path, service_builder);
-        g_variant_builder_unref(service_builder);
+
+        g_variant_builder_add(builder, "{o@a{sa{sv}}}", localService->path,
+                              binc_local_service_get_interfaces(localService));
         add_characteristics(builder, localService);
     }
 }
@@ -554,13 +693,13 @@ void binc_application_publish(Application *application, const Adapter *adapter)
         return;
     }
 
-    application->registration_id = g_dbus_connection_register_object(application->connection,
-                                                                     application->path,
-                                                                     info->interfaces[0],
-                                                                     &application_method_table,
-                                                                     application,
-                                                                     NULL,
-                                                                     &error);
+    application->registration_id = binc_dbus_register_object(application->connection,
+                                                             application->path,
+                                                             info->interfaces[0],
+                                                             &application_method_table,
+                                                             application,
+                                                             NULL,
+                                                             &error);
     g_dbus_node_info_unref(info);
 
     if (application->registration_id == 0 && error != NULL) {
@@ -572,6 +711,17 @@ void binc_application_publish(Application *application, const Adapter *adapter)
     log_debug(TAG, "successfully published application");
 }
 
+static GDBusNodeInfo *parse_node_info(const gchar *xml) {
+    GError *error = NULL;
+    GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(xml, &error);
+    if (error) {
+        log_debug(TAG, "Unable to create node: %s\n", error->message);
+        g_clear_error(&error);
+        return NULL;
+    }
+    return info;
+}
+
 Application *binc_create_application(const Adapter *adapter) {
     g_assert(adapter != NULL);
     char* random_str = random_string(4);
@@ -583,6 +733,15 @@ Application *binc_create_application(const Adapter *adapter) {
                                                   g_str_equal,
                                                   g_free,
                                                   (GDestroyNotify) binc_local_service_free);
+    application->centrals = g_hash_table_new_full(g_str_hash,
+                                                  g_str_equal,
+                                                  g_free,
+                                                  (GDestroyNotify) binc_local_central_free);
+
+    // Parse the introspection data once instead of for every object we register
+    application->service_info = parse_node_info(service_xml);
+    application->characteristic_info = parse_node_info(characteristic_xml);
+    application->descriptor_info = parse_node_info(descriptor_xml);
 
     binc_application_publish(application, adapter);
 
@@ -600,8 +759,28 @@ void binc_application_free(Application *application) {
         application->services = NULL;
     }
 
+    if (application->centrals != NULL) {
+        g_hash_table_destroy(application->centrals);
+        application->centrals = NULL;
+    }
+
+    if (application->service_info != NULL) {
+        g_dbus_node_info_unref(application->service_info);
+        application->service_info = NULL;
+    }
+
+    if (application->characteristic_info != NULL) {
+        g_dbus_node_info_unref(application->characteristic_info);
+        application->characteristic_info = NULL;
+    }
+
+    if (application->descriptor_info != NULL) {
+        g_dbus_node_info_unref(application->descriptor_info);
+        application->descriptor_info = NULL;
+    }
+
     if (application->registration_id != 0) {
-        gboolean result = g_dbus_connection_unregister_object(application->connection, application->registration_id);
+        gboolean result = binc_dbus_unregister_object(application->connection, application->registration_id);
         if (!result) {
             log_debug(TAG, "error: could not unregister application %s", application->path);
         }
@@ -618,18 +797,10 @@ void binc_application_free(Application *application) {
 
 static const GDBusInterfaceVTable service_table = {};
 
-int binc_application_add_service(Application *application, const char *service_uuid) {
-    g_return_val_if_fail (application != NULL, EINVAL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
+static LocalService *register_local_service(Application *application, const char *service_uuid) {
+    if (application->service_info == NULL) return NULL;
 
     GError *error = NULL;
-    GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(service_xml, &error);
-    if (error) {
-        log_debug(TAG, "Unable to create service node: %s\n", error->message);
-        g_clear_error(&error);
-        return EINVAL;
-    }
-
     LocalService *localService = g_new0(LocalService, 1);
     localService->uuid = g_strdup(service_uuid);
     localService->application = application;
@@ -639,31 +810,36 @@ int binc_application_add_service(Application *application, const char *service_u
             g_free,
             (GDestroyNotify) binc_local_char_free);
     localService->path = g_strdup_printf(
-            "%s/service%d",
+            "%s/service%u",
             application->path,
-            g_hash_table_size(application->services));
+            application->next_service_id++);
     g_hash_table_insert(application->services, g_strdup(service_uuid), localService);
 
-    localService->registration_id = g_dbus_connection_register_object(application->connection,
-                                                                      localService->path,
-                                                                      info->interfaces[0],
-                                                                      &service_table,
-                                                                      localService,
-                                                                      NULL,
-                                                                      &error);
-    g_dbus_node_info_unref(info);
+    localService->registration_id = binc_dbus_register_object(application->connection,
+                                                              localService->path,
+                                                              application->service_info->interfaces[0],
+                                                              &service_table,
+                                                              localService,
+                                                              NULL,
+                                                              &error);
 
     if (localService->registration_id == 0) {
         log_debug(TAG, "failed to publish local service");
         log_debug(TAG, "Error %s", error->message);
         g_hash_table_remove(application->services, service_uuid);
-        binc_local_service_free(localService);
         g_clear_error(&error);
-        return EINVAL;
+        return NULL;
     }
 
     log_debug(TAG, "successfully published local service %s", service_uuid);
-    return 0;
+    return localService;
+}
+
+int binc_application_add_service(Application *application, const char *service_uuid) {
+    g_return_val_if_fail (application != NULL, EINVAL);
+    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
+
+    return register_local_service(application, service_uuid) != NULL ? 0 : EINVAL;
 }
 
 
@@ -674,6 +850,109 @@ static LocalService *binc_application_get_service(const Application *application
     return g_hash_table_lookup(application->services, service_uuid);
 }
 
+static gboolean emit_object_manager_signal(const Application *application, const char *signal, GVariant *parameters) {
+    GError *error = NULL;
+    gboolean result = binc_dbus_emit_signal(application->connection,
+                                            NULL,
+                                            application->path,
+                                            "org.freedesktop.DBus.ObjectManager",
+                                            signal,
+                                            parameters,
+                                            &error);
+    if (result != TRUE) {
+        if (error != NULL) {
+            log_debug(TAG, "error emitting %s: %s", signal, error->message);
+            g_clear_error(&error);
+        }
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean emit_interfaces_added(const Application *application, const char *path, GVariant *interfaces) {
+    return emit_object_manager_signal(application, "InterfacesAdded",
+                                      g_variant_new("(o@a{sa{sv}})", path, interfaces));
+}
+
+static gboolean emit_interfaces_removed(const Application *application, const char *path, const char *interface) {
+    GVariantBuilder *interfaces_builder = g_variant_builder_new(G_VARIANT_TYPE("as"));
+    g_variant_builder_add(interfaces_builder, "s", interface);
+    GVariant *parameters = g_variant_new("(oas)", path, interfaces_builder);
+    g_variant_builder_unref(interfaces_builder);
+    return emit_object_manager_signal(application, "InterfacesRemoved", parameters);
+}
+
+int binc_application_publish_service(const Application *application, const char *service_uuid) {
+    g_return_val_if_fail (application != NULL, EINVAL);
+    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
+
+    LocalService *localService = binc_application_get_service(application, service_uuid);
+    if (localService == NULL) {
+        g_critical("service %s does not exist", service_uuid);
+        return EINVAL;
+    }
+
+    // Announce the service before its characteristics and descriptors so they can be attached to it
+    gboolean result = emit_interfaces_added(application, localService->path,
+                                            binc_local_service_get_interfaces(localService));
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, localService->characteristics);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        LocalCharacteristic *localCharacteristic = (LocalCharacteristic *) value;
+        result &= emit_interfaces_added(application, localCharacteristic->path,
+                                        binc_local_characteristic_get_interfaces(localCharacteristic));
+
+        GHashTableIter desc_iter;
+        gpointer desc_key, desc_value;
+        g_hash_table_iter_init(&desc_iter, localCharacteristic->descriptors);
+        while (g_hash_table_iter_next(&desc_iter, &desc_key, &desc_value)) {
+            LocalDescriptor *localDescriptor = (LocalDescriptor *) desc_value;
+            result &= emit_interfaces_added(application, localDescriptor->path,
+                                            binc_local_descriptor_get_interfaces(localDescriptor));
+        }
+    }
+
+    if (!result) return EINVAL;
+
+    log_debug(TAG, "published service %s", service_uuid);
+    return 0;
+}
+
+int binc_application_remove_service(Application *application, const char *service_uuid) {
+    g_return_val_if_fail (application != NULL, EINVAL);
+    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
+
+    LocalService *localService = binc_application_get_service(application, service_uuid);
+    if (localService == NULL) {
+        g_critical("service %s does not exist", service_uuid);
+        return EINVAL;
+    }
+
+    // Remove the descriptors and characteristics before the service itself
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, localService->characteristics);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        LocalCharacteristic *localCharacteristic = (LocalCharacteristic *) value;
+
+        GHashTableIter desc_iter;
+        gpointer desc_key, desc_value;
+        g_hash_table_iter_init(&desc_iter, localCharacteristic->descriptors);
+        while (g_hash_table_iter_next(&desc_iter, &desc_key, &desc_value)) {
+            LocalDescriptor *localDescriptor = (LocalDescriptor *) desc_value;
+            emit_interfaces_removed(application, localDescriptor->path, GATT_DESC_INTERFACE);
+        }
+        emit_interfaces_removed(application, localCharacteristic->path, GATT_CHAR_INTERFACE);
+    }
+    emit_interfaces_removed(application, localService->path, GATT_SERV_INTERFACE);
+
+    g_hash_table_remove(application->services, service_uuid);
+    log_debug(TAG, "removed service %s", service_uuid);
+    return 0;
+}
+
 static GList *permissions2Flags(const guint permissions) {
     GList *list = NULL;
 
@@ -732,6 +1011,22 @@ static GList *permissions2Flags(const guint permissions) {
     return list;
 }
 
+static void store_characteristic_value(LocalCharacteristic *characteristic, const GByteArray *byteArray) {
+    // Copy the byte array contents to the characteristic's value, reusing its buffer if there is one
+    if (characteristic->value != NULL) {
+        g_byte_array_set_size(characteristic->value, 0);
+    } else {
+        characteristic->value = g_byte_array_sized_new(byteArray->len);
+    }
+    g_byte_array_append(characteristic->value, byteArray->data, byteArray->len);
+
+    const Application *application = characteristic->application;
+    if (application->on_char_updated != NULL) {
+        application->on_char_updated(application, characteristic->service_uuid,
+                                     characteristic->uuid, characteristic->value);
+    }
+}
+
 static int binc_characteristic_set_value(const Application *application, LocalCharacteristic *characteristic,
                                          GByteArray *byteArray) {
     g_return_val_if_fail (application != NULL, EINVAL);
@@ -742,20 +1037,7 @@ static int binc_characteristic_set_value(const Application *application, LocalCh
     log_debug(TAG, "set value <%s> to <%s>", byteArrayStr->str, characteristic->uuid);
     g_string_free(byteArrayStr, TRUE);
 
-    if (characteristic->value != NULL) {
-        g_byte_array_free(characteristic->value, TRUE);
-    }
-
-    // Copy the byte array contents to the characteristic's value
-    GByteArray *newByteArray = g_byte_array_sized_new(byteArray->len);
-    g_byte_array_append(newByteArray, byteArray->data, byteArray->len);
-    characteristic->value = newByteArray;
-
-    if (application->on_char_updated != NULL) {
-        application->on_char_updated(characteristic->application, characteristic->service_uuid,
-                                     characteristic->uuid, characteristic->value);
-    }
-
+    store_characteristic_value(characteristic, byteArray);
     return 0;
 }
 
@@ -834,6 +1116,7 @@ static void binc_internal_descriptor_method_call(GDBusConnection *conn,
         ReadOptions *options = parse_read_options(params);
 
         log_debug(TAG, "read descriptor <%s> by %s", localDescriptor->uuid, options->device);
+        track_central(application, options->device, options->adapter_path, options->mtu, options->link_type);
 
         const char *result = NULL;
         if (application->on_desc_read != NULL) {
@@ -871,6 +1154,7 @@ static void binc_internal_descriptor_method_call(GDBusConnection *conn,
         GByteArray *byteArray = g_variant_get_byte_array(valueVariant);
 
         log_debug(TAG, "write descriptor <%s> by %s", localDescriptor->uuid, options->device);
+        track_central(application, options->device, options->adapter_path, options->mtu, options->link_type);
 
         // Allow application to accept/reject the characteristic value before setting it
         const char *result = NULL;
@@ -910,57 +1194,57 @@ static const GDBusInterfaceVTable descriptor_table = {
         .method_call = binc_internal_descriptor_method_call,
 };
 
-int binc_application_add_descriptor(Application *application, const char *service_uuid,
-                                    const char *char_uuid, const char *desc_uuid, guint permissions) {
-    g_return_val_if_fail (application != NULL, EINVAL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
-
-    LocalCharacteristic *localCharacteristic = get_local_characteristic(application, service_uuid, char_uuid);
-    if (localCharacteristic == NULL) {
-        g_critical("characteristic %s does not exist", char_uuid);
-        return EINVAL;
-    }
+static LocalDescriptor *register_local_descriptor(Application *application,
+                                                  LocalCharacteristic *localCharacteristic,
+                                                  const char *desc_uuid, guint permissions) {
+    if (application->descriptor_info == NULL) return NULL;
 
     GError *error = NULL;
-    GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(descriptor_xml, &error);
-    if (error) {
-        log_debug(TAG, "Unable to create descriptor node: %s\n", error->message);
-        g_clear_error(&error);
-        return EINVAL;
-    }
-
     LocalDescriptor *localDescriptor = g_new0(LocalDescriptor, 1);
     localDescriptor->uuid = g_strdup(desc_uuid);
     localDescriptor->application = application;
     localDescriptor->char_path = g_strdup(localCharacteristic->path);
-    localDescriptor->char_uuid = g_strdup(char_uuid);
-    localDescriptor->service_uuid = g_strdup(service_uuid);
+    localDescriptor->char_uuid = g_strdup(localCharacteristic->uuid);
+    localDescriptor->service_uuid = g_strdup(localCharacteristic->service_uuid);
     localDescriptor->flags = permissions2Flags(permissions);
-    localDescriptor->path = g_strdup_printf("%s/desc%d",
+    localDescriptor->path = g_strdup_printf("%s/desc%u",
                                             localCharacteristic->path,
-                                            g_hash_table_size(localCharacteristic->descriptors));
+                                            localCharacteristic->next_desc_id++);
     g_hash_table_insert(localCharacteristic->descriptors, g_strdup(desc_uuid), localDescriptor);
 
     // Register characteristic
-    localDescriptor->registration_id = g_dbus_connection_register_object(application->connection,
-                                                                         localDescriptor->path,
-                                                                         info->interfaces[0],
-                                                                         &descriptor_table,
-                                                                         localDescriptor,
-                                                                         NULL,
-                                                                         &error);
-    g_dbus_node_info_unref(info);
+    localDescriptor->registration_id = binc_dbus_register_object(application->connection,
+                                                                 localDescriptor->path,
+                                                                 application->descriptor_info->interfaces[0],
+                                                                 &descriptor_table,
+                                                                 localDescriptor,
+                                                                 NULL,
+                                                                 &error);
 
     if (localDescriptor->registration_id == 0) {
         log_debug(TAG, "failed to publish local characteristic");
         log_debug(TAG, "Error %s", error->message);
         g_clear_error(&error);
         g_hash_table_remove(localCharacteristic->descriptors, desc_uuid);
-        return EINVAL;
+        return NULL;
     }
 
     log_debug(TAG, "successfully published local descriptor %s", desc_uuid);
-    return 0;
+    return localDescriptor;
+}
+
+int binc_application_add_descriptor(Application *application, const char *service_uuid,
+                                    const char *char_uuid, const char *desc_uuid, guint permissions) {
+    g_return_val_if_fail (application != NULL, EINVAL);
+    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
+
+    LocalCharacteristic *localCharacteristic = get_local_characteristic(application, service_uuid, char_uuid);
+    if (localCharacteristic == NULL) {
+        g_critical("characteristic %s does not exist", char_uuid);
+        return EINVAL;
+    }
+
+    return register_local_descriptor(application, localCharacteristic, desc_uuid, permissions) != NULL ? 0 : EINVAL;
 }
 
 int binc_application_set_char_value(const Application *application, const char *service_uuid,
@@ -1018,6 +1302,124 @@ GByteArray *binc_application_get_char_value(const Application *application, cons
 }
 
 
+/**
+ * Answer a read request from the characteristic's value provider. The value is serialized straight from
+ * the application's memory, which is released once the reply no longer needs it.
+ */
+static void binc_internal_provide_value(LocalCharacteristic *characteristic, const ReadOptions *options,
+                                        GDBusMethodInvocation *invocation) {
+    const guint8 *data = NULL;
+    gsize length = 0;
+    GDestroyNotify release = NULL;
+    gpointer release_data = NULL;
+
+    const char *result = characteristic->value_provider(characteristic->application, options->device,
+                                                        characteristic->service_uuid, characteristic->uuid,
+                                                        options->mtu, options->offset,
+                                                        &data, &length, &release, &release_data);
+    if (result == NULL && options->offset > length) {
+        result = BLUEZ_ERROR_INVALID_OFFSET;
+    }
+
+    if (result != NULL) {
+        if (release != NULL) {
+            release(release_data);
+        }
+        g_dbus_method_invocation_return_dbus_error(invocation, result, "read characteristic error");
+        log_debug(TAG, "read characteristic error '%s'", result);
+        return;
+    }
+
+    GVariant *resultVariant = g_variant_new_from_data(G_VARIANT_TYPE_BYTESTRING,
+                                                      length > 0 ? data + options->offset : NULL,
+                                                      length - options->offset,
+                                                      TRUE,
+                                                      release,
+                                                      release_data);
+    g_dbus_method_invocation_return_value(invocation, g_variant_new_tuple(&resultVariant, 1));
+}
+
+static int emit_value_changed(const LocalCharacteristic *characteristic, const guint8 *data, gsize length);
+
+static void update_stream_mtu(LocalStream *stream, guint16 mtu) {
+    // Bluez only passes the mtu if it knows it, so keep the last known value
+    if (mtu > 0) {
+        stream->mtu = mtu;
+    }
+}
+
+static gboolean binc_internal_stream_pace(gpointer user_data) {
+    LocalStream *stream = (LocalStream *) user_data;
+    g_assert(stream != NULL);
+
+    // Notifications are queued by bluetoothd without flow control, so only send a burst per interval
+    gsize chunk_size = (gsize) stream->mtu - 3;
+    for (guint i = 0; i < stream->burst && stream->tx->notifying; i++) {
+        gsize length = MIN(binc_ring_buffer_get_length(stream->tx_buffer), chunk_size);
+        if (length == 0) break;
+
+        const guint8 *chunk = binc_ring_buffer_peek(stream->tx_buffer, length);
+        if (emit_value_changed(stream->tx, chunk, length) != 0) {
+            log_error(TAG, "could not notify stream data on <%s>", stream->tx->uuid);
+            break;
+        }
+        binc_ring_buffer_consume(stream->tx_buffer, length);
+    }
+
+    if (stream->tx->notifying && binc_ring_buffer_get_length(stream->tx_buffer) > 0) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    stream->pacing_id = 0;
+    if (binc_ring_buffer_get_length(stream->tx_buffer) == 0 && stream->on_drained != NULL) {
+        stream->on_drained(stream);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_stream_output(LocalStream *stream) {
+    if (stream->pacing_id != 0 || stream->tx == NULL || !stream->tx->notifying) return;
+    if (binc_ring_buffer_get_length(stream->tx_buffer) == 0) return;
+
+    stream->pacing_id = g_timeout_add(stream->interval, binc_internal_stream_pace, stream);
+}
+
+static void binc_internal_stream_provide(LocalStream *stream, const ReadOptions *options,
+                                         GDBusMethodInvocation *invocation) {
+    update_stream_mtu(stream, options->mtu);
+
+    // Every read returns the next chunk, sized so it fits in a single read response
+    gsize length = MIN(binc_ring_buffer_get_length(stream->tx_buffer), (gsize) stream->mtu - 1);
+    const guint8 *chunk = length > 0 ? binc_ring_buffer_peek(stream->tx_buffer, length) : NULL;
+    GVariant *resultVariant = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, chunk, length, sizeof(guint8));
+    binc_ring_buffer_consume(stream->tx_buffer, length);
+    g_dbus_method_invocation_return_value(invocation, g_variant_new_tuple(&resultVariant, 1));
+
+    if (length > 0 && binc_ring_buffer_get_length(stream->tx_buffer) == 0 && stream->pacing_id == 0 &&
+        stream->on_drained != NULL) {
+        stream->on_drained(stream);
+    }
+}
+
+static void binc_internal_stream_receive(LocalStream *stream, const GByteArray *byteArray,
+                                         const WriteOptions *options, GDBusMethodInvocation *invocation) {
+    update_stream_mtu(stream, options->mtu);
+
+    // Reject writes that don't fit completely, so the central can retry them later
+    if (byteArray->len > binc_ring_buffer_get_free(stream->rx_buffer)) {
+        g_dbus_method_invocation_return_dbus_error(invocation, BLUEZ_ERROR_FAILED, "stream buffer full");
+        log_debug(TAG, "stream buffer of <%s> full", stream->rx->uuid);
+        return;
+    }
+
+    binc_ring_buffer_write(stream->rx_buffer, byteArray->data, byteArray->len);
+    g_dbus_method_invocation_return_value(invocation, g_variant_new("()"));
+
+    if (stream->on_readable != NULL) {
+        stream->on_readable(stream);
+    }
+}
+
 static void binc_internal_characteristic_method_call(GDBusConnection *conn,
                                                      const gchar *sender,
                                                      const gchar *path,
@@ -1036,6 +1438,21 @@ static void binc_internal_characteristic_method_call(GDBusConnection *conn,
     if (g_str_equal(method, CHARACTERISTIC_METHOD_READ_VALUE)) {
         log_debug(TAG, "read <%s>", characteristic->uuid);
         ReadOptions *options = parse_read_options(params);
+        if (track_central(application, options->device, options->adapter_path, options->mtu, options->link_type) != NULL) {
+            get_central_stats(characteristic, options->device)->read_count++;
+        }
+
+        if (characteristic->stream != NULL && characteristic->stream->tx == characteristic) {
+            binc_internal_stream_provide(characteristic->stream, options, invocation);
+            read_options_free(options);
+            return;
+        }
+
+        if (characteristic->value_provider != NULL) {
+            binc_internal_provide_value(characteristic, options, invocation);
+            read_options_free(options);
+            return;
+        }
 
         // Allow application to accept/reject the characteristic value before setting it
         const char *result = NULL;
@@ -1075,6 +1492,17 @@ static void binc_internal_characteristic_method_call(GDBusConnection *conn,
         GByteArray *byteArray = g_variant_get_byte_array(valueVariant);
 
         log_debug(TAG, "write <%s>", characteristic->uuid);
+        if (track_central(application, options->device, options->adapter_path, options->mtu, options->link_type) != NULL) {
+            get_central_stats(characteristic, options->device)->write_count++;
+        }
+
+        if (characteristic->stream != NULL && characteristic->stream->rx == characteristic) {
+            binc_internal_stream_receive(characteristic->stream, byteArray, options, invocation);
+            write_options_free(options);
+            g_byte_array_free(byteArray, FALSE);
+            g_variant_unref(valueVariant);
+            return;
+        }
 
         // Allow application to accept/reject the characteristic value before setting it
         const char *result = NULL;
@@ -1107,6 +1535,11 @@ static void binc_internal_characteristic_method_call(GDBusConnection *conn,
         characteristic->notifying = TRUE;
         g_dbus_method_invocation_return_value(invocation, g_variant_new("()"));
 
+        // Send what was written before the central subscribed
+        if (characteristic->stream != NULL && characteristic->stream->tx == characteristic) {
+            schedule_stream_output(characteristic->stream);
+        }
+
         if (application->on_char_start_notify != NULL) {
             application->on_char_start_notify(characteristic->application, characteristic->service_uuid,
                                               characteristic->uuid);
@@ -1160,65 +1593,155 @@ static const GDBusInterfaceVTable characteristic_table = {
         .get_property = characteristic_get_property
 };
 
-int binc_application_add_characteristic(Application *application, const char *service_uuid,
-                                        const char *char_uuid, guint permissions) {
-
-    g_return_val_if_fail (application != NULL, EINVAL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
-    g_return_val_if_fail (is_valid_uuid(char_uuid), EINVAL);
-
-    LocalService *localService = binc_application_get_service(application, service_uuid);
-    if (localService == NULL) {
-        g_critical("service %s does not exist", service_uuid);
-        return EINVAL;
-    }
+static LocalCharacteristic *register_local_characteristic(Application *application, LocalService *localService,
+                                                          const char *char_uuid, guint permissions) {
+    if (application->characteristic_info == NULL) return NULL;
 
     GError *error = NULL;
-    GDBusNodeInfo *info = NULL;
-    info = g_dbus_node_info_new_for_xml(characteristic_xml, &error);
-    if (error) {
-        log_debug(TAG, "Unable to create node: %s\n", error->message);
-        g_clear_error(&error);
-        return EINVAL;
-    }
-
     LocalCharacteristic *characteristic = g_new0(LocalCharacteristic, 1);
-    characteristic->service_uuid = g_strdup(service_uuid);
+    characteristic->service_uuid = g_strdup(localService->uuid);
     characteristic->service_path = g_strdup(localService->path);
     characteristic->uuid = g_strdup(char_uuid);
     characteristic->permissions = permissions;
     characteristic->flags = permissions2Flags(permissions);
     characteristic->value = NULL;
     characteristic->application = application;
-    characteristic->path = g_strdup_printf("%s/char%d",
+    characteristic->path = g_strdup_printf("%s/char%u",
                                            localService->path,
-                                           g_hash_table_size(localService->characteristics));
+                                           localService->next_char_id++);
     characteristic->descriptors = g_hash_table_new_full(
             g_str_hash,
             g_str_equal,
             g_free,
             (GDestroyNotify) binc_local_desc_free);
+    characteristic->central_stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
     g_hash_table_insert(localService->characteristics, g_strdup(char_uuid), characteristic);
 
     // Register characteristic
-    characteristic->registration_id = g_dbus_connection_register_object(application->connection,
-                                                                        characteristic->path,
-                                                                        info->interfaces[0],
-                                                                        &characteristic_table,
-                                                                        characteristic,
-                                                                        NULL,
-                                                                        &error);
-    g_dbus_node_info_unref(info);
+    characteristic->registration_id = binc_dbus_register_object(application->connection,
+                                                                characteristic->path,
+                                                                application->characteristic_info->interfaces[0],
+                                                                &characteristic_table,
+                                                                characteristic,
+                                                                NULL,
+                                                                &error);
 
     if (characteristic->registration_id == 0) {
         log_debug(TAG, "failed to publish local characteristic");
         log_debug(TAG, "Error %s", error->message);
         g_clear_error(&error);
         g_hash_table_remove(localService->characteristics, char_uuid);
-        return EINVAL;
+        return NULL;
     }
 
     log_debug(TAG, "successfully published local characteristic %s", char_uuid);
+    return characteristic;
+}
+
+int binc_application_add_characteristic(Application *application, const char *service_uuid,
+                                        const char *char_uuid, guint permissions) {
+
+    g_return_val_if_fail (application != NULL, EINVAL);
+    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
+    g_return_val_if_fail (is_valid_uuid(char_uuid), EINVAL);
+
+    LocalService *localService = binc_application_get_service(application, service_uuid);
+    if (localService == NULL) {
+        g_critical("service %s does not exist", service_uuid);
+        return EINVAL;
+    }
+
+    return register_local_characteristic(application, localService, char_uuid, permissions) != NULL ? 0 : EINVAL;
+}
+
+static gboolean is_valid_database(const Application *application, const LocalServiceDef *services) {
+    GHashTable *service_uuids = g_hash_table_new(g_str_hash, g_str_equal);
+    gboolean valid = TRUE;
+
+    for (const LocalServiceDef *serviceDef = services; valid && serviceDef->uuid != NULL; serviceDef++) {
+        if (!is_valid_uuid(serviceDef->uuid)) {
+            g_critical("invalid service uuid %s", serviceDef->uuid);
+            valid = FALSE;
+            break;
+        }
+
+        if (g_hash_table_contains(service_uuids, serviceDef->uuid) ||
+            binc_application_get_service(application, serviceDef->uuid) != NULL) {
+            g_critical("service %s already exists", serviceDef->uuid);
+            valid = FALSE;
+            break;
+        }
+        g_hash_table_add(service_uuids, (gpointer) serviceDef->uuid);
+
+        if (serviceDef->characteristics == NULL) continue;
+
+        GHashTable *char_uuids = g_hash_table_new(g_str_hash, g_str_equal);
+        for (const LocalCharacteristicDef *charDef = serviceDef->characteristics; charDef->uuid != NULL; charDef++) {
+            if (!is_valid_uuid(charDef->uuid) || g_hash_table_contains(char_uuids, charDef->uuid)) {
+                g_critical("invalid or duplicate characteristic uuid %s", charDef->uuid);
+                valid = FALSE;
+                break;
+            }
+            g_hash_table_add(char_uuids, (gpointer) charDef->uuid);
+
+            if (charDef->descriptors == NULL) continue;
+
+            GHashTable *desc_uuids = g_hash_table_new(g_str_hash, g_str_equal);
+            for (const LocalDescriptorDef *descDef = charDef->descriptors; descDef->uuid != NULL; descDef++) {
+                if (!is_valid_uuid(descDef->uuid) || g_hash_table_contains(desc_uuids, descDef->uuid)) {
+                    g_critical("invalid or duplicate descriptor uuid %s", descDef->uuid);
+                    valid = FALSE;
+                    break;
+                }
+                g_hash_table_add(desc_uuids, (gpointer) descDef->uuid);
+            }
+            g_hash_table_destroy(desc_uuids);
+            if (!valid) break;
+        }
+        g_hash_table_destroy(char_uuids);
+    }
+
+    g_hash_table_destroy(service_uuids);
+    return valid;
+}
+
+int binc_application_load_database(Application *application, const LocalServiceDef *services) {
+    g_return_val_if_fail (application != NULL, EINVAL);
+    g_return_val_if_fail (services != NULL, EINVAL);
+
+    // Validate the whole table first so we never end up with half a database
+    if (!is_valid_database(application, services)) return EINVAL;
+
+    guint count = 0;
+    for (const LocalServiceDef *serviceDef = services; serviceDef->uuid != NULL; serviceDef++) {
+        LocalService *localService = register_local_service(application, serviceDef->uuid);
+        gboolean registered = localService != NULL;
+
+        const LocalCharacteristicDef *charDef = serviceDef->characteristics;
+        for (; registered && charDef != NULL && charDef->uuid != NULL; charDef++) {
+            LocalCharacteristic *characteristic = register_local_characteristic(application, localService,
+                                                                                charDef->uuid,
+                                                                                charDef->permissions);
+            registered = characteristic != NULL;
+
+            const LocalDescriptorDef *descDef = charDef->descriptors;
+            for (; registered && descDef != NULL && descDef->uuid != NULL; descDef++) {
+                registered = register_local_descriptor(application, characteristic, descDef->uuid,
+                                                       descDef->permissions) != NULL;
+            }
+        }
+
+        if (!registered) {
+            // Roll back the services we loaded so far
+            for (const LocalServiceDef *loaded = services; loaded <= serviceDef; loaded++) {
+                g_hash_table_remove(application->services, loaded->uuid);
+            }
+            return EINVAL;
+        }
+        count++;
+    }
+
+    log_debug(TAG, "loaded database with %u services", count);
     return 0;
 }
 
@@ -1276,38 +1799,25 @@ void binc_application_set_char_stop_notify_cb(Application *application, onLocalC
     application->on_char_stop_notify = callback;
 }
 
-int binc_application_notify(const Application *application, const char *service_uuid, const char *char_uuid,
-                            const GByteArray *byteArray) {
-
-    g_return_val_if_fail (application != NULL, EINVAL);
-    g_return_val_if_fail (byteArray != NULL, EINVAL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
-    g_return_val_if_fail (is_valid_uuid(char_uuid), EINVAL);
-
-    LocalCharacteristic *characteristic = get_local_characteristic(application, service_uuid, char_uuid);
-    if (characteristic == NULL) {
-        g_critical("%s: characteristic %s does not exist", G_STRFUNC, service_uuid);
-        return EINVAL;
-    }
-
+static int emit_value_changed(const LocalCharacteristic *characteristic, const guint8 *data, gsize length) {
     GVariant *valueVariant = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
-                                                       byteArray->data,
-                                                       byteArray->len,
+                                                       data,
+                                                       length,
                                                        sizeof(guint8));
     GVariantBuilder *properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
     g_variant_builder_add(properties_builder, "{sv}", "Value", valueVariant);
     GVariantBuilder *invalidated_builder = g_variant_builder_new(G_VARIANT_TYPE("as"));
 
     GError *error = NULL;
-    gboolean result = g_dbus_connection_emit_signal(application->connection,
-                                                    NULL,
-                                                    characteristic->path,
-                                                    "org.freedesktop.DBus.Properties",
-                                                    "PropertiesChanged",
-                                                    g_variant_new("(sa{sv}as)",
+    gboolean result = binc_dbus_emit_signal(characteristic->application->connection,
+                                            NULL,
+                                            characteristic->path,
+                                            "org.freedesktop.DBus.Properties",
+                                            "PropertiesChanged",
+                                            g_variant_new("(sa{sv}as)",
                                                                   "org.bluez.GattCharacteristic1",
                                                                   properties_builder, invalidated_builder),
-                                                    &error);
+                                            &error);
 
     g_variant_builder_unref(invalidated_builder);
     g_variant_builder_unref(properties_builder);
@@ -1319,6 +1829,25 @@ int binc_application_notify(const Application *application, const char *service_
         }
         return EINVAL;
     }
+    return 0;
+}
+
+int binc_application_notify(const Application *application, const char *service_uuid, const char *char_uuid,
+                            const GByteArray *byteArray) {
+
+    g_return_val_if_fail (application != NULL, EINVAL);
+    g_return_val_if_fail (byteArray != NULL, EINVAL);
+    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
+    g_return_val_if_fail (is_valid_uuid(char_uuid), EINVAL);
+
+    LocalCharacteristic *characteristic = get_local_characteristic(application, service_uuid, char_uuid);
+    if (characteristic == NULL) {
+        g_critical("%s: characteristic %s does not exist", G_STRFUNC, service_uuid);
+        return EINVAL;
+    }
+
+    int result = emit_value_changed(characteristic, byteArray->data, byteArray->len);
+    if (result != 0) return result;
 
     GString *byteArrayStr = g_byte_array_as_hex(byteArray);
     log_debug(TAG, "notified <%s> on <%s>", byteArrayStr->str, characteristic->uuid);
@@ -1341,6 +1870,188 @@ gboolean binc_application_char_is_notifying(const Application *application, cons
     return characteristic->notifying;
 }
 
+LocalCharacteristic *binc_application_get_characteristic(const Application *application, const char *service_uuid,
+                                                         const char *char_uuid) {
+    g_return_val_if_fail (application != NULL, NULL);
+    g_return_val_if_fail (is_valid_uuid(service_uuid), NULL);
+    g_return_val_if_fail (is_valid_uuid(char_uuid), NULL);
+
+    return get_local_characteristic(application, service_uuid, char_uuid);
+}
+
+int binc_local_char_notify(const LocalCharacteristic *characteristic, const GByteArray *byteArray) {
+    g_return_val_if_fail (characteristic != NULL, EINVAL);
+    g_return_val_if_fail (byteArray != NULL, EINVAL);
+
+    return emit_value_changed(characteristic, byteArray->data, byteArray->len);
+}
+
+int binc_local_char_set_value(LocalCharacteristic *characteristic, const GByteArray *byteArray) {
+    g_return_val_if_fail (characteristic != NULL, EINVAL);
+    g_return_val_if_fail (byteArray != NULL, EINVAL);
+
+    store_characteristic_value(characteristic, byteArray);
+    return 0;
+}
+
+GByteArray *binc_local_char_get_value(const LocalCharacteristic *characteristic) {
+    g_return_val_if_fail (characteristic != NULL, NULL);
+    return characteristic->value;
+}
+
+gboolean binc_local_char_is_notifying(const LocalCharacteristic *characteristic) {
+    g_return_val_if_fail (characteristic != NULL, FALSE);
+    return characteristic->notifying;
+}
+
+int binc_application_set_char_value_provider(const Application *application, const char *service_uuid,
+                                             const char *char_uuid, onLocalCharacteristicProvideValue provider) {
+    g_return_val_if_fail (application != NULL, EINVAL);
+    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
+    g_return_val_if_fail (is_valid_uuid(char_uuid), EINVAL);
+
+    LocalCharacteristic *characteristic = get_local_characteristic(application, service_uuid, char_uuid);
+    if (characteristic == NULL) {
+        g_critical("%s: characteristic with uuid %s does not exist", G_STRFUNC, char_uuid);
+        return EINVAL;
+    }
+
+    characteristic->value_provider = provider;
+    return 0;
+}
+
+GList *binc_application_get_centrals(const Application *application) {
+    g_return_val_if_fail (application != NULL, NULL);
+
+    return g_hash_table_get_keys(application->centrals);
+}
+
+guint16 binc_application_get_central_mtu(const Application *application, const char *address) {
+    g_return_val_if_fail (application != NULL, 0);
+    g_return_val_if_fail (address != NULL, 0);
+
+    LocalCentral *localCentral = g_hash_table_lookup(application->centrals, address);
+    return localCentral != NULL ? localCentral->mtu : 0;
+}
+
+const char *binc_application_get_central_link_type(const Application *application, const char *address) {
+    g_return_val_if_fail (application != NULL, NULL);
+    g_return_val_if_fail (address != NULL, NULL);
+
+    LocalCentral *localCentral = g_hash_table_lookup(application->centrals, address);
+    return localCentral != NULL ? localCentral->link_type : NULL;
+}
+
+guint binc_application_get_central_request_count(const Application *application, const char *address) {
+    g_return_val_if_fail (application != NULL, 0);
+    g_return_val_if_fail (address != NULL, 0);
+
+    LocalCentral *localCentral = g_hash_table_lookup(application->centrals, address);
+    return localCentral != NULL ? localCentral->request_count : 0;
+}
+
+guint binc_application_get_char_read_count(const Application *application, const char *service_uuid,
+                                           const char *char_uuid, const char *address) {
+    g_return_val_if_fail (application != NULL, 0);
+    g_return_val_if_fail (address != NULL, 0);
+
+    LocalCharacteristic *characteristic = get_local_characteristic(application, service_uuid, char_uuid);
+    if (characteristic == NULL) return 0;
+
+    LocalCentralStats *stats = g_hash_table_lookup(characteristic->central_stats, address);
+    return stats != NULL ? stats->read_count : 0;
+}
+
+guint binc_application_get_char_write_count(const Application *application, const char *service_uuid,
+                                            const char *char_uuid, const char *address) {
+    g_return_val_if_fail (application != NULL, 0);
+    g_return_val_if_fail (address != NULL, 0);
+
+    LocalCharacteristic *characteristic = get_local_characteristic(application, service_uuid, char_uuid);
+    if (characteristic == NULL) return 0;
+
+    LocalCentralStats *stats = g_hash_table_lookup(characteristic->central_stats, address);
+    return stats != NULL ? stats->write_count : 0;
+}
+
+guint16 binc_application_get_notify_mtu(const Application *application) {
+    g_return_val_if_fail (application != NULL, 0);
+
+    // Notifications go to all subscribed centrals, so they must fit the smallest known mtu
+    guint16 result = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, application->centrals);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        LocalCentral *localCentral = (LocalCentral *) value;
+        if (localCentral->mtu > 0 && (result == 0 || localCentral->mtu < result)) {
+            result = localCentral->mtu;
+        }
+    }
+    return result;
+}
+
+static void remove_central_stats(gpointer key, gpointer value, gpointer userdata) {
+    LocalService *localService = (LocalService *) value;
+
+    GHashTableIter iter;
+    gpointer char_key, char_value;
+    g_hash_table_iter_init(&iter, localService->characteristics);
+    while (g_hash_table_iter_next(&iter, &char_key, &char_value)) {
+        LocalCharacteristic *characteristic = (LocalCharacteristic *) char_value;
+        g_hash_table_remove(characteristic->central_stats, userdata);
+    }
+}
+
+guint binc_application_get_adapter_central_count(const Application *application, const Adapter *adapter) {
+    g_return_val_if_fail (application != NULL, 0);
+    g_return_val_if_fail (adapter != NULL, 0);
+
+    const char *adapter_path = binc_adapter_get_path(adapter);
+    guint count = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, application->centrals);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        LocalCentral *localCentral = (LocalCentral *) value;
+        if (g_strcmp0(localCentral->adapter_path, adapter_path) == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+guint binc_application_get_adapter_request_count(const Application *application, const Adapter *adapter) {
+    g_return_val_if_fail (application != NULL, 0);
+    g_return_val_if_fail (adapter != NULL, 0);
+
+    const char *adapter_path = binc_adapter_get_path(adapter);
+    guint count = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, application->centrals);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        LocalCentral *localCentral = (LocalCentral *) value;
+        if (g_strcmp0(localCentral->adapter_path, adapter_path) == 0) {
+            count += localCentral->request_count;
+        }
+    }
+    return count;
+}
+
+int binc_application_remove_central(Application *application, const char *address) {
+    g_return_val_if_fail (application != NULL, EINVAL);
+    g_return_val_if_fail (address != NULL, EINVAL);
+
+    g_hash_table_foreach(application->services, remove_central_stats, (gpointer) address);
+    if (!g_hash_table_remove(application->centrals, address)) {
+        return EINVAL;
+    }
+
+    log_debug(TAG, "removed central %s", address);
+    return 0;
+}
+
 void binc_application_set_user_data(Application *application, void *user_data){
     g_assert(application != NULL);
     application->user_data = user_data;
@@ -1350,3 +2061,137 @@ void *binc_application_get_user_data(const Application *application){
     g_assert(application != NULL);
     return application->user_data;
 }
+
+LocalStream *binc_application_create_stream(Application *application, const char *service_uuid,
+                                            const char *rx_char_uuid, const char *tx_char_uuid, gsize buffer_size) {
+    g_return_val_if_fail (application != NULL, NULL);
+    g_return_val_if_fail (is_valid_uuid(service_uuid), NULL);
+    g_return_val_if_fail (rx_char_uuid != NULL || tx_char_uuid != NULL, NULL);
+
+    LocalCharacteristic *rx = NULL;
+    if (rx_char_uuid != NULL) {
+        rx = get_local_characteristic(application, service_uuid, rx_char_uuid);
+        if (rx == NULL || rx->stream != NULL) {
+            g_critical("%s: characteristic %s does not exist or already has a stream", G_STRFUNC, rx_char_uuid);
+            return NULL;
+        }
+    }
+
+    LocalCharacteristic *tx = NULL;
+    if (tx_char_uuid != NULL) {
+        tx = get_local_characteristic(application, service_uuid, tx_char_uuid);
+        if (tx == NULL || (tx->stream != NULL && tx != rx)) {
+            g_critical("%s: characteristic %s does not exist or already has a stream", G_STRFUNC, tx_char_uuid);
+            return NULL;
+        }
+    }
+
+    LocalStream *stream = g_new0(LocalStream, 1);
+    stream->application = application;
+    stream->rx = rx;
+    stream->tx = tx;
+    stream->rx_buffer = binc_ring_buffer_create(buffer_size > 0 ? buffer_size : DEFAULT_STREAM_BUFFER_SIZE);
+    stream->tx_buffer = binc_ring_buffer_create(buffer_size > 0 ? buffer_size : DEFAULT_STREAM_BUFFER_SIZE);
+    stream->mtu = DEFAULT_STREAM_MTU;
+    stream->burst = DEFAULT_STREAM_BURST;
+    stream->interval = DEFAULT_STREAM_INTERVAL_MS;
+
+    if (rx != NULL) {
+        rx->stream = stream;
+    }
+    if (tx != NULL) {
+        tx->stream = stream;
+    }
+    return stream;
+}
+
+void binc_local_stream_free(LocalStream *stream) {
+    g_assert(stream != NULL);
+
+    if (stream->pacing_id != 0) {
+        g_source_remove(stream->pacing_id);
+        stream->pacing_id = 0;
+    }
+
+    if (stream->rx != NULL) {
+        stream->rx->stream = NULL;
+        stream->rx = NULL;
+    }
+
+    if (stream->tx != NULL) {
+        stream->tx->stream = NULL;
+        stream->tx = NULL;
+    }
+
+    binc_ring_buffer_free(stream->rx_buffer);
+    stream->rx_buffer = NULL;
+    binc_ring_buffer_free(stream->tx_buffer);
+    stream->tx_buffer = NULL;
+    g_free(stream);
+}
+
+gsize binc_local_stream_write(LocalStream *stream, const guint8 *data, gsize length) {
+    g_assert(stream != NULL);
+    g_assert(stream->tx != NULL);
+    g_assert(data != NULL || length == 0);
+
+    gsize accepted = binc_ring_buffer_write(stream->tx_buffer, data, length);
+    schedule_stream_output(stream);
+    return accepted;
+}
+
+gsize binc_local_stream_read(LocalStream *stream, guint8 *data, gsize length) {
+    g_assert(stream != NULL);
+    g_assert(stream->rx != NULL);
+    g_assert(data != NULL || length == 0);
+
+    return binc_ring_buffer_read(stream->rx_buffer, data, length);
+}
+
+gsize binc_local_stream_get_readable(const LocalStream *stream) {
+    g_assert(stream != NULL);
+    return binc_ring_buffer_get_length(stream->rx_buffer);
+}
+
+gsize binc_local_stream_get_pending(const LocalStream *stream) {
+    g_assert(stream != NULL);
+    return binc_ring_buffer_get_length(stream->tx_buffer);
+}
+
+guint16 binc_local_stream_get_mtu(const LocalStream *stream) {
+    g_assert(stream != NULL);
+    return stream->mtu;
+}
+
+void binc_local_stream_set_pacing(LocalStream *stream, guint burst, guint interval_ms) {
+    g_assert(stream != NULL);
+    g_assert(burst > 0);
+
+    stream->burst = burst;
+    stream->interval = interval_ms;
+}
+
+void binc_local_stream_set_readable_cb(LocalStream *stream, onLocalStreamReadable callback) {
+    g_assert(stream != NULL);
+    stream->on_readable = callback;
+}
+
+void binc_local_stream_set_drained_cb(LocalStream *stream, onLocalStreamDrained callback) {
+    g_assert(stream != NULL);
+    stream->on_drained = callback;
+}
+
+Application *binc_local_stream_get_application(const LocalStream *stream) {
+    g_assert(stream != NULL);
+    return stream->application;
+}
+
+void binc_local_stream_set_user_data(LocalStream *stream, void *user_data) {
+    g_assert(stream != NULL);
+    stream->user_data = user_data;
+}
+
+void *binc_local_stream_get_user_data(const LocalStream *stream) {
+    g_assert(stream != NULL);
+    return stream->user_data;
+}
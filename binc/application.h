@@ -39,6 +39,24 @@ extern "C" {
 #define BLUEZ_ERROR_INVALID_VALUE_LENGTH "org.bluez.Error.InvalidValueLength"
 #define BLUEZ_ERROR_NOT_AUTHORIZED "org.bluez.Error.NotAuthorized"
 #define BLUEZ_ERROR_NOT_SUPPORTED "org.bluez.Error.NotSupported"
+#define BLUEZ_ERROR_INVALID_OFFSET "org.bluez.Error.InvalidOffset"
+
+// Static GATT database tables, see binc_application_load_database()
+typedef struct binc_local_descriptor_def {
+    const char *uuid;
+    guint permissions;
+} LocalDescriptorDef;
+
+typedef struct binc_local_characteristic_def {
+    const char *uuid;
+    guint permissions;
+    const LocalDescriptorDef *descriptors;
+} LocalCharacteristicDef;
+
+typedef struct binc_local_service_def {
+    const char *uuid;
+    const LocalCharacteristicDef *characteristics;
+} LocalServiceDef;
 
 // This callback is called just before the characteristic's value is returned.
 // Use it to update the characteristic before it is read
@@ -47,6 +65,17 @@ typedef const char *(*onLocalCharacteristicRead)(const Application *application,
                                                  const char *service_uuid, const char *char_uuid, const guint16 mtu,
                                                  const guint16 offset);
 
+// This callback provides the characteristic's value when it is read, instead of the stored value.
+// Point 'data' and 'length' to the complete value, the library applies the offset itself.
+// The data is borrowed until 'release' is called with 'release_data', so it is never copied by the library.
+// Leave 'release' NULL for data that stays valid, e.g. static data.
+// For accepting the read, return NULL, otherwise return an error (BLUEZ_ERROR_*)
+typedef const char *(*onLocalCharacteristicProvideValue)(const Application *application, const char *address,
+                                                         const char *service_uuid, const char *char_uuid,
+                                                         const guint16 mtu, const guint16 offset,
+                                                         const guint8 **data, gsize *length,
+                                                         GDestroyNotify *release, gpointer *release_data);
+
 // This callback is called just before the characteristic's value is set.
 // Use it to accept (return NULL), or reject (return BLUEZ_ERROR_*) the byte array
 typedef const char *(*onLocalCharacteristicWrite)(const Application *application, const char *address,
@@ -77,6 +106,12 @@ typedef const char *(*onLocalDescriptorWrite)(const Application *application, co
                                               const char *service_uuid, const char *char_uuid,
                                               const char *desc_uuid, const GByteArray *byteArray);
 
+// This callback is called when a central wrote data to a stream, read it with binc_local_stream_read()
+typedef void (*onLocalStreamReadable)(LocalStream *stream);
+
+// This callback is called when all data written to a stream has been sent
+typedef void (*onLocalStreamDrained)(LocalStream *stream);
+
 // Methods
 Application *binc_create_application(const Adapter *adapter);
 
@@ -86,12 +121,37 @@ const char *binc_application_get_path(const Application *application);
 
 int binc_application_add_service(Application *application, const char *service_uuid);
 
+/**
+ * Announce a service that was added after the application was registered
+ *
+ * Add the service, its characteristics and descriptors first. This emits InterfacesAdded for the
+ * service and all its objects, so there is no need to register the whole application again.
+ */
+int binc_application_publish_service(const Application *application, const char *service_uuid);
+
+/**
+ * Remove a service, including its characteristics and descriptors, and emit InterfacesRemoved for them
+ */
+int binc_application_remove_service(Application *application, const char *service_uuid);
+
 int binc_application_add_characteristic(Application *application, const char *service_uuid,
                                         const char *char_uuid, guint permissions);
 
 int binc_application_add_descriptor(Application *application, const char *service_uuid,
                                     const char *char_uuid, const char *desc_uuid, guint permissions);
 
+/**
+ * Load a complete GATT database from a static table
+ *
+ * Each array is terminated by an entry with a NULL uuid. The table is validated as a whole before
+ * anything is registered, so either all services are added or none.
+ *
+ * @param application the application to add the services to
+ * @param services the services to add
+ * @return 0 on success, EINVAL if the table is invalid or registering failed
+ */
+int binc_application_load_database(Application *application, const LocalServiceDef *services);
+
 void binc_application_set_char_read_cb(Application *application, onLocalCharacteristicRead callback);
 
 void binc_application_set_char_write_cb(Application *application, onLocalCharacteristicWrite callback);
@@ -108,6 +168,10 @@ int binc_application_set_char_value(const Application *application, const char *
 GByteArray *binc_application_get_char_value(const Application *application, const char *service_uuid,
                                             const char *char_uuid);
 
+// Serve reads of this characteristic from the provider. The read callback is not called for it anymore.
+int binc_application_set_char_value_provider(const Application *application, const char *service_uuid,
+                                             const char *char_uuid, onLocalCharacteristicProvideValue provider);
+
 void binc_application_set_desc_read_cb(Application *application, onLocalDescriptorRead callback);
 
 void binc_application_set_desc_write_cb(Application *application, onLocalDescriptorWrite callback);
@@ -121,6 +185,111 @@ int binc_application_notify(const Application *application, const char *service_
 gboolean binc_application_char_is_notifying(const Application *application, const char *service_uuid,
                                             const char *char_uuid);
 
+/**
+ * Get a handle to a local characteristic for use with the binc_local_char_* functions.
+ *
+ * Look it up once and keep it; calls using the handle skip the uuid validation and lookups.
+ * The handle stays valid until its service is removed or the application is freed.
+ */
+LocalCharacteristic *binc_application_get_characteristic(const Application *application, const char *service_uuid,
+                                                         const char *char_uuid);
+
+int binc_local_char_notify(const LocalCharacteristic *characteristic, const GByteArray *byteArray);
+
+int binc_local_char_set_value(LocalCharacteristic *characteristic, const GByteArray *byteArray);
+
+GByteArray *binc_local_char_get_value(const LocalCharacteristic *characteristic);
+
+gboolean binc_local_char_is_notifying(const LocalCharacteristic *characteristic);
+
+/**
+ * Get the addresses of the remote centrals that have sent read or write requests
+ *
+ * Centrals are tracked from the options Bluez passes along with every request.
+ * Call binc_application_remove_central() when a central disconnects.
+ *
+ * @param application the application
+ * @return list of addresses, free with g_list_free(). The addresses are owned by the application.
+ */
+GList *binc_application_get_centrals(const Application *application);
+
+// Returns the last mtu reported for the central, or 0 if it is unknown
+guint16 binc_application_get_central_mtu(const Application *application, const char *address);
+
+const char *binc_application_get_central_link_type(const Application *application, const char *address);
+
+guint binc_application_get_central_request_count(const Application *application, const char *address);
+
+guint binc_application_get_char_read_count(const Application *application, const char *service_uuid,
+                                           const char *char_uuid, const char *address);
+
+guint binc_application_get_char_write_count(const Application *application, const char *service_uuid,
+                                            const char *char_uuid, const char *address);
+
+// Returns the smallest mtu of all known centrals, or 0 if none is known
+guint16 binc_application_get_notify_mtu(const Application *application);
+
+/**
+ * Get the number of known centrals that are connected through an adapter.
+ *
+ * An application can be registered on several adapters at once to accept more connections than a
+ * single controller supports. These counters show how the centrals are spread over the adapters.
+ */
+guint binc_application_get_adapter_central_count(const Application *application, const Adapter *adapter);
+
+// Returns the number of read and write requests received through an adapter
+guint binc_application_get_adapter_request_count(const Application *application, const Adapter *adapter);
+
+int binc_application_remove_central(Application *application, const char *address);
+
+/**
+ * Create a byte stream on a pair of local characteristics
+ *
+ * Writes of centrals to the rx characteristic are collected in a receive buffer instead of being set as its value,
+ * so the write callback is not called for them. Data written to the stream is sent as notifications of the tx
+ * characteristic, in chunks that fit the mtu of the last request. The notifications are paced to a burst per
+ * interval, because bluetoothd queues them without flow control. A central that does not subscribe can read the
+ * tx characteristic instead, every read returns the next chunk.
+ *
+ * @param application the application
+ * @param service_uuid the service of both characteristics
+ * @param rx_char_uuid the characteristic centrals write to, or NULL for a stream that only sends
+ * @param tx_char_uuid the characteristic to notify, or NULL for a stream that only receives
+ * @param buffer_size the size of the send and receive buffers, 0 for the default of 4096 bytes
+ * @return the stream, or NULL if a characteristic does not exist or already has a stream. The stream is freed
+ * together with its characteristics.
+ */
+LocalStream *binc_application_create_stream(Application *application, const char *service_uuid,
+                                            const char *rx_char_uuid, const char *tx_char_uuid, gsize buffer_size);
+
+void binc_local_stream_free(LocalStream *stream);
+
+// Returns the number of bytes accepted, less than length if the send buffer is full
+gsize binc_local_stream_write(LocalStream *stream, const guint8 *data, gsize length);
+
+// Returns the number of bytes read from the receive buffer
+gsize binc_local_stream_read(LocalStream *stream, guint8 *data, gsize length);
+
+gsize binc_local_stream_get_readable(const LocalStream *stream);
+
+gsize binc_local_stream_get_pending(const LocalStream *stream);
+
+// Returns the mtu reported in the last request for the stream, or 23 if none was reported yet
+guint16 binc_local_stream_get_mtu(const LocalStream *stream);
+
+// Send at most 'burst' notifications every 'interval_ms' milliseconds, 4 every 15ms by default
+void binc_local_stream_set_pacing(LocalStream *stream, guint burst, guint interval_ms);
+
+void binc_local_stream_set_readable_cb(LocalStream *stream, onLocalStreamReadable callback);
+
+void binc_local_stream_set_drained_cb(LocalStream *stream, onLocalStreamDrained callback);
+
+Application *binc_local_stream_get_application(const LocalStream *stream);
+
+void binc_local_stream_set_user_data(LocalStream *stream, void *user_data);
+
+void *binc_local_stream_get_user_data(const LocalStream *stream);
+
 void binc_application_set_user_data(Application *application, void *user_data);
 
 void *binc_application_get_user_data(const Application *application);
@@ -21,9 +21,10 @@
  *
  */
 
-#include "characteristic.h"
+#include "characteristic_internal.h"
 #include "logger.h"
 #include "utility.h"
+#include "dbus_transport.h"
 #include "device_internal.h"
 
 static const char *const TAG = "Characteristic";
@@ -56,6 +57,10 @@ struct binc_characteristic {
     guint mtu;
 
     guint characteristic_prop_changed;
+    gboolean device_signal;
+    CharacteristicNotifyListener notify_listener;
+    CharacteristicDetachListener detach_listener;
+    void *notify_listener_data; // Borrowed
     OnNotifyingStateChangedCallback notify_state_callback;
     OnReadCallback on_read_callback;
     OnWriteCallback on_write_callback;
@@ -78,8 +83,10 @@ Characteristic *binc_characteristic_create(Device *device, const char *path) {
 void binc_characteristic_free(Characteristic *characteristic) {
     g_assert(characteristic != NULL);
 
+    binc_characteristic_detach_listener(characteristic);
+
     if (characteristic->characteristic_prop_changed != 0) {
-        g_dbus_connection_signal_unsubscribe(characteristic->connection, characteristic->characteristic_prop_changed);
+        binc_dbus_signal_unsubscribe(characteristic->connection, characteristic->characteristic_prop_changed);
         characteristic->characteristic_prop_changed = 0;
     }
 
@@ -141,7 +148,7 @@ static void binc_internal_char_read_cb(__attribute__((unused)) GObject *source_o
     Characteristic *characteristic = (Characteristic *) user_data;
     g_assert(characteristic != NULL);
 
-    GVariant *value = g_dbus_connection_call_finish(characteristic->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(characteristic->connection, res, &error);
     if (value != NULL) {
         g_assert(g_str_equal(g_variant_get_type_string(value), "(ay)"));
         innerArray = g_variant_get_child_value(value, 0);
@@ -183,18 +190,18 @@ void binc_characteristic_read(Characteristic *characteristic) {
     GVariant *options = g_variant_builder_end(builder);
     g_variant_builder_unref(builder);
 
-    g_dbus_connection_call(characteristic->connection,
-                           BLUEZ_DBUS,
-                           characteristic->path,
-                           INTERFACE_CHARACTERISTIC,
-                           CHARACTERISTIC_METHOD_READ_VALUE,
-                           g_variant_new("(@a{sv})", options),
-                           G_VARIANT_TYPE("(ay)"),
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_char_read_cb,
-                           characteristic);
+    binc_dbus_call(characteristic->connection,
+                   BLUEZ_DBUS,
+                   characteristic->path,
+                   INTERFACE_CHARACTERISTIC,
+                   CHARACTERISTIC_METHOD_READ_VALUE,
+                   g_variant_new("(@a{sv})", options),
+                   G_VARIANT_TYPE("(ay)"),
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   (GAsyncReadyCallback) binc_internal_char_read_cb,
+                   characteristic);
 }
 
 static void binc_internal_char_write_cb(__attribute__((unused)) GObject *source_object,
@@ -206,7 +213,7 @@ static void binc_internal_char_write_cb(__attribute__((unused)) GObject *source_
 
     GByteArray *byteArray = NULL;
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(characteristic->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(characteristic->connection, res, &error);
 
     if (writeData->value != NULL) {
         byteArray = g_variant_get_byte_array(writeData->value);
@@ -233,6 +240,17 @@ static void binc_internal_char_write_cb(__attribute__((unused)) GObject *source_
     }
 }
 
+static GVariant *create_write_options(WriteType writeType) {
+    guint16 offset = 0;
+    const char *writeTypeString = writeType == WITH_RESPONSE ? "request" : "command";
+    GVariantBuilder *optionsBuilder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(optionsBuilder, "{sv}", "offset", g_variant_new_uint16(offset));
+    g_variant_builder_add(optionsBuilder, "{sv}", "type", g_variant_new_string(writeTypeString));
+    GVariant *options = g_variant_builder_end(optionsBuilder);
+    g_variant_builder_unref(optionsBuilder);
+    return options;
+}
+
 void binc_characteristic_write(Characteristic *characteristic, const GByteArray *byteArray, WriteType writeType) {
     g_assert(characteristic != NULL);
     g_assert(byteArray != NULL);
@@ -249,38 +267,24 @@ void binc_characteristic_write(Characteristic *characteristic, const GByteArray
     writeData->value = g_variant_ref(value);
     writeData->characteristic = characteristic;
 
-    guint16 offset = 0;
-    const char *writeTypeString = writeType == WITH_RESPONSE ? "request" : "command";
-    GVariantBuilder *optionsBuilder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(optionsBuilder, "{sv}", "offset", g_variant_new_uint16(offset));
-    g_variant_builder_add(optionsBuilder, "{sv}", "type", g_variant_new_string(writeTypeString));
-    GVariant *options = g_variant_builder_end(optionsBuilder);
-    g_variant_builder_unref(optionsBuilder);
-
-    g_dbus_connection_call(characteristic->connection,
-                           BLUEZ_DBUS,
-                           characteristic->path,
-                           INTERFACE_CHARACTERISTIC,
-                           CHARACTERISTIC_METHOD_WRITE_VALUE,
-                           g_variant_new("(@ay@a{sv})", value, options),
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_char_write_cb,
-                           writeData);
-}
-
-static void binc_internal_signal_characteristic_changed(__attribute__((unused)) GDBusConnection *conn,
-                                                        __attribute__((unused)) const gchar *sender,
-                                                        __attribute__((unused)) const gchar *path,
-                                                        __attribute__((unused)) const gchar *interface,
-                                                        __attribute__((unused)) const gchar *signal,
-                                                        GVariant *parameters,
-                                                        void *user_data) {
-
-    Characteristic *characteristic = (Characteristic *) user_data;
+    GVariant *options = create_write_options(writeType);
+    binc_dbus_call(characteristic->connection,
+                   BLUEZ_DBUS,
+                   characteristic->path,
+                   INTERFACE_CHARACTERISTIC,
+                   CHARACTERISTIC_METHOD_WRITE_VALUE,
+                   g_variant_new("(@ay@a{sv})", value, options),
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   (GAsyncReadyCallback) binc_internal_char_write_cb,
+                   writeData);
+}
+
+void binc_characteristic_handle_properties_changed(Characteristic *characteristic, GVariant *parameters) {
     g_assert(characteristic != NULL);
+    g_assert(parameters != NULL);
 
     GVariantIter *properties_changed = NULL;
     GVariantIter *properties_invalidated = NULL;
@@ -301,8 +305,8 @@ static void binc_internal_signal_characteristic_changed(__attribute__((unused))
 
             if (characteristic->notifying == FALSE) {
                 if (characteristic->characteristic_prop_changed != 0) {
-                    g_dbus_connection_signal_unsubscribe(characteristic->connection,
-                                                         characteristic->characteristic_prop_changed);
+                    binc_dbus_signal_unsubscribe(characteristic->connection,
+                                                 characteristic->characteristic_prop_changed);
                     characteristic->characteristic_prop_changed = 0;
                 }
             }
@@ -312,7 +316,10 @@ static void binc_internal_signal_characteristic_changed(__attribute__((unused))
             log_debug(TAG, "notification <%s> on <%s>", result->str, characteristic->uuid);
             g_string_free(result, TRUE);
 
-            if (characteristic->on_notify_callback != NULL) {
+            binc_device_record_notification(characteristic->device);
+            if (characteristic->notify_listener != NULL) {
+                characteristic->notify_listener(characteristic, byteArray, characteristic->notify_listener_data);
+            } else if (characteristic->on_notify_callback != NULL) {
                 characteristic->on_notify_callback(characteristic->device, characteristic, byteArray);
             }
             g_byte_array_free(byteArray, FALSE);
@@ -327,6 +334,18 @@ static void binc_internal_signal_characteristic_changed(__attribute__((unused))
     }
 }
 
+static void binc_internal_signal_characteristic_changed(__attribute__((unused)) GDBusConnection *conn,
+                                                        __attribute__((unused)) const gchar *sender,
+                                                        __attribute__((unused)) const gchar *path,
+                                                        __attribute__((unused)) const gchar *interface,
+                                                        __attribute__((unused)) const gchar *signal,
+                                                        GVariant *parameters,
+                                                        void *user_data) {
+
+    Characteristic *characteristic = (Characteristic *) user_data;
+    binc_characteristic_handle_properties_changed(characteristic, parameters);
+}
+
 static void binc_internal_char_start_notify_cb(__attribute__((unused)) GObject *source_object,
                                                GAsyncResult *res,
                                                gpointer user_data) {
@@ -335,7 +354,7 @@ static void binc_internal_char_start_notify_cb(__attribute__((unused)) GObject *
     g_assert(characteristic != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(characteristic->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(characteristic->connection, res, &error);
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -351,39 +370,105 @@ static void binc_internal_char_start_notify_cb(__attribute__((unused)) GObject *
 }
 
 static void register_for_properties_changed_signal(Characteristic *characteristic) {
-    if (characteristic->characteristic_prop_changed == 0) {
-        characteristic->characteristic_prop_changed = g_dbus_connection_signal_subscribe(characteristic->connection,
-                                                                                         BLUEZ_DBUS,
-                                                                                         "org.freedesktop.DBus.Properties",
-                                                                                         "PropertiesChanged",
-                                                                                         characteristic->path,
-                                                                                         INTERFACE_CHARACTERISTIC,
-                                                                                         G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                                         binc_internal_signal_characteristic_changed,
-                                                                                         characteristic,
-                                                                                         NULL);
+    if (characteristic->characteristic_prop_changed == 0 && !characteristic->device_signal) {
+        characteristic->characteristic_prop_changed = binc_dbus_signal_subscribe(characteristic->connection,
+                                                                                 BLUEZ_DBUS,
+                                                                                 "org.freedesktop.DBus.Properties",
+                                                                                 "PropertiesChanged",
+                                                                                 characteristic->path,
+                                                                                 INTERFACE_CHARACTERISTIC,
+                                                                                 G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                                 binc_internal_signal_characteristic_changed,
+                                                                                 characteristic,
+                                                                                 NULL);
     }
 }
 
-void binc_characteristic_start_notify(Characteristic *characteristic) {
+void binc_characteristic_start_notify_async(Characteristic *characteristic, GAsyncReadyCallback callback,
+                                            gpointer user_data) {
     g_assert(characteristic != NULL);
+    g_assert(callback != NULL);
     g_assert(binc_characteristic_supports_notify(characteristic));
 
     log_debug(TAG, "start notify for <%s>", characteristic->uuid);
     register_for_properties_changed_signal(characteristic);
 
-    g_dbus_connection_call(characteristic->connection,
-                           BLUEZ_DBUS,
-                           characteristic->path,
-                           INTERFACE_CHARACTERISTIC,
-                           CHARACTERISTIC_METHOD_START_NOTIFY,
-                           NULL,
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_char_start_notify_cb,
-                           characteristic);
+    binc_dbus_call(characteristic->connection,
+                   BLUEZ_DBUS,
+                   characteristic->path,
+                   INTERFACE_CHARACTERISTIC,
+                   CHARACTERISTIC_METHOD_START_NOTIFY,
+                   NULL,
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   callback,
+                   user_data);
+}
+
+void binc_characteristic_start_notify(Characteristic *characteristic) {
+    binc_characteristic_start_notify_async(characteristic,
+                                           (GAsyncReadyCallback) binc_internal_char_start_notify_cb,
+                                           characteristic);
+}
+
+void binc_characteristic_write_async(Characteristic *characteristic, const guint8 *data, gsize length,
+                                     WriteType writeType, GAsyncReadyCallback callback, gpointer user_data) {
+    g_assert(characteristic != NULL);
+    g_assert(data != NULL);
+    g_assert(length > 0);
+    g_assert(callback != NULL);
+    g_assert(binc_characteristic_supports_write(characteristic, writeType));
+
+    GVariant *value = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, data, length, sizeof(guint8));
+    binc_dbus_call(characteristic->connection,
+                   BLUEZ_DBUS,
+                   characteristic->path,
+                   INTERFACE_CHARACTERISTIC,
+                   CHARACTERISTIC_METHOD_WRITE_VALUE,
+                   g_variant_new("(@ay@a{sv})", value, create_write_options(writeType)),
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   callback,
+                   user_data);
+}
+
+void binc_characteristic_set_notify_listener(Characteristic *characteristic, CharacteristicNotifyListener listener,
+                                             CharacteristicDetachListener detach_listener, void *user_data) {
+    g_assert(characteristic != NULL);
+
+    characteristic->notify_listener = listener;
+    characteristic->detach_listener = detach_listener;
+    characteristic->notify_listener_data = user_data;
+}
+
+void binc_characteristic_detach_listener(Characteristic *characteristic) {
+    g_assert(characteristic != NULL);
+
+    CharacteristicDetachListener detach_listener = characteristic->detach_listener;
+    void *user_data = characteristic->notify_listener_data;
+    binc_characteristic_set_notify_listener(characteristic, NULL, NULL, NULL);
+    if (detach_listener != NULL) {
+        detach_listener(characteristic, user_data);
+    }
+}
+
+guint binc_characteristic_get_mtu(const Characteristic *characteristic) {
+    g_assert(characteristic != NULL);
+    return characteristic->mtu;
+}
+
+void binc_characteristic_use_device_signal(Characteristic *characteristic) {
+    g_assert(characteristic != NULL);
+
+    characteristic->device_signal = TRUE;
+    if (characteristic->characteristic_prop_changed != 0) {
+        binc_dbus_signal_unsubscribe(characteristic->connection, characteristic->characteristic_prop_changed);
+        characteristic->characteristic_prop_changed = 0;
+    }
 }
 
 static void binc_internal_char_stop_notify_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
@@ -391,7 +476,7 @@ static void binc_internal_char_stop_notify_cb(GObject *source_object, GAsyncResu
     g_assert(characteristic != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(characteristic->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(characteristic->connection, res, &error);
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -411,18 +496,18 @@ void binc_characteristic_stop_notify(Characteristic *characteristic) {
     g_assert((characteristic->properties & GATT_CHR_PROP_INDICATE) > 0 ||
              (characteristic->properties & GATT_CHR_PROP_NOTIFY) > 0);
 
-    g_dbus_connection_call(characteristic->connection,
-                           BLUEZ_DBUS,
-                           characteristic->path,
-                           INTERFACE_CHARACTERISTIC,
-                           CHARACTERISTIC_METHOD_STOP_NOTIFY,
-                           NULL,
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_char_stop_notify_cb,
-                           characteristic);
+    binc_dbus_call(characteristic->connection,
+                   BLUEZ_DBUS,
+                   characteristic->path,
+                   INTERFACE_CHARACTERISTIC,
+                   CHARACTERISTIC_METHOD_STOP_NOTIFY,
+                   NULL,
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   (GAsyncReadyCallback) binc_internal_char_stop_notify_cb,
+                   characteristic);
 }
 
 void binc_characteristic_set_read_cb(Characteristic *characteristic, OnReadCallback callback) {
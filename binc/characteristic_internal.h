@@ -30,6 +30,12 @@
 extern "C" {
 #endif
 
+typedef void (*CharacteristicNotifyListener)(Characteristic *characteristic, const GByteArray *byteArray,
+                                             void *user_data);
+
+// Called when the characteristic can't be used anymore, because its device disconnected or it is being freed
+typedef void (*CharacteristicDetachListener)(Characteristic *characteristic, void *user_data);
+
 Characteristic *binc_characteristic_create(Device *device, const char *path);
 
 void binc_characteristic_free(Characteristic *characteristic);
@@ -59,6 +65,28 @@ const char *binc_characteristic_get_service_path(const Characteristic *character
 
 void binc_characteristic_add_descriptor(Characteristic *characteristic, Descriptor *descriptor);
 
+void binc_characteristic_handle_properties_changed(Characteristic *characteristic, GVariant *parameters);
+
+// Call StartNotify and let the caller handle the reply with binc_dbus_call_finish()
+void binc_characteristic_start_notify_async(Characteristic *characteristic, GAsyncReadyCallback callback,
+                                            gpointer user_data);
+
+// Write raw bytes and let the caller handle the reply with binc_dbus_call_finish()
+void binc_characteristic_write_async(Characteristic *characteristic, const guint8 *data, gsize length,
+                                     WriteType writeType, GAsyncReadyCallback callback, gpointer user_data);
+
+// Deliver notifications to the listener instead of to the device, pass NULL to undo. detach_listener may be NULL
+void binc_characteristic_set_notify_listener(Characteristic *characteristic, CharacteristicNotifyListener listener,
+                                             CharacteristicDetachListener detach_listener, void *user_data);
+
+// Remove the listeners and call the detach listener, if any
+void binc_characteristic_detach_listener(Characteristic *characteristic);
+
+guint binc_characteristic_get_mtu(const Characteristic *characteristic);
+
+// Stop listening for PropertiesChanged signals because the device delivers them
+void binc_characteristic_use_device_signal(Characteristic *characteristic);
+
 #ifdef __cplusplus
 }
 #endif
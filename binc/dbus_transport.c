@@ -0,0 +1,96 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "dbus_transport.h"
+
+const DBusTransport binc_gdbus_transport = {
+        .name = "gdbus",
+        .call = g_dbus_connection_call,
+        .call_finish = g_dbus_connection_call_finish,
+        .call_sync = g_dbus_connection_call_sync,
+        .signal_subscribe = g_dbus_connection_signal_subscribe,
+        .signal_unsubscribe = g_dbus_connection_signal_unsubscribe,
+        .register_object = g_dbus_connection_register_object,
+        .unregister_object = g_dbus_connection_unregister_object,
+        .emit_signal = g_dbus_connection_emit_signal,
+};
+
+static const DBusTransport *transport = &binc_gdbus_transport;
+
+const DBusTransport *binc_dbus_transport_get(void) {
+    return transport;
+}
+
+void binc_dbus_transport_set(const DBusTransport *new_transport) {
+    transport = new_transport != NULL ? new_transport : &binc_gdbus_transport;
+}
+
+void binc_dbus_call(GDBusConnection *connection, const gchar *bus_name, const gchar *object_path,
+                    const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                    const GVariantType *reply_type, GDBusCallFlags flags, gint timeout_msec,
+                    GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data) {
+    transport->call(connection, bus_name, object_path, interface_name, method_name, parameters, reply_type,
+                    flags, timeout_msec, cancellable, callback, user_data);
+}
+
+GVariant *binc_dbus_call_finish(GDBusConnection *connection, GAsyncResult *res, GError **error) {
+    return transport->call_finish(connection, res, error);
+}
+
+GVariant *binc_dbus_call_sync(GDBusConnection *connection, const gchar *bus_name, const gchar *object_path,
+                              const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                              const GVariantType *reply_type, GDBusCallFlags flags, gint timeout_msec,
+                              GCancellable *cancellable, GError **error) {
+    return transport->call_sync(connection, bus_name, object_path, interface_name, method_name, parameters,
+                                reply_type, flags, timeout_msec, cancellable, error);
+}
+
+guint binc_dbus_signal_subscribe(GDBusConnection *connection, const gchar *sender, const gchar *interface_name,
+                                 const gchar *member, const gchar *object_path, const gchar *arg0,
+                                 GDBusSignalFlags flags, GDBusSignalCallback callback, gpointer user_data,
+                                 GDestroyNotify user_data_free_func) {
+    return transport->signal_subscribe(connection, sender, interface_name, member, object_path, arg0, flags,
+                                       callback, user_data, user_data_free_func);
+}
+
+void binc_dbus_signal_unsubscribe(GDBusConnection *connection, guint subscription_id) {
+    transport->signal_unsubscribe(connection, subscription_id);
+}
+
+guint binc_dbus_register_object(GDBusConnection *connection, const gchar *object_path,
+                                GDBusInterfaceInfo *interface_info, const GDBusInterfaceVTable *vtable,
+                                gpointer user_data, GDestroyNotify user_data_free_func, GError **error) {
+    return transport->register_object(connection, object_path, interface_info, vtable, user_data,
+                                      user_data_free_func, error);
+}
+
+gboolean binc_dbus_unregister_object(GDBusConnection *connection, guint registration_id) {
+    return transport->unregister_object(connection, registration_id);
+}
+
+gboolean binc_dbus_emit_signal(GDBusConnection *connection, const gchar *destination_bus_name,
+                               const gchar *object_path, const gchar *interface_name, const gchar *signal_name,
+                               GVariant *parameters, GError **error) {
+    return transport->emit_signal(connection, destination_bus_name, object_path, interface_name, signal_name,
+                                  parameters, error);
+}
@@ -0,0 +1,108 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_DBUS_TRANSPORT_H
+#define BINC_DBUS_TRANSPORT_H
+
+#include <gio/gio.h>
+
+/*
+ * Internal transport between the library and Bluez. All modules talk to the bus through these functions
+ * instead of calling GDBus directly, so the transport can be swapped without touching them.
+ * The functions take the same arguments as their GDBus counterparts.
+ */
+
+typedef struct binc_dbus_transport {
+    const char *name;
+
+    void (*call)(GDBusConnection *connection, const gchar *bus_name, const gchar *object_path,
+                 const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                 const GVariantType *reply_type, GDBusCallFlags flags, gint timeout_msec,
+                 GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+    GVariant *(*call_finish)(GDBusConnection *connection, GAsyncResult *res, GError **error);
+
+    GVariant *(*call_sync)(GDBusConnection *connection, const gchar *bus_name, const gchar *object_path,
+                           const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                           const GVariantType *reply_type, GDBusCallFlags flags, gint timeout_msec,
+                           GCancellable *cancellable, GError **error);
+
+    guint (*signal_subscribe)(GDBusConnection *connection, const gchar *sender, const gchar *interface_name,
+                              const gchar *member, const gchar *object_path, const gchar *arg0,
+                              GDBusSignalFlags flags, GDBusSignalCallback callback, gpointer user_data,
+                              GDestroyNotify user_data_free_func);
+
+    void (*signal_unsubscribe)(GDBusConnection *connection, guint subscription_id);
+
+    guint (*register_object)(GDBusConnection *connection, const gchar *object_path,
+                             GDBusInterfaceInfo *interface_info, const GDBusInterfaceVTable *vtable,
+                             gpointer user_data, GDestroyNotify user_data_free_func, GError **error);
+
+    gboolean (*unregister_object)(GDBusConnection *connection, guint registration_id);
+
+    gboolean (*emit_signal)(GDBusConnection *connection, const gchar *destination_bus_name,
+                            const gchar *object_path, const gchar *interface_name, const gchar *signal_name,
+                            GVariant *parameters, GError **error);
+} DBusTransport;
+
+// The default transport, using GDBus on a real bus
+extern const DBusTransport binc_gdbus_transport;
+
+const DBusTransport *binc_dbus_transport_get(void);
+
+/**
+ * Replace the transport used by all modules. Only do this before creating any adapters.
+ * @param transport the transport to use, or NULL to restore the GDBus transport
+ */
+void binc_dbus_transport_set(const DBusTransport *transport);
+
+void binc_dbus_call(GDBusConnection *connection, const gchar *bus_name, const gchar *object_path,
+                    const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                    const GVariantType *reply_type, GDBusCallFlags flags, gint timeout_msec,
+                    GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+GVariant *binc_dbus_call_finish(GDBusConnection *connection, GAsyncResult *res, GError **error);
+
+GVariant *binc_dbus_call_sync(GDBusConnection *connection, const gchar *bus_name, const gchar *object_path,
+                              const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                              const GVariantType *reply_type, GDBusCallFlags flags, gint timeout_msec,
+                              GCancellable *cancellable, GError **error);
+
+guint binc_dbus_signal_subscribe(GDBusConnection *connection, const gchar *sender, const gchar *interface_name,
+                                 const gchar *member, const gchar *object_path, const gchar *arg0,
+                                 GDBusSignalFlags flags, GDBusSignalCallback callback, gpointer user_data,
+                                 GDestroyNotify user_data_free_func);
+
+void binc_dbus_signal_unsubscribe(GDBusConnection *connection, guint subscription_id);
+
+guint binc_dbus_register_object(GDBusConnection *connection, const gchar *object_path,
+                                GDBusInterfaceInfo *interface_info, const GDBusInterfaceVTable *vtable,
+                                gpointer user_data, GDestroyNotify user_data_free_func, GError **error);
+
+gboolean binc_dbus_unregister_object(GDBusConnection *connection, guint registration_id);
+
+gboolean binc_dbus_emit_signal(GDBusConnection *connection, const gchar *destination_bus_name,
+                               const gchar *object_path, const gchar *interface_name, const gchar *signal_name,
+                               GVariant *parameters, GError **error);
+
+#endif //BINC_DBUS_TRANSPORT_H
@@ -30,6 +30,7 @@
 #include "descriptor.h"
 #include "device_internal.h"
 #include "utility.h"
+#include "dbus_transport.h"
 #include "logger.h"
 
 static const char *const TAG = "Descriptor";
@@ -158,7 +159,7 @@ static void binc_internal_descriptor_read_cb(GObject *source_object, GAsyncResul
     Descriptor *descriptor = (Descriptor *) user_data;
     g_assert(descriptor != NULL);
 
-    GVariant *value = g_dbus_connection_call_finish(descriptor->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(descriptor->connection, res, &error);
     if (value != NULL) {
         g_assert(g_str_equal(g_variant_get_type_string(value), "(ay)"));
         innerArray = g_variant_get_child_value(value, 0);
@@ -199,18 +200,18 @@ void binc_descriptor_read(Descriptor *descriptor) {
     GVariant *options = g_variant_builder_end(builder);
     g_variant_builder_unref(builder);
 
-    g_dbus_connection_call(descriptor->connection,
-                           BLUEZ_DBUS,
-                           descriptor->path,
-                           INTERFACE_DESCRIPTOR,
-                           DESCRIPTOR_METHOD_READ_VALUE,
-                           g_variant_new("(@a{sv})", options),
-                           G_VARIANT_TYPE("(ay)"),
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_descriptor_read_cb,
-                           descriptor);
+    binc_dbus_call(descriptor->connection,
+                   BLUEZ_DBUS,
+                   descriptor->path,
+                   INTERFACE_DESCRIPTOR,
+                   DESCRIPTOR_METHOD_READ_VALUE,
+                   g_variant_new("(@a{sv})", options),
+                   G_VARIANT_TYPE("(ay)"),
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   (GAsyncReadyCallback) binc_internal_descriptor_read_cb,
+                   descriptor);
 }
 
 typedef struct binc_desc_write_data {
@@ -225,7 +226,7 @@ static void binc_internal_descriptor_write_cb(GObject *source_object, GAsyncResu
 
     GByteArray *byteArray = NULL;
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(descriptor->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(descriptor->connection, res, &error);
 
     if (writeData->value != NULL) {
         byteArray = g_variant_get_byte_array(writeData->value);
@@ -273,18 +274,18 @@ void binc_descriptor_write(Descriptor *descriptor, const GByteArray *byteArray)
     GVariant *options = g_variant_builder_end(builder);
     g_variant_builder_unref(builder);
 
-    g_dbus_connection_call(descriptor->connection,
-                           BLUEZ_DBUS,
-                           descriptor->path,
-                           INTERFACE_DESCRIPTOR,
-                           DESCRIPTOR_METHOD_WRITE_VALUE,
-                           g_variant_new("(@ay@a{sv})", value, options),
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_descriptor_write_cb,
-                           writeData);
+    binc_dbus_call(descriptor->connection,
+                   BLUEZ_DBUS,
+                   descriptor->path,
+                   INTERFACE_DESCRIPTOR,
+                   DESCRIPTOR_METHOD_WRITE_VALUE,
+                   g_variant_new("(@ay@a{sv})", value, options),
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   (GAsyncReadyCallback) binc_internal_descriptor_write_cb,
+                   writeData);
 }
 
 void binc_descriptor_set_read_cb(Descriptor *descriptor, OnDescReadCallback callback) {
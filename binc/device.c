@@ -22,9 +22,11 @@
  */
 
 #include <gio/gio.h>
+#include <string.h>
 #include "logger.h"
 #include "device.h"
 #include "utility.h"
+#include "dbus_transport.h"
 #include "service_internal.h"
 #include "characteristic_internal.h"
 #include "adapter.h"
@@ -51,6 +53,20 @@ static const char *const DEVICE_PROPERTY_TRUSTED = "Trusted";
 static const char *const DEVICE_PROPERTY_TXPOWER = "TxPower";
 static const char *const DEVICE_PROPERTY_CONNECTED = "Connected";
 static const char *const DEVICE_PROPERTY_SERVICES_RESOLVED = "ServicesResolved";
+static const char *const DEVICE_PROPERTY_ADVERTISING_DATA = "AdvertisingData";
+static const char *const DEVICE_PROPERTY_ADVERTISING_FLAGS = "AdvertisingFlags";
+
+static const char *const BLUETOOTH_BASE_UUID_SUFFIX = "-0000-1000-8000-00805f9b34fb";
+static const guint8 AD_TYPE_FLAGS = 0x01;
+static const guint8 AD_TYPE_SERVICE_DATA_16 = 0x16;
+static const guint8 AD_TYPE_SERVICE_DATA_32 = 0x20;
+static const guint8 AD_TYPE_SERVICE_DATA_128 = 0x21;
+static const guint8 AD_TYPE_MANUFACTURER_DATA = 0xFF;
+
+// Each advertising property is kept as AD structures in its own section, so a property update only rewrites its section
+typedef enum AdSection {
+    AD_SECTION_FLAGS = 0, AD_SECTION_DATA = 1, AD_SECTION_MANUFACTURER = 2, AD_SECTION_SERVICE = 3, AD_SECTION_COUNT = 4
+} AdSection;
 
 static const char *const INTERFACE_SERVICE = "org.bluez.GattService1";
 static const char *const INTERFACE_CHARACTERISTIC = "org.bluez.GattCharacteristic1";
@@ -81,10 +97,14 @@ struct binc_device {
     short txpower;
     GHashTable *manufacturer_data; // Owned
     GHashTable *service_data; // Owned
+    GByteArray *advertising[AD_SECTION_COUNT]; // Owned, AD structures: length, type, data
     GList *uuids; // Owned
     guint mtu;
+    guint id;
+    guint64 notification_count;
 
     guint device_prop_changed;
+    gboolean char_signals;
     ConnectionStateChangedCallback connection_state_callback;
     ServicesResolvedCallback services_resolved_callback;
     BondingStateChangedCallback bonding_state_callback;
@@ -92,6 +112,7 @@ struct binc_device {
     GList *services_list; // Owned
     GHashTable *characteristics; // Owned
     GHashTable *descriptors; // Owned
+    GList *bulk_notifies; // Owned
     gboolean is_central;
 
     OnReadCallback on_read_callback;
@@ -103,6 +124,7 @@ struct binc_device {
     void *user_data; // Borrowed
 };
 
+static void abort_bulk_notifies(Device *device);
 
 Device *binc_device_create(const char *path, Adapter *adapter) {
     g_assert(path != NULL);
@@ -156,10 +178,13 @@ void binc_device_free(Device *device) {
     log_debug(TAG, "freeing %s", device->path);
 
     if (device->device_prop_changed != 0) {
-        g_dbus_connection_signal_unsubscribe(device->connection, device->device_prop_changed);
+        binc_dbus_signal_unsubscribe(device->connection, device->device_prop_changed);
         device->device_prop_changed = 0;
     }
 
+    device->char_signals = FALSE;
+    abort_bulk_notifies(device);
+
     g_free((char *) device->path);
     device->path = NULL;
     g_free((char *) device->address_type);
@@ -190,6 +215,13 @@ void binc_device_free(Device *device) {
     binc_device_free_service_data(device);
     binc_device_free_uuids(device);
 
+    for (guint i = 0; i < AD_SECTION_COUNT; i++) {
+        if (device->advertising[i] != NULL) {
+            g_byte_array_free(device->advertising[i], TRUE);
+            device->advertising[i] = NULL;
+        }
+    }
+
     if (device->services_list != NULL) {
         g_list_free(device->services_list);
         device->services_list = NULL;
@@ -308,6 +340,17 @@ static void binc_on_descriptor_write(Device *device, Descriptor *descriptor, con
 static void binc_device_internal_set_conn_state(Device *device, ConnectionState state, GError *error) {
     ConnectionState old_state = device->connection_state;
     device->connection_state = state;
+
+    // Let users of the characteristics stop before the connection state is reported
+    if (state == BINC_DISCONNECTED && old_state != BINC_DISCONNECTED && device->characteristics != NULL) {
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, device->characteristics);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            binc_characteristic_detach_listener((Characteristic *) value);
+        }
+    }
+
     if (device->connection_state_callback != NULL) {
         if (device->connection_state != old_state) {
             device->connection_state_callback(device, state, error);
@@ -348,6 +391,9 @@ static void binc_internal_extract_characteristic(Device *device, const char *obj
     binc_characteristic_set_notify_cb(characteristic, &binc_on_characteristic_notify);
     binc_characteristic_set_notifying_state_change_cb(characteristic,
                                                       &binc_on_characteristic_notification_state_changed);
+    if (device->char_signals) {
+        binc_characteristic_use_device_signal(characteristic);
+    }
 
     const char *property_name;
     GVariantIter iter;
@@ -439,7 +485,7 @@ static void binc_internal_collect_gatt_tree_cb(__attribute__((unused)) GObject *
     Device *device = (Device *) user_data;
     g_assert(device != NULL);
 
-    GVariant *result = g_dbus_connection_call_finish(device->connection, res, &error);
+    GVariant *result = binc_dbus_call_finish(device->connection, res, &error);
 
     if (result == NULL) {
         log_error(TAG, "Unable to get result for GetManagedObjects");
@@ -454,6 +500,9 @@ static void binc_internal_collect_gatt_tree_cb(__attribute__((unused)) GObject *
     const char *object_path;
     GVariant *ifaces_and_properties;
     if (result) {
+        // The new characteristics subscribe themselves until notify is started for all of them again
+        abort_bulk_notifies(device);
+        device->char_signals = FALSE;
         if (device->services != NULL) {
             g_hash_table_destroy(device->services);
         }
@@ -514,18 +563,18 @@ static void binc_collect_gatt_tree(Device *device) {
     g_assert(device != NULL);
 
     device->service_discovery_started = TRUE;
-    g_dbus_connection_call(device->connection,
-                           BLUEZ_DBUS,
-                           "/",
-                           "org.freedesktop.DBus.ObjectManager",
-                           "GetManagedObjects",
-                           NULL,
-                           G_VARIANT_TYPE("(a{oa{sa{sv}}})"),
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_collect_gatt_tree_cb,
-                           device);
+    binc_dbus_call(device->connection,
+                   BLUEZ_DBUS,
+                   "/",
+                   "org.freedesktop.DBus.ObjectManager",
+                   "GetManagedObjects",
+                   NULL,
+                   G_VARIANT_TYPE("(a{oa{sa{sv}}})"),
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   (GAsyncReadyCallback) binc_internal_collect_gatt_tree_cb,
+                   device);
 }
 
 void binc_device_set_bonding_state_changed_cb(Device *device, BondingStateChangedCallback callback) {
@@ -570,7 +619,7 @@ static void binc_device_changed(__attribute__((unused)) GDBusConnection *conn,
         if (g_str_equal(property_name, DEVICE_PROPERTY_CONNECTED)) {
             binc_device_internal_set_conn_state(device, g_variant_get_boolean(property_value), NULL);
             if (device->connection_state == BINC_DISCONNECTED) {
-                g_dbus_connection_signal_unsubscribe(device->connection, device->device_prop_changed);
+                binc_dbus_signal_unsubscribe(device->connection, device->device_prop_changed);
                 device->device_prop_changed = 0;
             }
         } else if (g_str_equal(property_name, DEVICE_PROPERTY_SERVICES_RESOLVED)) {
@@ -610,7 +659,7 @@ static void binc_internal_device_connect_cb(__attribute__((unused)) GObject *sou
     Device *device = (Device *) user_data;
     g_assert(device != NULL);
 
-    GVariant *value = g_dbus_connection_call_finish(device->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(device->connection, res, &error);
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -628,16 +677,16 @@ static void binc_internal_device_connect_cb(__attribute__((unused)) GObject *sou
 
 static void subscribe_prop_changed(Device *device) {
     if (device->device_prop_changed == 0) {
-        device->device_prop_changed = g_dbus_connection_signal_subscribe(device->connection,
-                                                                         BLUEZ_DBUS,
-                                                                         "org.freedesktop.DBus.Properties",
-                                                                         "PropertiesChanged",
-                                                                         device->path,
-                                                                         INTERFACE_DEVICE,
-                                                                         G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                         binc_device_changed,
-                                                                         device,
-                                                                         NULL);
+        device->device_prop_changed = binc_dbus_signal_subscribe(device->connection,
+                                                                 BLUEZ_DBUS,
+                                                                 "org.freedesktop.DBus.Properties",
+                                                                 "PropertiesChanged",
+                                                                 device->path,
+                                                                 INTERFACE_DEVICE,
+                                                                 G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                 binc_device_changed,
+                                                                 device,
+                                                                 NULL);
     }
 }
 
@@ -653,18 +702,18 @@ void binc_device_connect(Device *device) {
 
     binc_device_internal_set_conn_state(device, BINC_CONNECTING, NULL);
     subscribe_prop_changed(device);
-    g_dbus_connection_call(device->connection,
-                           BLUEZ_DBUS,
-                           device->path,
-                           INTERFACE_DEVICE,
-                           DEVICE_METHOD_CONNECT,
-                           NULL,
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_device_connect_cb,
-                           device);
+    binc_dbus_call(device->connection,
+                   BLUEZ_DBUS,
+                   device->path,
+                   INTERFACE_DEVICE,
+                   DEVICE_METHOD_CONNECT,
+                   NULL,
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   (GAsyncReadyCallback) binc_internal_device_connect_cb,
+                   device);
 }
 
 static void binc_internal_device_pair_cb(__attribute__((unused)) GObject *source_object,
@@ -675,7 +724,7 @@ static void binc_internal_device_pair_cb(__attribute__((unused)) GObject *source
     g_assert(device != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(device->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(device->connection, res, &error);
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -702,18 +751,18 @@ void binc_device_pair(Device *device) {
     }
 
     subscribe_prop_changed(device);
-    g_dbus_connection_call(device->connection,
-                           BLUEZ_DBUS,
-                           device->path,
-                           INTERFACE_DEVICE,
-                           DEVICE_METHOD_PAIR,
-                           NULL,
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_device_pair_cb,
-                           device);
+    binc_dbus_call(device->connection,
+                   BLUEZ_DBUS,
+                   device->path,
+                   INTERFACE_DEVICE,
+                   DEVICE_METHOD_PAIR,
+                   NULL,
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   (GAsyncReadyCallback) binc_internal_device_pair_cb,
+                   device);
 }
 
 static void binc_internal_device_disconnect_cb(__attribute__((unused)) GObject *source_object,
@@ -724,7 +773,7 @@ static void binc_internal_device_disconnect_cb(__attribute__((unused)) GObject *
     g_assert(device != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(device->connection, res, &error);
+    GVariant *value = binc_dbus_call_finish(device->connection, res, &error);
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -746,18 +795,18 @@ void binc_device_disconnect(Device *device) {
     log_debug(TAG, "Disconnecting '%s' (%s)", device->name, device->address);
 
     binc_device_internal_set_conn_state(device, BINC_DISCONNECTING, NULL);
-    g_dbus_connection_call(device->connection,
-                           BLUEZ_DBUS,
-                           device->path,
-                           INTERFACE_DEVICE,
-                           DEVICE_METHOD_DISCONNECT,
-                           NULL,
-                           NULL,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_device_disconnect_cb,
-                           device);
+    binc_dbus_call(device->connection,
+                   BLUEZ_DBUS,
+                   device->path,
+                   INTERFACE_DEVICE,
+                   DEVICE_METHOD_DISCONNECT,
+                   NULL,
+                   NULL,
+                   G_DBUS_CALL_FLAGS_NONE,
+                   -1,
+                   NULL,
+                   (GAsyncReadyCallback) binc_internal_device_disconnect_cb,
+                   device);
 }
 
 
@@ -916,6 +965,189 @@ gboolean binc_device_start_notify(const Device *device, const char *service_uuid
     return FALSE;
 }
 
+typedef struct binc_bulk_notify {
+    Device *device; // Borrowed, NULL when aborted
+    GDBusConnection *connection; // Borrowed
+    GQueue *pending; // Owned
+    NotifyResult *results; // Owned
+    guint window;
+    guint in_flight;
+    guint completed;
+    guint failed;
+    guint total;
+    OnStartNotifyAllCallback callback;
+    void *user_data; // Borrowed
+} BulkNotify;
+
+typedef struct binc_bulk_notify_call {
+    BulkNotify *bulkNotify; // Borrowed
+    guint index;
+} BulkNotifyCall;
+
+static void bulk_notify_free(BulkNotify *bulkNotify) {
+    g_assert(bulkNotify != NULL);
+
+    for (guint i = 0; i < bulkNotify->total; i++) {
+        g_clear_error(&bulkNotify->results[i].error);
+    }
+    g_free(bulkNotify->results);
+    g_queue_free(bulkNotify->pending);
+    g_free(bulkNotify);
+}
+
+static void abort_bulk_notifies(Device *device) {
+    // The characteristics in the results are about to be freed, so drop the replies that are still coming
+    for (GList *iterator = device->bulk_notifies; iterator; iterator = iterator->next) {
+        BulkNotify *bulkNotify = (BulkNotify *) iterator->data;
+        log_debug(TAG, "aborting start notify, %u calls outstanding", bulkNotify->in_flight);
+        bulkNotify->device = NULL;
+        g_queue_clear(bulkNotify->pending);
+    }
+    g_list_free(device->bulk_notifies);
+    device->bulk_notifies = NULL;
+}
+
+void binc_device_handle_characteristic_changed(Device *device, const char *path, GVariant *parameters) {
+    g_assert(device != NULL);
+    g_assert(path != NULL);
+
+    // Characteristics that have their own subscription already handled the signal
+    if (!device->char_signals || device->characteristics == NULL) return;
+
+    Characteristic *characteristic = g_hash_table_lookup(device->characteristics, path);
+    if (characteristic != NULL) {
+        binc_characteristic_handle_properties_changed(characteristic, parameters);
+    }
+}
+
+static void register_for_characteristic_signals(Device *device) {
+    if (device->char_signals) return;
+
+    // The adapter's subscription delivers the signals instead of a match rule per characteristic
+    device->char_signals = TRUE;
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, device->characteristics);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        binc_characteristic_use_device_signal((Characteristic *) value);
+    }
+}
+
+static void bulk_notify_send_next(BulkNotify *bulkNotify);
+
+static void binc_internal_bulk_notify_cb(__attribute__((unused)) GObject *source_object,
+                                         GAsyncResult *res,
+                                         gpointer user_data) {
+    BulkNotifyCall *call = (BulkNotifyCall *) user_data;
+    g_assert(call != NULL);
+
+    BulkNotify *bulkNotify = call->bulkNotify;
+    NotifyResult *result = &bulkNotify->results[call->index];
+    g_free(call);
+    bulkNotify->in_flight--;
+
+    GVariant *value = binc_dbus_call_finish(bulkNotify->connection, res, &result->error);
+    if (value != NULL) {
+        g_variant_unref(value);
+    }
+
+    if (bulkNotify->device == NULL) {
+        if (bulkNotify->in_flight == 0) {
+            bulk_notify_free(bulkNotify);
+        }
+        return;
+    }
+
+    if (result->error != NULL) {
+        log_debug(TAG, "failed to start notify for <%s> (error %d: %s)",
+                  binc_characteristic_get_uuid(result->characteristic), result->error->code,
+                  result->error->message);
+        bulkNotify->failed++;
+    }
+
+    bulkNotify->completed++;
+    if (bulkNotify->completed == bulkNotify->total) {
+        log_debug(TAG, "started notify for %u characteristics, %u failed", bulkNotify->total, bulkNotify->failed);
+        Device *device = bulkNotify->device;
+        device->bulk_notifies = g_list_remove(device->bulk_notifies, bulkNotify);
+        if (bulkNotify->callback != NULL) {
+            bulkNotify->callback(bulkNotify->device, bulkNotify->results, bulkNotify->total, bulkNotify->failed,
+                                 bulkNotify->user_data);
+        }
+        bulk_notify_free(bulkNotify);
+        return;
+    }
+
+    bulk_notify_send_next(bulkNotify);
+}
+
+static void bulk_notify_send_next(BulkNotify *bulkNotify) {
+    while (bulkNotify->in_flight < bulkNotify->window && !g_queue_is_empty(bulkNotify->pending)) {
+        BulkNotifyCall *call = g_new0(BulkNotifyCall, 1);
+        call->bulkNotify = bulkNotify;
+        call->index = GPOINTER_TO_UINT(g_queue_pop_head(bulkNotify->pending));
+        bulkNotify->in_flight++;
+        binc_characteristic_start_notify_async(bulkNotify->results[call->index].characteristic,
+                                               (GAsyncReadyCallback) binc_internal_bulk_notify_cb,
+                                               call);
+    }
+}
+
+guint binc_device_start_notify_all(Device *device, GList *characteristics, guint window,
+                                   OnStartNotifyAllCallback callback, void *user_data) {
+    g_assert(device != NULL);
+    g_assert(device->characteristics != NULL);
+
+    GList *selected = NULL;
+    if (characteristics != NULL) {
+        for (GList *iterator = characteristics; iterator; iterator = iterator->next) {
+            Characteristic *characteristic = (Characteristic *) iterator->data;
+            g_assert(binc_characteristic_supports_notify(characteristic));
+            selected = g_list_append(selected, characteristic);
+        }
+    } else {
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, device->characteristics);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            Characteristic *characteristic = (Characteristic *) value;
+            if (binc_characteristic_supports_notify(characteristic) &&
+                !binc_characteristic_is_notifying(characteristic)) {
+                selected = g_list_append(selected, characteristic);
+            }
+        }
+    }
+
+    guint total = g_list_length(selected);
+    if (total == 0) return 0;
+
+    register_for_characteristic_signals(device);
+
+    BulkNotify *bulkNotify = g_new0(BulkNotify, 1);
+    bulkNotify->device = device;
+    bulkNotify->connection = device->connection;
+    bulkNotify->pending = g_queue_new();
+    bulkNotify->results = g_new0(NotifyResult, total);
+    bulkNotify->window = window > 0 ? window : total;
+    bulkNotify->total = total;
+    bulkNotify->callback = callback;
+    bulkNotify->user_data = user_data;
+
+    guint index = 0;
+    for (GList *iterator = selected; iterator; iterator = iterator->next) {
+        bulkNotify->results[index].characteristic = (Characteristic *) iterator->data;
+        g_queue_push_tail(bulkNotify->pending, GUINT_TO_POINTER(index));
+        index++;
+    }
+    g_list_free(selected);
+
+    device->bulk_notifies = g_list_prepend(device->bulk_notifies, bulkNotify);
+    log_debug(TAG, "starting notify for %u characteristics, %u at a time", total, bulkNotify->window);
+    bulk_notify_send_next(bulkNotify);
+    return total;
+}
+
 gboolean binc_device_stop_notify(const Device *device, const char *service_uuid, const char *characteristic_uuid) {
     g_assert(device != NULL);
     g_assert(is_valid_uuid(service_uuid));
@@ -1125,6 +1357,26 @@ guint binc_device_get_mtu(const Device *device) {
     return device->mtu;
 }
 
+guint64 binc_device_get_notification_count(const Device *device) {
+    g_assert(device != NULL);
+    return device->notification_count;
+}
+
+void binc_device_record_notification(Device *device) {
+    g_assert(device != NULL);
+    device->notification_count++;
+}
+
+guint binc_device_get_id(const Device *device) {
+    g_assert(device != NULL);
+    return device->id;
+}
+
+void binc_device_set_id(Device *device, guint id) {
+    g_assert(device != NULL);
+    device->id = id;
+}
+
 gboolean binc_device_has_service(const Device *device, const char *service_uuid) {
     g_assert(device != NULL);
     g_assert(g_uuid_string_is_valid(service_uuid));
@@ -1139,6 +1391,72 @@ gboolean binc_device_has_service(const Device *device, const char *service_uuid)
     return FALSE;
 }
 
+static GByteArray *reset_ad_section(Device *device, AdSection section) {
+    if (device->advertising[section] == NULL) {
+        device->advertising[section] = g_byte_array_new();
+    }
+
+    // Keep the allocation so updates of the same size don't allocate
+    return g_byte_array_set_size(device->advertising[section], 0);
+}
+
+static void append_ad_structure(GByteArray *section, guint8 type, const guint8 *prefix, guint prefix_length,
+                                const guint8 *data, gsize data_length) {
+    // The length of an AD structure must fit in one byte and includes the type
+    gsize length = 1 + prefix_length + data_length;
+    if (length > G_MAXUINT8) {
+        log_debug(TAG, "ignoring AD structure of type 0x%02X with length %zu", type, length);
+        return;
+    }
+
+    guint8 header[] = {(guint8) length, type};
+    g_byte_array_append(section, header, sizeof(header));
+    if (prefix_length > 0) {
+        g_byte_array_append(section, prefix, prefix_length);
+    }
+    g_byte_array_append(section, data, (guint) data_length);
+}
+
+/*
+ * Encode a UUID string like it is sent over the air in a service data AD structure. UUIDs based on the
+ * Bluetooth base UUID are shortened to 16 or 32 bits. All UUIDs are little endian.
+ */
+static gboolean encode_service_uuid(const char *uuid_string, guint8 *type, guint8 *uuid, guint *uuid_length) {
+    if (!g_uuid_string_is_valid(uuid_string)) return FALSE;
+
+    guint8 big_endian[16];
+    guint index = 0;
+    for (const char *c = uuid_string; *c != '\0'; c++) {
+        if (*c == '-') continue;
+        if (index % 2 == 0) {
+            big_endian[index / 2] = (guint8) (g_ascii_xdigit_value(*c) << 4);
+        } else {
+            big_endian[index / 2] |= (guint8) g_ascii_xdigit_value(*c);
+        }
+        index++;
+    }
+
+    if (g_ascii_strcasecmp(uuid_string + 8, BLUETOOTH_BASE_UUID_SUFFIX) == 0) {
+        if (big_endian[0] == 0 && big_endian[1] == 0) {
+            *type = AD_TYPE_SERVICE_DATA_16;
+            *uuid_length = 2;
+        } else {
+            *type = AD_TYPE_SERVICE_DATA_32;
+            *uuid_length = 4;
+        }
+        for (guint i = 0; i < *uuid_length; i++) {
+            uuid[i] = big_endian[3 - i];
+        }
+    } else {
+        *type = AD_TYPE_SERVICE_DATA_128;
+        *uuid_length = 16;
+        for (guint i = 0; i < 16; i++) {
+            uuid[i] = big_endian[15 - i];
+        }
+    }
+    return TRUE;
+}
+
 void binc_internal_device_update_property(Device *device, const char *property_name, GVariant *property_value) {
     if (g_str_equal(property_name, DEVICE_PROPERTY_ADDRESS)) {
         binc_device_set_address(device, g_variant_get_string(property_value, NULL));
@@ -1170,11 +1488,15 @@ void binc_internal_device_update_property(Device *device, const char *property_n
 
         GVariant *array;
         guint16 key;
+        GByteArray *section = reset_ad_section(device, AD_SECTION_MANUFACTURER);
         GHashTable *manufacturer_data = g_hash_table_new_full(g_int_hash, g_int_equal,
                                                               g_free, (GDestroyNotify) byte_array_free);
         while (g_variant_iter_loop(iter, "{qv}", &key, &array)) {
             gsize data_length = 0;
             guint8 *data = (guint8 *) g_variant_get_fixed_array(array, &data_length, sizeof(guint8));
+            guint8 company_id[] = {(guint8) (key & 0xFF), (guint8) (key >> 8)};
+            append_ad_structure(section, AD_TYPE_MANUFACTURER_DATA, company_id, sizeof(company_id), data, data_length);
+
             GByteArray *byteArray = g_byte_array_sized_new((guint) data_length);
             g_byte_array_append(byteArray, data, (guint) data_length);
 
@@ -1194,11 +1516,19 @@ void binc_internal_device_update_property(Device *device, const char *property_n
         GVariant *array;
         char *key;
 
+        GByteArray *section = reset_ad_section(device, AD_SECTION_SERVICE);
         GHashTable *service_data = g_hash_table_new_full(g_str_hash, g_str_equal,
                                                          g_free, (GDestroyNotify) byte_array_free);
         while (g_variant_iter_loop(iter, "{sv}", &key, &array)) {
             gsize data_length = 0;
             guint8 *data = (guint8 *) g_variant_get_fixed_array(array, &data_length, sizeof(guint8));
+            guint8 type = 0;
+            guint8 uuid[16];
+            guint uuid_length = 0;
+            if (encode_service_uuid(key, &type, uuid, &uuid_length)) {
+                append_ad_structure(section, type, uuid, uuid_length, data, data_length);
+            }
+
             GByteArray *byteArray = g_byte_array_sized_new((guint) data_length);
             g_byte_array_append(byteArray, data, (guint) data_length);
 
@@ -1208,7 +1538,116 @@ void binc_internal_device_update_property(Device *device, const char *property_n
         }
         binc_device_set_service_data(device, service_data);
         g_variant_iter_free(iter);
+    } else if (g_str_equal(property_name, DEVICE_PROPERTY_ADVERTISING_DATA)) {
+        GByteArray *section = reset_ad_section(device, AD_SECTION_DATA);
+        GVariantIter iter;
+        GVariant *array;
+        guint8 type;
+        g_variant_iter_init(&iter, property_value);
+        while (g_variant_iter_loop(&iter, "{yv}", &type, &array)) {
+            gsize data_length = 0;
+            const guint8 *data = g_variant_get_fixed_array(array, &data_length, sizeof(guint8));
+            append_ad_structure(section, type, NULL, 0, data, data_length);
+        }
+    } else if (g_str_equal(property_name, DEVICE_PROPERTY_ADVERTISING_FLAGS)) {
+        GByteArray *section = reset_ad_section(device, AD_SECTION_FLAGS);
+        gsize data_length = 0;
+        const guint8 *data = g_variant_get_fixed_array(property_value, &data_length, sizeof(guint8));
+        if (data_length > 0) {
+            append_ad_structure(section, AD_TYPE_FLAGS, NULL, 0, data, data_length);
+        }
+    }
+}
+
+void binc_device_ad_iter_init(const Device *device, AdIter *iter) {
+    g_assert(device != NULL);
+    g_assert(iter != NULL);
+
+    iter->device = device;
+    iter->section = 0;
+    iter->offset = 0;
+}
+
+gboolean binc_device_ad_iter_next(AdIter *iter, guint8 *type, const guint8 **data, guint8 *length) {
+    g_assert(iter != NULL);
+    g_assert(type != NULL);
+    g_assert(data != NULL);
+    g_assert(length != NULL);
+
+    while (iter->section < AD_SECTION_COUNT) {
+        const GByteArray *section = iter->device->advertising[iter->section];
+        if (section != NULL && iter->offset < section->len) {
+            const guint8 *structure = section->data + iter->offset;
+            *length = (guint8) (structure[0] - 1);
+            *type = structure[1];
+            *data = structure + 2;
+            iter->offset += structure[0] + 1U;
+            return TRUE;
+        }
+        iter->section++;
+        iter->offset = 0;
+    }
+    return FALSE;
+}
+
+static const guint8 *find_ad_structure(const Device *device, AdSection section_index, guint8 type,
+                                       const guint8 *prefix, guint prefix_length, guint8 *length) {
+    const GByteArray *section = device->advertising[section_index];
+    if (section == NULL) return NULL;
+
+    for (guint offset = 0; offset < section->len; offset += section->data[offset] + 1U) {
+        const guint8 *structure = section->data + offset;
+        guint data_length = structure[0] - 1U;
+        if (structure[1] == type && data_length >= prefix_length &&
+            (prefix_length == 0 || memcmp(structure + 2, prefix, prefix_length) == 0)) {
+            *length = (guint8) (data_length - prefix_length);
+            return structure + 2 + prefix_length;
+        }
+    }
+    return NULL;
+}
+
+const guint8 *binc_device_find_advertising_data(const Device *device, guint8 type, guint8 *length) {
+    g_assert(device != NULL);
+    g_assert(length != NULL);
+
+    *length = 0;
+    for (guint i = 0; i < AD_SECTION_COUNT; i++) {
+        const guint8 *data = find_ad_structure(device, i, type, NULL, 0, length);
+        if (data != NULL) return data;
     }
+    return NULL;
+}
+
+const guint8 *binc_device_find_manufacturer_data(const Device *device, guint16 company_id, guint8 *length) {
+    g_assert(device != NULL);
+    g_assert(length != NULL);
+
+    *length = 0;
+    guint8 prefix[] = {(guint8) (company_id & 0xFF), (guint8) (company_id >> 8)};
+    return find_ad_structure(device, AD_SECTION_MANUFACTURER, AD_TYPE_MANUFACTURER_DATA, prefix, sizeof(prefix),
+                             length);
+}
+
+const guint8 *binc_device_find_service_data(const Device *device, const char *service_uuid, guint8 *length) {
+    g_assert(device != NULL);
+    g_assert(service_uuid != NULL);
+    g_assert(length != NULL);
+
+    *length = 0;
+    guint8 type = 0;
+    guint8 uuid[16];
+    guint uuid_length = 0;
+    if (!encode_service_uuid(service_uuid, &type, uuid, &uuid_length)) return NULL;
+    return find_ad_structure(device, AD_SECTION_SERVICE, type, uuid, uuid_length, length);
+}
+
+guint8 binc_device_get_advertising_flags(const Device *device) {
+    g_assert(device != NULL);
+
+    guint8 length = 0;
+    const guint8 *flags = find_ad_structure(device, AD_SECTION_FLAGS, AD_TYPE_FLAGS, NULL, 0, &length);
+    return flags != NULL && length > 0 ? flags[0] : 0;
 }
 
 void binc_device_set_user_data(Device *device, void *user_data) {
@@ -47,6 +47,23 @@ typedef void (*ServicesResolvedCallback)(Device *device);
 typedef void (*BondingStateChangedCallback)(Device *device, BondingState new_state, BondingState old_state,
                                             const GError *error);
 
+/**
+ * Iterator over the AD structures a device advertises, see binc_device_ad_iter_init()
+ */
+typedef struct binc_ad_iter {
+    const Device *device;
+    guint section;
+    guint offset;
+} AdIter;
+
+typedef struct binc_notify_result {
+    Characteristic *characteristic; // Borrowed
+    GError *error; // NULL if StartNotify succeeded
+} NotifyResult;
+
+typedef void (*OnStartNotifyAllCallback)(Device *device, const NotifyResult *results, guint count, guint failed,
+                                         void *user_data);
+
 
 /**
  * Connect to a device asynchronously
@@ -76,6 +93,24 @@ void binc_device_set_notify_state_cb(Device *device, OnNotifyingStateChangedCall
 
 gboolean binc_device_start_notify(const Device *device, const char *service_uuid, const char *characteristic_uuid);
 
+/**
+ * Start notify for many characteristics at once
+ *
+ * The StartNotify calls are sent without waiting for each other and all characteristics share one signal
+ * subscription. The callback is called once when all calls have completed. Notifications are delivered to
+ * the callback set with binc_device_set_notify_char_cb().
+ *
+ * @param device the device, must have its services resolved
+ * @param characteristics the characteristics, or NULL for all characteristics that support notify and are not notifying
+ * @param window the maximum number of outstanding StartNotify calls, 0 means no limit
+ * @param callback called with a result per characteristic, the results are only valid during the callback. Not called
+ * if the services are discovered again or the device is freed before all calls have completed
+ * @param user_data passed to the callback
+ * @return the number of characteristics for which notify is started. If 0, the callback is not called
+ */
+guint binc_device_start_notify_all(Device *device, GList *characteristics, guint window,
+                                   OnStartNotifyAllCallback callback, void *user_data);
+
 gboolean binc_device_stop_notify(const Device *device, const char *service_uuid, const char *characteristic_uuid);
 
 gboolean binc_device_read_desc(const Device *device, const char *service_uuid,
@@ -131,12 +166,69 @@ GHashTable *binc_device_get_manufacturer_data(const Device *device);
 
 GHashTable *binc_device_get_service_data(const Device *device);
 
+/**
+ * Iterate over the AD structures of the device without allocating
+ *
+ * The structures are built from the ManufacturerData, ServiceData, AdvertisingData and AdvertisingFlags
+ * properties. Service data UUIDs are shortened to 16 or 32 bits when possible.
+ *
+ * @code
+ * AdIter iter;
+ * guint8 type, length;
+ * const guint8 *data;
+ * binc_device_ad_iter_init(device, &iter);
+ * while (binc_device_ad_iter_next(&iter, &type, &data, &length)) {
+ *     ...
+ * }
+ * @endcode
+ *
+ * The data is borrowed from the device and only valid until the device's advertising properties change.
+ *
+ * @param device the device
+ * @param iter the iterator to initialize
+ */
+void binc_device_ad_iter_init(const Device *device, AdIter *iter);
+
+gboolean binc_device_ad_iter_next(AdIter *iter, guint8 *type, const guint8 **data, guint8 *length);
+
+/**
+ * Get the first AD structure of a type, e.g. 0x09 for the complete local name
+ *
+ * @param device the device
+ * @param type the AD type from the Bluetooth assigned numbers
+ * @param length the length of the returned data
+ * @return borrowed data that is valid until the advertising properties change, or NULL if not advertised
+ */
+const guint8 *binc_device_find_advertising_data(const Device *device, guint8 type, guint8 *length);
+
+// Like binc_device_find_advertising_data() but without the company id in front of the data
+const guint8 *binc_device_find_manufacturer_data(const Device *device, guint16 company_id, guint8 *length);
+
+// Like binc_device_find_advertising_data() but without the UUID in front of the data
+const guint8 *binc_device_find_service_data(const Device *device, const char *service_uuid, guint8 *length);
+
+guint8 binc_device_get_advertising_flags(const Device *device);
+
+/**
+ * Get the small integer id of the device
+ *
+ * The id is stable for as long as the device is cached by its adapter and can be used to index the arrays
+ * returned by binc_adapter_get_scan_state(). Ids of removed devices are reused.
+ *
+ * @param device the device
+ * @return the id, or 0 if the device is not cached by an adapter
+ */
+guint binc_device_get_id(const Device *device);
+
 BondingState binc_device_get_bonding_state(const Device *device);
 
 Adapter *binc_device_get_adapter(const Device *device);
 
 guint binc_device_get_mtu(const Device *device);
 
+// Returns the number of notifications received from the device, including those delivered to a stream channel
+guint64 binc_device_get_notification_count(const Device *device);
+
 gboolean binc_device_is_central(const Device *device);
 
 char *binc_device_to_string(const Device *device);
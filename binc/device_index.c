@@ -0,0 +1,327 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "device_index.h"
+#include "device.h"
+
+/*
+ * Secondary indexes on top of the adapter's devices cache. Every index maps a key onto a set of devices.
+ * The keys a device was filed under are remembered per device so they can be dropped again when
+ * the device changes or disappears, which keeps every update proportional to the change itself.
+ */
+
+#define RSSI_MIN (-128)
+#define RSSI_MAX 20
+#define RSSI_BUCKET_WIDTH 8
+#define RSSI_UNKNOWN_BUCKET 0
+#define RSSI_BUCKET_COUNT (2 + (RSSI_MAX - RSSI_MIN) / RSSI_BUCKET_WIDTH)
+
+typedef struct binc_device_index_entry {
+    guint rssi_bucket;
+    GArray *company_ids; // Owned
+    GPtrArray *uuids; // Owned
+} DeviceIndexEntry;
+
+struct binc_device_index {
+    GHashTable *entries; // Owned, Device -> DeviceIndexEntry
+    GHashTable *company_ids; // Owned, company id -> set of Device
+    GHashTable *services; // Owned, service uuid -> set of Device
+    GHashTable *rssi_buckets[RSSI_BUCKET_COUNT]; // Owned, sets of Device
+};
+
+static guint rssi_to_bucket(short rssi) {
+    if (rssi < RSSI_MIN) return RSSI_UNKNOWN_BUCKET;
+    if (rssi > RSSI_MAX) rssi = RSSI_MAX;
+    return 1 + (guint) (rssi - RSSI_MIN) / RSSI_BUCKET_WIDTH;
+}
+
+static void device_index_entry_free(DeviceIndexEntry *entry) {
+    g_assert(entry != NULL);
+
+    g_array_free(entry->company_ids, TRUE);
+    entry->company_ids = NULL;
+    g_ptr_array_free(entry->uuids, TRUE);
+    entry->uuids = NULL;
+    g_free(entry);
+}
+
+DeviceIndex *binc_device_index_create(void) {
+    DeviceIndex *index = g_new0(DeviceIndex, 1);
+    index->entries = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                           NULL, (GDestroyNotify) device_index_entry_free);
+    index->company_ids = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                               NULL, (GDestroyNotify) g_hash_table_destroy);
+    index->services = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            g_free, (GDestroyNotify) g_hash_table_destroy);
+    for (guint i = 0; i < RSSI_BUCKET_COUNT; i++) {
+        index->rssi_buckets[i] = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    return index;
+}
+
+void binc_device_index_free(DeviceIndex *index) {
+    g_assert(index != NULL);
+
+    g_hash_table_destroy(index->entries);
+    index->entries = NULL;
+    g_hash_table_destroy(index->company_ids);
+    index->company_ids = NULL;
+    g_hash_table_destroy(index->services);
+    index->services = NULL;
+    for (guint i = 0; i < RSSI_BUCKET_COUNT; i++) {
+        g_hash_table_destroy(index->rssi_buckets[i]);
+        index->rssi_buckets[i] = NULL;
+    }
+    g_free(index);
+}
+
+static void keyed_set_add(GHashTable *table, gpointer key, gboolean copy_key, Device *device) {
+    GHashTable *set = g_hash_table_lookup(table, key);
+    if (set == NULL) {
+        set = g_hash_table_new(g_direct_hash, g_direct_equal);
+        g_hash_table_insert(table, copy_key ? g_strdup(key) : key, set);
+    }
+    g_hash_table_add(set, device);
+}
+
+static void keyed_set_remove(GHashTable *table, gconstpointer key, Device *device) {
+    GHashTable *set = g_hash_table_lookup(table, key);
+    if (set == NULL) return;
+
+    g_hash_table_remove(set, device);
+    if (g_hash_table_size(set) == 0) {
+        g_hash_table_remove(table, key);
+    }
+}
+
+static DeviceIndexEntry *get_entry(DeviceIndex *index, Device *device) {
+    DeviceIndexEntry *entry = g_hash_table_lookup(index->entries, device);
+    if (entry == NULL) {
+        entry = g_new0(DeviceIndexEntry, 1);
+        entry->rssi_bucket = RSSI_UNKNOWN_BUCKET;
+        entry->company_ids = g_array_new(FALSE, FALSE, sizeof(guint16));
+        entry->uuids = g_ptr_array_new_with_free_func(g_free);
+        g_hash_table_insert(index->entries, device, entry);
+        g_hash_table_add(index->rssi_buckets[RSSI_UNKNOWN_BUCKET], device);
+    }
+    return entry;
+}
+
+void binc_device_index_update_rssi(DeviceIndex *index, Device *device) {
+    g_assert(index != NULL);
+    g_assert(device != NULL);
+
+    DeviceIndexEntry *entry = get_entry(index, device);
+    guint bucket = rssi_to_bucket(binc_device_get_rssi(device));
+    if (bucket == entry->rssi_bucket) return;
+
+    g_hash_table_remove(index->rssi_buckets[entry->rssi_bucket], device);
+    g_hash_table_add(index->rssi_buckets[bucket], device);
+    entry->rssi_bucket = bucket;
+}
+
+static gboolean company_ids_unchanged(const DeviceIndexEntry *entry, GHashTable *manufacturer_data) {
+    guint count = manufacturer_data != NULL ? g_hash_table_size(manufacturer_data) : 0;
+    if (count != entry->company_ids->len) return FALSE;
+    if (count == 0) return TRUE;
+
+    GHashTableIter iter;
+    gpointer key = NULL;
+    g_hash_table_iter_init(&iter, manufacturer_data);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        gboolean found = FALSE;
+        for (guint i = 0; i < entry->company_ids->len && !found; i++) {
+            found = g_array_index(entry->company_ids, guint16, i) == *(int *) key;
+        }
+        if (!found) return FALSE;
+    }
+    return TRUE;
+}
+
+void binc_device_index_update_manufacturer_data(DeviceIndex *index, Device *device) {
+    g_assert(index != NULL);
+    g_assert(device != NULL);
+
+    // Manufacturer data is updated with every advertisement but the company ids hardly ever change
+    DeviceIndexEntry *entry = get_entry(index, device);
+    GHashTable *manufacturer_data = binc_device_get_manufacturer_data(device);
+    if (company_ids_unchanged(entry, manufacturer_data)) return;
+
+    for (guint i = 0; i < entry->company_ids->len; i++) {
+        guint16 company_id = g_array_index(entry->company_ids, guint16, i);
+        keyed_set_remove(index->company_ids, GUINT_TO_POINTER(company_id), device);
+    }
+    g_array_set_size(entry->company_ids, 0);
+
+    if (manufacturer_data == NULL) return;
+
+    GHashTableIter iter;
+    gpointer key = NULL;
+    g_hash_table_iter_init(&iter, manufacturer_data);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        guint16 company_id = (guint16) *(int *) key;
+        g_array_append_val(entry->company_ids, company_id);
+        keyed_set_add(index->company_ids, GUINT_TO_POINTER(company_id), FALSE, device);
+    }
+}
+
+static gboolean uuids_unchanged(const DeviceIndexEntry *entry, GList *uuids) {
+    if (g_list_length(uuids) != entry->uuids->len) return FALSE;
+
+    guint i = 0;
+    for (GList *iterator = uuids; iterator; iterator = iterator->next, i++) {
+        if (!g_str_equal(iterator->data, g_ptr_array_index(entry->uuids, i))) return FALSE;
+    }
+    return TRUE;
+}
+
+void binc_device_index_update_services(DeviceIndex *index, Device *device) {
+    g_assert(index != NULL);
+    g_assert(device != NULL);
+
+    DeviceIndexEntry *entry = get_entry(index, device);
+    GList *uuids = binc_device_get_uuids(device);
+    if (uuids_unchanged(entry, uuids)) return;
+
+    for (guint i = 0; i < entry->uuids->len; i++) {
+        keyed_set_remove(index->services, g_ptr_array_index(entry->uuids, i), device);
+    }
+    g_ptr_array_set_size(entry->uuids, 0);
+
+    for (GList *iterator = uuids; iterator; iterator = iterator->next) {
+        char *uuid = (char *) iterator->data;
+        g_ptr_array_add(entry->uuids, g_strdup(uuid));
+        keyed_set_add(index->services, uuid, TRUE, device);
+    }
+}
+
+void binc_device_index_update_all(DeviceIndex *index, Device *device) {
+    binc_device_index_update_rssi(index, device);
+    binc_device_index_update_manufacturer_data(index, device);
+    binc_device_index_update_services(index, device);
+}
+
+void binc_device_index_remove(DeviceIndex *index, Device *device) {
+    g_assert(index != NULL);
+    g_assert(device != NULL);
+
+    DeviceIndexEntry *entry = g_hash_table_lookup(index->entries, device);
+    if (entry == NULL) return;
+
+    g_hash_table_remove(index->rssi_buckets[entry->rssi_bucket], device);
+    for (guint i = 0; i < entry->company_ids->len; i++) {
+        guint16 company_id = g_array_index(entry->company_ids, guint16, i);
+        keyed_set_remove(index->company_ids, GUINT_TO_POINTER(company_id), device);
+    }
+    for (guint i = 0; i < entry->uuids->len; i++) {
+        keyed_set_remove(index->services, g_ptr_array_index(entry->uuids, i), device);
+    }
+    g_hash_table_remove(index->entries, device);
+}
+
+static GList *collect_devices(GHashTable *set, short min_rssi, GHashTable *also_in, GList *result) {
+    GHashTableIter iter;
+    gpointer key = NULL;
+    g_hash_table_iter_init(&iter, set);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        Device *device = (Device *) key;
+        if (binc_device_get_rssi(device) < min_rssi) continue;
+        if (also_in != NULL && !g_hash_table_contains(also_in, device)) continue;
+        result = g_list_prepend(result, device);
+    }
+    return result;
+}
+
+static GList *find_in_keyed_set(const DeviceIndex *index, GHashTable *set, short min_rssi) {
+    if (set == NULL) return NULL;
+
+    // Walk whichever candidate set is smaller: the keyed set or the RSSI buckets above the threshold
+    guint rssi_candidates = 0;
+    for (guint bucket = rssi_to_bucket(min_rssi); bucket < RSSI_BUCKET_COUNT; bucket++) {
+        rssi_candidates += g_hash_table_size(index->rssi_buckets[bucket]);
+    }
+
+    if (rssi_candidates >= g_hash_table_size(set)) {
+        return collect_devices(set, min_rssi, NULL, NULL);
+    }
+
+    GList *result = NULL;
+    for (guint bucket = rssi_to_bucket(min_rssi); bucket < RSSI_BUCKET_COUNT; bucket++) {
+        result = collect_devices(index->rssi_buckets[bucket], min_rssi, set, result);
+    }
+    return result;
+}
+
+GList *binc_device_index_find_by_manufacturer(const DeviceIndex *index, guint16 company_id, short min_rssi) {
+    g_assert(index != NULL);
+
+    GHashTable *set = g_hash_table_lookup(index->company_ids, GUINT_TO_POINTER(company_id));
+    return find_in_keyed_set(index, set, min_rssi);
+}
+
+GList *binc_device_index_find_by_service(const DeviceIndex *index, const char *service_uuid, short min_rssi) {
+    g_assert(index != NULL);
+    g_assert(service_uuid != NULL);
+
+    GHashTable *set = g_hash_table_lookup(index->services, service_uuid);
+    return find_in_keyed_set(index, set, min_rssi);
+}
+
+GList *binc_device_index_find_by_rssi(const DeviceIndex *index, short min_rssi) {
+    g_assert(index != NULL);
+
+    GList *result = NULL;
+    for (guint bucket = rssi_to_bucket(min_rssi); bucket < RSSI_BUCKET_COUNT; bucket++) {
+        result = collect_devices(index->rssi_buckets[bucket], min_rssi, NULL, result);
+    }
+    return result;
+}
+
+static gint compare_rssi_descending(gconstpointer a, gconstpointer b) {
+    return binc_device_get_rssi((const Device *) b) - binc_device_get_rssi((const Device *) a);
+}
+
+GList *binc_device_index_get_strongest(const DeviceIndex *index, guint count) {
+    g_assert(index != NULL);
+
+    // Only the strongest buckets needed to reach 'count' devices are visited and sorted
+    GList *result = NULL;
+    guint collected = 0;
+    for (guint bucket = RSSI_BUCKET_COUNT - 1; bucket > RSSI_UNKNOWN_BUCKET && collected < count; bucket--) {
+        result = collect_devices(index->rssi_buckets[bucket], RSSI_MIN, NULL, result);
+        collected += g_hash_table_size(index->rssi_buckets[bucket]);
+    }
+
+    result = g_list_sort(result, compare_rssi_descending);
+    GList *surplus = g_list_nth(result, count);
+    if (surplus != NULL) {
+        if (surplus->prev != NULL) {
+            surplus->prev->next = NULL;
+        } else {
+            result = NULL;
+        }
+        surplus->prev = NULL;
+        g_list_free(surplus);
+    }
+    return result;
+}
@@ -0,0 +1,54 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_DEVICE_INDEX_H
+#define BINC_DEVICE_INDEX_H
+
+#include <glib.h>
+#include "forward_decl.h"
+
+typedef struct binc_device_index DeviceIndex;
+
+DeviceIndex *binc_device_index_create(void);
+
+void binc_device_index_free(DeviceIndex *index);
+
+void binc_device_index_update_rssi(DeviceIndex *index, Device *device);
+
+void binc_device_index_update_manufacturer_data(DeviceIndex *index, Device *device);
+
+void binc_device_index_update_services(DeviceIndex *index, Device *device);
+
+void binc_device_index_update_all(DeviceIndex *index, Device *device);
+
+void binc_device_index_remove(DeviceIndex *index, Device *device);
+
+GList *binc_device_index_find_by_manufacturer(const DeviceIndex *index, guint16 company_id, short min_rssi);
+
+GList *binc_device_index_find_by_service(const DeviceIndex *index, const char *service_uuid, short min_rssi);
+
+GList *binc_device_index_find_by_rssi(const DeviceIndex *index, short min_rssi);
+
+GList *binc_device_index_get_strongest(const DeviceIndex *index, guint count);
+
+#endif //BINC_DEVICE_INDEX_H
@@ -62,6 +62,12 @@ void binc_device_set_bonding_state(Device *device, BondingState bonding_state);
 
 void binc_device_set_is_central(Device *device, gboolean is_central);
 
+void binc_device_set_id(Device *device, guint id);
+
+void binc_device_record_notification(Device *device);
+
+void binc_device_handle_characteristic_changed(Device *device, const char *path, GVariant *parameters);
+
 void binc_internal_device_update_property(Device *device, const char *property_name, GVariant *property_value);
 
 #endif //BINC_DEVICE_INTERNAL_H
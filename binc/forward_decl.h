@@ -37,6 +37,12 @@ typedef struct binc_descriptor Descriptor;
 typedef struct binc_service_handler_manager ServiceHandlerManager;
 typedef struct binc_advertisement Advertisement;
 typedef struct binc_application Application;
+typedef struct binc_discovery_session DiscoverySession;
+typedef struct local_characteristic LocalCharacteristic;
+typedef struct binc_stream_channel StreamChannel;
+typedef struct binc_local_stream LocalStream;
+typedef struct binc_smp_upload SmpUpload;
+typedef struct binc_admin_socket AdminSocket;
 
 #ifdef __cplusplus
 }
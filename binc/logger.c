@@ -33,6 +33,15 @@
 #define MAX_FILE_SIZE (1024 * 64)
 #define MAX_LOGS 5
 
+// A call site is identified by its file and line, or by its format string if the file is unknown
+typedef struct log_call_site {
+    const void *key;
+    int line;
+    gint64 tokens; // In micro tokens, so we don't need floating point
+    gint64 last_refill;
+    guint suppressed;
+} LogCallSite;
+
 static struct {
     gboolean enabled;
     LogLevel level;
@@ -42,7 +51,11 @@ static struct {
     unsigned int maxFiles;
     size_t currentSize;
     LogEventCallback logCallback;
-} LogSettings = {TRUE, LOG_DEBUG, NULL, "", MAX_FILE_SIZE, MAX_LOGS, 0, NULL};
+    LogStructuredEventCallback structuredCallback;
+    unsigned int rateLimitBurst;
+    unsigned int rateLimitPerSecond;
+    GHashTable *callSites;
+} LogSettings = {TRUE, LOG_DEBUG, NULL, "", MAX_FILE_SIZE, MAX_LOGS, 0, NULL, NULL, 0, 0, NULL};
 
 static const char *log_level_names[] = {
         [LOG_DEBUG] = "DEBUG",
@@ -63,6 +76,66 @@ void log_set_handler(LogEventCallback callback) {
     LogSettings.logCallback = callback;
 }
 
+void log_set_structured_handler(LogStructuredEventCallback callback) {
+    LogSettings.structuredCallback = callback;
+}
+
+static guint call_site_hash(gconstpointer key) {
+    const LogCallSite *site = key;
+    return g_direct_hash(site->key) ^ (guint) site->line;
+}
+
+static gboolean call_site_equal(gconstpointer a, gconstpointer b) {
+    const LogCallSite *site_a = a;
+    const LogCallSite *site_b = b;
+    return site_a->key == site_b->key && site_a->line == site_b->line;
+}
+
+void log_set_rate_limit(unsigned int burst, unsigned int per_second) {
+    LogSettings.rateLimitBurst = burst;
+    LogSettings.rateLimitPerSecond = per_second;
+
+    if (LogSettings.callSites != NULL) {
+        g_hash_table_destroy(LogSettings.callSites);
+        LogSettings.callSites = NULL;
+    }
+
+    if (per_second > 0) {
+        LogSettings.callSites = g_hash_table_new_full(call_site_hash, call_site_equal, g_free, NULL);
+    }
+}
+
+/**
+ * Take a token from the call site's bucket
+ * @return the call site if the message may be logged, or NULL if it must be suppressed
+ */
+static LogCallSite *rate_limit_take(const char *file, int line, const char *format) {
+    LogCallSite lookup = {.key = file != NULL ? (const void *) file : (const void *) format, .line = line};
+    LogCallSite *site = g_hash_table_lookup(LogSettings.callSites, &lookup);
+    gint64 now = g_get_monotonic_time();
+    gint64 capacity = (gint64) MAX(LogSettings.rateLimitBurst, 1) * G_USEC_PER_SEC;
+
+    if (site == NULL) {
+        site = g_new0(LogCallSite, 1);
+        site->key = lookup.key;
+        site->line = line;
+        site->tokens = capacity;
+        site->last_refill = now;
+        g_hash_table_add(LogSettings.callSites, site);
+    }
+
+    // Refill the bucket at the configured rate, up to the burst size
+    site->tokens = MIN(capacity, site->tokens + (now - site->last_refill) * LogSettings.rateLimitPerSecond);
+    site->last_refill = now;
+
+    if (site->tokens < G_USEC_PER_SEC) {
+        site->suppressed++;
+        return NULL;
+    }
+    site->tokens -= G_USEC_PER_SEC;
+    return site;
+}
+
 void log_enabled(gboolean enabled) {
     LogSettings.enabled = enabled;
 }
@@ -184,7 +257,14 @@ static void rotate_log_file_if_needed(void) {
     open_log_file();
 }
 
-void log_log_at_level(LogLevel level, const char *tag, const char *format, ...) {
+static void log_dispatch(LogLevel level, const char *tag, const char *file, int line, const char *function,
+                         const char *format, va_list arg) {
+    // Structured handlers get the arguments as they are, without formatting them first
+    if (LogSettings.structuredCallback) {
+        LogSettings.structuredCallback(level, tag, file, line, function, format, arg);
+        return;
+    }
+
     // Init fout to stdout if needed
     if (LogSettings.fout == NULL && LogSettings.logCallback == NULL) {
         LogSettings.fout = stdout;
@@ -192,17 +272,57 @@ void log_log_at_level(LogLevel level, const char *tag, const char *format, ...)
 
     rotate_log_file_if_needed();
 
-    if (LogSettings.level <= level && LogSettings.enabled) {
-        char buf[BUFFER_SIZE];
-        va_list arg;
-        va_start(arg, format);
-        g_vsnprintf(buf, BUFFER_SIZE, format, arg);
-        if (LogSettings.logCallback) {
-            LogSettings.logCallback(level, tag, buf);
-        } else {
-            log_log(tag, log_level_names[level], buf);
+    char buf[BUFFER_SIZE];
+    g_vsnprintf(buf, BUFFER_SIZE, format, arg);
+    if (LogSettings.logCallback) {
+        LogSettings.logCallback(level, tag, buf);
+    } else {
+        log_log(tag, log_level_names[level], buf);
+    }
+}
+
+static void log_dispatchf(LogLevel level, const char *tag, const char *file, int line, const char *function,
+                          const char *format, ...) G_GNUC_PRINTF(6, 7);
+
+static void log_dispatchf(LogLevel level, const char *tag, const char *file, int line, const char *function,
+                          const char *format, ...) {
+    va_list arg;
+    va_start(arg, format);
+    log_dispatch(level, tag, file, line, function, format, arg);
+    va_end(arg);
+}
+
+static void log_logv(LogLevel level, const char *tag, const char *file, int line, const char *function,
+                     const char *format, va_list arg) {
+    if (LogSettings.level > level || !LogSettings.enabled) return;
+
+    if (LogSettings.callSites != NULL) {
+        LogCallSite *site = rate_limit_take(file, line, format);
+        if (site == NULL) return;
+
+        // Report what we dropped once the call site is allowed to log again
+        if (site->suppressed > 0) {
+            log_dispatchf(level, tag, file, line, function, "suppressed %u messages like '%s'",
+                          site->suppressed, format);
+            site->suppressed = 0;
         }
-        va_end(arg);
     }
+
+    log_dispatch(level, tag, file, line, function, format, arg);
+}
+
+void log_log_at_site(LogLevel level, const char *tag, const char *file, int line, const char *function,
+                     const char *format, ...) {
+    va_list arg;
+    va_start(arg, format);
+    log_logv(level, tag, file, line, function, format, arg);
+    va_end(arg);
+}
+
+void log_log_at_level(LogLevel level, const char *tag, const char *format, ...) {
+    va_list arg;
+    va_start(arg, format);
+    log_logv(level, tag, NULL, 0, NULL, format, arg);
+    va_end(arg);
 }
 
@@ -25,6 +25,7 @@
 #define BINC_LOGGER_H
 
 #include <glib.h>
+#include <stdarg.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,13 +35,16 @@ typedef enum LogLevel {
     LOG_DEBUG = 0, LOG_INFO = 1, LOG_WARN = 2, LOG_ERROR = 3
 } LogLevel;
 
-#define log_debug(tag, format, ...) log_log_at_level(LOG_DEBUG, tag, format, ##__VA_ARGS__)
-#define log_info(tag, format, ...)  log_log_at_level(LOG_INFO, tag, format, ##__VA_ARGS__)
-#define log_warn(tag, format, ...)  log_log_at_level(LOG_WARN, tag, format,  ##__VA_ARGS__)
-#define log_error(tag, format, ...) log_log_at_level(LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define log_debug(tag, format, ...) log_log_at_site(LOG_DEBUG, tag, __FILE__, __LINE__, G_STRFUNC, format, ##__VA_ARGS__)
+#define log_info(tag, format, ...)  log_log_at_site(LOG_INFO, tag, __FILE__, __LINE__, G_STRFUNC, format, ##__VA_ARGS__)
+#define log_warn(tag, format, ...)  log_log_at_site(LOG_WARN, tag, __FILE__, __LINE__, G_STRFUNC, format,  ##__VA_ARGS__)
+#define log_error(tag, format, ...) log_log_at_site(LOG_ERROR, tag, __FILE__, __LINE__, G_STRFUNC, format, ##__VA_ARGS__)
 
 void log_log_at_level(LogLevel level, const char* tag, const char *format, ...);
 
+void log_log_at_site(LogLevel level, const char *tag, const char *file, int line, const char *function,
+                     const char *format, ...) G_GNUC_PRINTF(6, 7);
+
 void log_set_level(LogLevel level);
 
 LogLevel log_get_level(void);
@@ -51,6 +55,32 @@ typedef void (*LogEventCallback)(LogLevel level, const char *tag, const char *me
 
 void log_set_handler(LogEventCallback callback);
 
+/**
+ * Callback receiving log events before they are formatted.
+ *
+ * The arguments are only valid during the callback. Use G_VA_COPY if you need to format them more than once.
+ */
+typedef void (*LogStructuredEventCallback)(LogLevel level, const char *tag, const char *file, int line,
+                                           const char *function, const char *format, va_list args);
+
+/**
+ * Set a handler that receives the call site and the unformatted message, so it can filter or serialize
+ * the event without formatting it first. Takes precedence over log_set_handler().
+ */
+void log_set_structured_handler(LogStructuredEventCallback callback);
+
+/**
+ * Limit how often each log statement can log, to protect against a misbehaving device flooding the log.
+ *
+ * Every call site gets a token bucket that holds up to 'burst' messages and refills at 'per_second' messages
+ * per second. Messages beyond that are dropped and reported as 'suppressed N messages' once the call site
+ * logs again.
+ *
+ * @param burst the number of messages a call site can log at once
+ * @param per_second the sustained number of messages per second for a call site, or 0 to disable rate limiting
+ */
+void log_set_rate_limit(unsigned int burst, unsigned int per_second);
+
 void log_enabled(gboolean enabled);
 
 #ifdef __cplusplus
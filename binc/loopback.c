@@ -0,0 +1,342 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "loopback.h"
+#include "dbus_transport.h"
+#include "logger.h"
+
+static const char *const TAG = "Loopback";
+
+static const char *const BLUEZ_DBUS = "org.bluez";
+static const char *const INTERFACE_ADAPTER = "org.bluez.Adapter1";
+static const char *const INTERFACE_DEVICE = "org.bluez.Device1";
+static const char *const INTERFACE_CHARACTERISTIC = "org.bluez.GattCharacteristic1";
+static const char *const INTERFACE_OBJECT_MANAGER = "org.freedesktop.DBus.ObjectManager";
+static const char *const INTERFACE_PROPERTIES = "org.freedesktop.DBus.Properties";
+
+typedef struct loopback_subscription {
+    char *interface_name;
+    char *member;
+    char *object_path;
+    char *arg0;
+    GDBusSignalCallback callback;
+    gpointer user_data;
+    GDestroyNotify user_data_free_func;
+} LoopbackSubscription;
+
+static struct {
+    GHashTable *subscriptions; // Owned
+    GHashTable *replies; // Owned
+    GHashTable *adapters; // Owned
+    guint next_id;
+    guint64 call_count;
+} Loopback;
+
+// The library never looks inside the connection, it only has to be a unique non-NULL pointer
+static gint loopback_connection;
+
+static void loopback_subscription_free(LoopbackSubscription *subscription) {
+    g_assert(subscription != NULL);
+
+    if (subscription->user_data_free_func != NULL) {
+        subscription->user_data_free_func(subscription->user_data);
+    }
+    g_free(subscription->interface_name);
+    g_free(subscription->member);
+    g_free(subscription->object_path);
+    g_free(subscription->arg0);
+    g_free(subscription);
+}
+
+static void consume_parameters(GVariant *parameters) {
+    // Like GDBus, take ownership of floating parameters
+    if (parameters != NULL) {
+        g_variant_unref(g_variant_ref_sink(parameters));
+    }
+}
+
+static GVariant *get_managed_objects(void) {
+    GVariantBuilder *objects_builder = g_variant_builder_new(G_VARIANT_TYPE("a{oa{sa{sv}}}"));
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, Loopback.adapters);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GVariantBuilder *properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+        g_variant_builder_add(properties_builder, "{sv}", "Address", g_variant_new_string((const char *) value));
+        g_variant_builder_add(properties_builder, "{sv}", "Powered", g_variant_new_boolean(TRUE));
+
+        GVariantBuilder *interfaces_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sa{sv}}"));
+        g_variant_builder_add(interfaces_builder, "{sa{sv}}", INTERFACE_ADAPTER, properties_builder);
+        g_variant_builder_add(objects_builder, "{oa{sa{sv}}}", (const char *) key, interfaces_builder);
+        g_variant_builder_unref(interfaces_builder);
+        g_variant_builder_unref(properties_builder);
+    }
+    GVariant *result = g_variant_new("(a{oa{sa{sv}}})", objects_builder);
+    g_variant_builder_unref(objects_builder);
+    return g_variant_ref_sink(result);
+}
+
+static GVariant *get_reply(const gchar *interface_name, const gchar *method_name, GVariant *parameters) {
+    Loopback.call_count++;
+    consume_parameters(parameters);
+
+    char *key = g_strdup_printf("%s.%s", interface_name, method_name);
+    GVariant *reply = g_hash_table_lookup(Loopback.replies, key);
+    g_free(key);
+    if (reply != NULL) {
+        return g_variant_ref(reply);
+    }
+
+    if (g_str_equal(interface_name, INTERFACE_OBJECT_MANAGER) && g_str_equal(method_name, "GetManagedObjects")) {
+        return get_managed_objects();
+    }
+    return g_variant_ref_sink(g_variant_new("()"));
+}
+
+static void loopback_call(GDBusConnection *connection, const gchar *bus_name, const gchar *object_path,
+                          const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                          const GVariantType *reply_type, GDBusCallFlags flags, gint timeout_msec,
+                          GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data) {
+    // The task completes from the main loop, so the reply stays asynchronous like a real one
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_return_pointer(task, get_reply(interface_name, method_name, parameters),
+                          (GDestroyNotify) g_variant_unref);
+    g_object_unref(task);
+}
+
+static GVariant *loopback_call_finish(GDBusConnection *connection, GAsyncResult *res, GError **error) {
+    return g_task_propagate_pointer((GTask *) res, error);
+}
+
+static GVariant *loopback_call_sync(GDBusConnection *connection, const gchar *bus_name, const gchar *object_path,
+                                    const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                                    const GVariantType *reply_type, GDBusCallFlags flags, gint timeout_msec,
+                                    GCancellable *cancellable, GError **error) {
+    return get_reply(interface_name, method_name, parameters);
+}
+
+static guint loopback_signal_subscribe(GDBusConnection *connection, const gchar *sender,
+                                       const gchar *interface_name, const gchar *member, const gchar *object_path,
+                                       const gchar *arg0, GDBusSignalFlags flags, GDBusSignalCallback callback,
+                                       gpointer user_data, GDestroyNotify user_data_free_func) {
+    LoopbackSubscription *subscription = g_new0(LoopbackSubscription, 1);
+    subscription->interface_name = g_strdup(interface_name);
+    subscription->member = g_strdup(member);
+    subscription->object_path = g_strdup(object_path);
+    subscription->arg0 = g_strdup(arg0);
+    subscription->callback = callback;
+    subscription->user_data = user_data;
+    subscription->user_data_free_func = user_data_free_func;
+
+    guint id = ++Loopback.next_id;
+    g_hash_table_insert(Loopback.subscriptions, GUINT_TO_POINTER(id), subscription);
+    return id;
+}
+
+static void loopback_signal_unsubscribe(GDBusConnection *connection, guint subscription_id) {
+    g_hash_table_remove(Loopback.subscriptions, GUINT_TO_POINTER(subscription_id));
+}
+
+static guint loopback_register_object(GDBusConnection *connection, const gchar *object_path,
+                                      GDBusInterfaceInfo *interface_info, const GDBusInterfaceVTable *vtable,
+                                      gpointer user_data, GDestroyNotify user_data_free_func, GError **error) {
+    return ++Loopback.next_id;
+}
+
+static gboolean loopback_unregister_object(GDBusConnection *connection, guint registration_id) {
+    return TRUE;
+}
+
+static gboolean loopback_emit_signal(GDBusConnection *connection, const gchar *destination_bus_name,
+                                     const gchar *object_path, const gchar *interface_name,
+                                     const gchar *signal_name, GVariant *parameters, GError **error) {
+    consume_parameters(parameters);
+    return TRUE;
+}
+
+static const DBusTransport loopback_transport = {
+        .name = "loopback",
+        .call = loopback_call,
+        .call_finish = loopback_call_finish,
+        .call_sync = loopback_call_sync,
+        .signal_subscribe = loopback_signal_subscribe,
+        .signal_unsubscribe = loopback_signal_unsubscribe,
+        .register_object = loopback_register_object,
+        .unregister_object = loopback_unregister_object,
+        .emit_signal = loopback_emit_signal,
+};
+
+GDBusConnection *binc_loopback_enable(void) {
+    if (Loopback.subscriptions == NULL) {
+        Loopback.subscriptions = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                                       (GDestroyNotify) loopback_subscription_free);
+        Loopback.replies = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify) g_variant_unref);
+        Loopback.adapters = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    }
+
+    binc_dbus_transport_set(&loopback_transport);
+    log_debug(TAG, "loopback transport enabled");
+    return (GDBusConnection *) &loopback_connection;
+}
+
+void binc_loopback_disable(void) {
+    binc_dbus_transport_set(NULL);
+
+    if (Loopback.subscriptions != NULL) {
+        g_hash_table_destroy(Loopback.subscriptions);
+        Loopback.subscriptions = NULL;
+    }
+
+    if (Loopback.replies != NULL) {
+        g_hash_table_destroy(Loopback.replies);
+        Loopback.replies = NULL;
+    }
+
+    if (Loopback.adapters != NULL) {
+        g_hash_table_destroy(Loopback.adapters);
+        Loopback.adapters = NULL;
+    }
+    Loopback.call_count = 0;
+}
+
+void binc_loopback_add_adapter(const char *adapter_path, const char *address) {
+    g_assert(Loopback.adapters != NULL);
+    g_assert(adapter_path != NULL);
+    g_assert(address != NULL);
+
+    g_hash_table_insert(Loopback.adapters, g_strdup(adapter_path), g_strdup(address));
+}
+
+void binc_loopback_set_reply(const char *interface_name, const char *method_name, GVariant *reply) {
+    g_assert(Loopback.replies != NULL);
+    g_assert(interface_name != NULL);
+    g_assert(method_name != NULL);
+    g_assert(reply != NULL);
+
+    g_hash_table_insert(Loopback.replies, g_strdup_printf("%s.%s", interface_name, method_name),
+                        g_variant_ref_sink(reply));
+}
+
+static gboolean matches_subscription(const LoopbackSubscription *subscription, const char *object_path,
+                                     const char *interface_name, const char *signal_name, const char *arg0) {
+    return (subscription->interface_name == NULL || g_str_equal(subscription->interface_name, interface_name)) &&
+           (subscription->member == NULL || g_str_equal(subscription->member, signal_name)) &&
+           (subscription->object_path == NULL || g_str_equal(subscription->object_path, object_path)) &&
+           (subscription->arg0 == NULL || g_strcmp0(subscription->arg0, arg0) == 0);
+}
+
+void binc_loopback_emit_signal(const char *object_path, const char *interface_name, const char *signal_name,
+                               GVariant *parameters) {
+    g_assert(Loopback.subscriptions != NULL);
+    g_assert(object_path != NULL);
+    g_assert(interface_name != NULL);
+    g_assert(signal_name != NULL);
+    g_assert(parameters != NULL);
+
+    g_variant_ref_sink(parameters);
+
+    const char *arg0 = NULL;
+    GVariant *first = NULL;
+    if (g_variant_n_children(parameters) > 0) {
+        first = g_variant_get_child_value(parameters, 0);
+        if (g_variant_is_of_type(first, G_VARIANT_TYPE_STRING) ||
+            g_variant_is_of_type(first, G_VARIANT_TYPE_OBJECT_PATH)) {
+            arg0 = g_variant_get_string(first, NULL);
+        }
+    }
+
+    // Collect the matches first since handlers may subscribe or unsubscribe
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(guint));
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, Loopback.subscriptions);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        if (matches_subscription(value, object_path, interface_name, signal_name, arg0)) {
+            guint id = GPOINTER_TO_UINT(key);
+            g_array_append_val(matches, id);
+        }
+    }
+
+    for (guint i = 0; i < matches->len; i++) {
+        LoopbackSubscription *subscription = g_hash_table_lookup(Loopback.subscriptions,
+                                                                 GUINT_TO_POINTER(g_array_index(matches, guint, i)));
+        if (subscription != NULL) {
+            subscription->callback((GDBusConnection *) &loopback_connection, BLUEZ_DBUS, object_path,
+                                   interface_name, signal_name, parameters, subscription->user_data);
+        }
+    }
+
+    g_array_free(matches, TRUE);
+    if (first != NULL) {
+        g_variant_unref(first);
+    }
+    g_variant_unref(parameters);
+}
+
+void binc_loopback_properties_changed(const char *object_path, const char *interface_name,
+                                      GVariant *changed_properties) {
+    g_assert(changed_properties != NULL);
+
+    binc_loopback_emit_signal(object_path, INTERFACE_PROPERTIES, "PropertiesChanged",
+                              g_variant_new("(s@a{sv}@as)", interface_name, changed_properties,
+                                            g_variant_new_strv(NULL, 0)));
+}
+
+char *binc_loopback_device_appeared(const char *adapter_path, const char *address, gint16 rssi) {
+    g_assert(adapter_path != NULL);
+    g_assert(address != NULL);
+
+    char *device_path = g_strdup_printf("%s/dev_%s", adapter_path, address);
+    g_strdelimit(device_path + strlen(adapter_path), ":", '_');
+
+    GVariantBuilder *properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(properties_builder, "{sv}", "Address", g_variant_new_string(address));
+    g_variant_builder_add(properties_builder, "{sv}", "AddressType", g_variant_new_string("random"));
+    g_variant_builder_add(properties_builder, "{sv}", "Adapter", g_variant_new_object_path(adapter_path));
+    g_variant_builder_add(properties_builder, "{sv}", "RSSI", g_variant_new_int16(rssi));
+    g_variant_builder_add(properties_builder, "{sv}", "Connected", g_variant_new_boolean(FALSE));
+
+    GVariantBuilder *interfaces_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sa{sv}}"));
+    g_variant_builder_add(interfaces_builder, "{sa{sv}}", INTERFACE_DEVICE, properties_builder);
+    binc_loopback_emit_signal("/", INTERFACE_OBJECT_MANAGER, "InterfacesAdded",
+                              g_variant_new("(oa{sa{sv}})", device_path, interfaces_builder));
+    g_variant_builder_unref(interfaces_builder);
+    g_variant_builder_unref(properties_builder);
+    return device_path;
+}
+
+void binc_loopback_notify(const char *char_path, const guint8 *data, gsize length) {
+    g_assert(char_path != NULL);
+
+    GVariantBuilder *properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(properties_builder, "{sv}", "Value",
+                          g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, data, length, sizeof(guint8)));
+    GVariant *changed_properties = g_variant_builder_end(properties_builder);
+    g_variant_builder_unref(properties_builder);
+    binc_loopback_properties_changed(char_path, INTERFACE_CHARACTERISTIC, changed_properties);
+}
+
+guint64 binc_loopback_get_call_count(void) {
+    return Loopback.call_count;
+}
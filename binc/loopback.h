@@ -0,0 +1,75 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_LOOPBACK_H
+#define BINC_LOOPBACK_H
+
+#include <gio/gio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * In-process loopback transport. Instead of talking to Bluez over D-Bus, the library talks to this module and
+ * synthetic Bluez events are fed straight into its signal handlers. Use it to measure the cost of the library
+ * itself, without the bus and bluetoothd.
+ */
+
+/**
+ * Route all library traffic through the loopback transport
+ * @return a connection to pass to the binc_adapter_* functions. It can only be used with this library.
+ */
+GDBusConnection *binc_loopback_enable(void);
+
+// Restore the D-Bus transport and drop all loopback state
+void binc_loopback_disable(void);
+
+// Add an adapter that is reported by GetManagedObjects
+void binc_loopback_add_adapter(const char *adapter_path, const char *address);
+
+/**
+ * Set the reply for a method, for example "(ay)" for org.bluez.GattCharacteristic1.ReadValue.
+ * Methods without a reply return an empty tuple. A reply for GetManagedObjects replaces the built-in list of adapters.
+ */
+void binc_loopback_set_reply(const char *interface_name, const char *method_name, GVariant *reply);
+
+void binc_loopback_emit_signal(const char *object_path, const char *interface_name, const char *signal_name,
+                               GVariant *parameters);
+
+void binc_loopback_properties_changed(const char *object_path, const char *interface_name,
+                                      GVariant *changed_properties);
+
+// Emit InterfacesAdded for a new device and return its object path, must be freed using g_free()
+char *binc_loopback_device_appeared(const char *adapter_path, const char *address, gint16 rssi);
+
+void binc_loopback_notify(const char *char_path, const guint8 *data, gsize length);
+
+// Returns the number of method calls the library made
+guint64 binc_loopback_get_call_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_LOOPBACK_H
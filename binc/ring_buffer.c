@@ -0,0 +1,124 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "ring_buffer.h"
+#include <string.h>
+
+struct binc_ring_buffer {
+    guint8 *data; // Owned
+    gsize capacity;
+    gsize head;
+    gsize length;
+};
+
+RingBuffer *binc_ring_buffer_create(gsize capacity) {
+    g_assert(capacity > 0);
+
+    RingBuffer *ring = g_new0(RingBuffer, 1);
+    ring->data = g_malloc(capacity);
+    ring->capacity = capacity;
+    return ring;
+}
+
+void binc_ring_buffer_free(RingBuffer *ring) {
+    g_assert(ring != NULL);
+
+    g_free(ring->data);
+    ring->data = NULL;
+    g_free(ring);
+}
+
+gsize binc_ring_buffer_get_length(const RingBuffer *ring) {
+    g_assert(ring != NULL);
+    return ring->length;
+}
+
+gsize binc_ring_buffer_get_free(const RingBuffer *ring) {
+    g_assert(ring != NULL);
+    return ring->capacity - ring->length;
+}
+
+gsize binc_ring_buffer_write(RingBuffer *ring, const guint8 *data, gsize length) {
+    g_assert(ring != NULL);
+    g_assert(data != NULL || length == 0);
+
+    length = MIN(length, binc_ring_buffer_get_free(ring));
+    gsize tail = (ring->head + ring->length) % ring->capacity;
+    gsize first = MIN(length, ring->capacity - tail);
+    memcpy(ring->data + tail, data, first);
+    memcpy(ring->data, data + first, length - first);
+    ring->length += length;
+    return length;
+}
+
+gsize binc_ring_buffer_read(RingBuffer *ring, guint8 *data, gsize length) {
+    g_assert(ring != NULL);
+    g_assert(data != NULL || length == 0);
+
+    length = MIN(length, ring->length);
+    gsize first = MIN(length, ring->capacity - ring->head);
+    memcpy(data, ring->data + ring->head, first);
+    memcpy(data + first, ring->data, length - first);
+    binc_ring_buffer_consume(ring, length);
+    return length;
+}
+
+static void reverse(guint8 *data, gsize length) {
+    for (gsize i = 0, j = length; i + 1 < j; i++, j--) {
+        guint8 tmp = data[i];
+        data[i] = data[j - 1];
+        data[j - 1] = tmp;
+    }
+}
+
+const guint8 *binc_ring_buffer_peek(RingBuffer *ring, gsize length) {
+    g_assert(ring != NULL);
+    if (length > ring->length) return NULL;
+
+    // Only when the block wraps around, rotate the buffer in place so the head moves to the start
+    if (ring->head + length > ring->capacity) {
+        reverse(ring->data, ring->head);
+        reverse(ring->data + ring->head, ring->capacity - ring->head);
+        reverse(ring->data, ring->capacity);
+        ring->head = 0;
+    }
+    return ring->data + ring->head;
+}
+
+void binc_ring_buffer_consume(RingBuffer *ring, gsize length) {
+    g_assert(ring != NULL);
+    g_assert(length <= ring->length);
+
+    ring->head = (ring->head + length) % ring->capacity;
+    ring->length -= length;
+    if (ring->length == 0) {
+        ring->head = 0;
+    }
+}
+
+void binc_ring_buffer_clear(RingBuffer *ring) {
+    g_assert(ring != NULL);
+
+    ring->head = 0;
+    ring->length = 0;
+}
@@ -0,0 +1,52 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_RING_BUFFER_H
+#define BINC_RING_BUFFER_H
+
+#include <glib.h>
+
+typedef struct binc_ring_buffer RingBuffer;
+
+RingBuffer *binc_ring_buffer_create(gsize capacity);
+
+void binc_ring_buffer_free(RingBuffer *ring);
+
+gsize binc_ring_buffer_get_length(const RingBuffer *ring);
+
+gsize binc_ring_buffer_get_free(const RingBuffer *ring);
+
+// Append as many bytes as fit and return how many were appended
+gsize binc_ring_buffer_write(RingBuffer *ring, const guint8 *data, gsize length);
+
+// Copy at most length bytes out of the buffer and return how many were copied
+gsize binc_ring_buffer_read(RingBuffer *ring, guint8 *data, gsize length);
+
+// Return the first length bytes as one contiguous block without removing them, or NULL if there are fewer
+const guint8 *binc_ring_buffer_peek(RingBuffer *ring, gsize length);
+
+void binc_ring_buffer_consume(RingBuffer *ring, gsize length);
+
+void binc_ring_buffer_clear(RingBuffer *ring);
+
+#endif //BINC_RING_BUFFER_H
@@ -0,0 +1,292 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "scan_table.h"
+#include "device.h"
+#include <string.h>
+
+/*
+ * Dense table of the device fields that scanning touches most. Every column is a plain array indexed by
+ * the device id, so sweeping over all devices only walks contiguous memory. Slot 0 is never used so
+ * an id of 0 can mean 'no id'. Ids of removed devices are handed out again to keep the table dense.
+ */
+
+#define INITIAL_CAPACITY 64
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+#define MIN_ADVERTISING_INTERVAL_MS 20
+
+struct binc_scan_table {
+    guint size;
+    guint capacity;
+    Device **devices; // Borrowed devices
+    guint64 *addresses;
+    gint16 *rssi;
+    gint16 *tx_power;
+    gint64 *last_seen;
+    guint32 *payload_hash;
+    gint64 *last_arrival;
+    guint32 *arrival_epoch;
+    guint32 *adv_interval;
+    guint32 epoch;
+    GArray *free_ids; // Owned
+};
+
+static void grow(ScanTable *table) {
+    guint old_capacity = table->capacity;
+    table->capacity = old_capacity > 0 ? old_capacity * 2 : INITIAL_CAPACITY;
+
+    table->devices = g_renew(Device *, table->devices, table->capacity);
+    table->addresses = g_renew(guint64, table->addresses, table->capacity);
+    table->rssi = g_renew(gint16, table->rssi, table->capacity);
+    table->tx_power = g_renew(gint16, table->tx_power, table->capacity);
+    table->last_seen = g_renew(gint64, table->last_seen, table->capacity);
+    table->payload_hash = g_renew(guint32, table->payload_hash, table->capacity);
+    table->last_arrival = g_renew(gint64, table->last_arrival, table->capacity);
+    table->arrival_epoch = g_renew(guint32, table->arrival_epoch, table->capacity);
+    table->adv_interval = g_renew(guint32, table->adv_interval, table->capacity);
+
+    gsize added = table->capacity - old_capacity;
+    memset(table->devices + old_capacity, 0, added * sizeof(Device *));
+}
+
+ScanTable *binc_scan_table_create(void) {
+    ScanTable *table = g_new0(ScanTable, 1);
+    table->free_ids = g_array_new(FALSE, FALSE, sizeof(guint));
+    grow(table);
+    table->size = 1;
+    return table;
+}
+
+void binc_scan_table_free(ScanTable *table) {
+    g_assert(table != NULL);
+
+    g_free(table->devices);
+    g_free(table->addresses);
+    g_free(table->rssi);
+    g_free(table->tx_power);
+    g_free(table->last_seen);
+    g_free(table->payload_hash);
+    g_free(table->last_arrival);
+    g_free(table->arrival_epoch);
+    g_free(table->adv_interval);
+    g_array_free(table->free_ids, TRUE);
+    g_free(table);
+}
+
+static guint64 pack_address(const char *address) {
+    guint64 result = 0;
+    if (address == NULL) return result;
+
+    for (const char *c = address; *c != '\0'; c++) {
+        if (g_ascii_isxdigit(*c)) {
+            result = (result << 4) | (guint64) g_ascii_xdigit_value(*c);
+        }
+    }
+    return result;
+}
+
+guint binc_scan_table_add(ScanTable *table, Device *device) {
+    g_assert(table != NULL);
+    g_assert(device != NULL);
+
+    guint id;
+    if (table->free_ids->len > 0) {
+        id = g_array_index(table->free_ids, guint, table->free_ids->len - 1);
+        g_array_set_size(table->free_ids, table->free_ids->len - 1);
+    } else {
+        if (table->size == table->capacity) {
+            grow(table);
+        }
+        id = table->size++;
+    }
+
+    table->devices[id] = device;
+    table->addresses[id] = pack_address(binc_device_get_address(device));
+    table->rssi[id] = binc_device_get_rssi(device);
+    table->tx_power[id] = binc_device_get_txpower(device);
+    table->last_seen[id] = 0;
+    table->payload_hash[id] = 0;
+    table->last_arrival[id] = g_get_monotonic_time();
+    table->arrival_epoch[id] = table->epoch;
+    table->adv_interval[id] = 0;
+    return id;
+}
+
+void binc_scan_table_replace(ScanTable *table, guint id, Device *device) {
+    g_assert(table != NULL);
+    g_assert(id > 0 && id < table->size);
+
+    table->devices[id] = device;
+}
+
+void binc_scan_table_remove(ScanTable *table, guint id) {
+    g_assert(table != NULL);
+    if (id == 0 || id >= table->size || table->devices[id] == NULL) return;
+
+    table->devices[id] = NULL;
+    g_array_append_val(table->free_ids, id);
+}
+
+Device *binc_scan_table_get_device(const ScanTable *table, guint id) {
+    g_assert(table != NULL);
+    if (id == 0 || id >= table->size) return NULL;
+    return table->devices[id];
+}
+
+static gboolean is_tracked(const ScanTable *table, guint id) {
+    return id > 0 && id < table->size && table->devices[id] != NULL;
+}
+
+void binc_scan_table_update_address(ScanTable *table, const Device *device) {
+    guint id = binc_device_get_id(device);
+    if (!is_tracked(table, id)) return;
+
+    table->addresses[id] = pack_address(binc_device_get_address(device));
+}
+
+void binc_scan_table_update_rssi(ScanTable *table, const Device *device) {
+    guint id = binc_device_get_id(device);
+    if (!is_tracked(table, id)) return;
+
+    table->rssi[id] = binc_device_get_rssi(device);
+    table->last_seen[id] = g_get_monotonic_time();
+}
+
+void binc_scan_table_update_tx_power(ScanTable *table, const Device *device) {
+    guint id = binc_device_get_id(device);
+    if (!is_tracked(table, id)) return;
+
+    table->tx_power[id] = binc_device_get_txpower(device);
+}
+
+static guint32 hash_bytes(guint32 hash, const guint8 *data, guint length) {
+    for (guint i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static guint32 hash_payload(GHashTable *payload, gboolean int_keys) {
+    if (payload == NULL) return 0;
+
+    // Sum the hashes of the entries so the result doesn't depend on the iteration order
+    guint32 result = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, payload);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        guint32 hash = FNV_OFFSET_BASIS;
+        if (int_keys) {
+            hash = hash_bytes(hash, key, sizeof(int));
+        } else {
+            hash = hash_bytes(hash, key, (guint) strlen(key));
+        }
+        const GByteArray *byteArray = value;
+        result += hash_bytes(hash, byteArray->data, byteArray->len);
+    }
+    return result;
+}
+
+void binc_scan_table_update_payload(ScanTable *table, const Device *device) {
+    guint id = binc_device_get_id(device);
+    if (!is_tracked(table, id)) return;
+
+    table->payload_hash[id] = hash_payload(binc_device_get_manufacturer_data(device), TRUE) ^
+                              hash_payload(binc_device_get_service_data(device), FALSE);
+    table->last_seen[id] = g_get_monotonic_time();
+}
+
+void binc_scan_table_start_epoch(ScanTable *table) {
+    g_assert(table != NULL);
+    table->epoch++;
+}
+
+/*
+ * Advertisements are easily missed, which makes an inter-arrival time a multiple of the real interval.
+ * Without DuplicateData Bluez even drops every advertisement that doesn't change the RSSI or payload.
+ * So the estimate follows shorter gaps quickly and longer gaps slowly, and a single long gap can at most
+ * double a sample. Gaps that span a period without scanning are ignored by only comparing arrivals
+ * within the same epoch.
+ */
+void binc_scan_table_record_arrival(ScanTable *table, const Device *device, gint64 now) {
+    guint id = binc_device_get_id(device);
+    if (!is_tracked(table, id)) return;
+
+    if (table->arrival_epoch[id] == table->epoch) {
+        gint64 gap = (now - table->last_arrival[id]) / G_TIME_SPAN_MILLISECOND;
+
+        // Several signals can be sent for one advertisement
+        if (gap < MIN_ADVERTISING_INTERVAL_MS) return;
+
+        guint32 sample = (guint32) MIN(gap, G_MAXUINT32);
+        guint32 estimate = table->adv_interval[id];
+        if (estimate == 0) {
+            table->adv_interval[id] = sample;
+        } else if (sample < estimate) {
+            table->adv_interval[id] = (guint32) (((guint64) estimate + 3 * (guint64) sample) / 4);
+        } else {
+            sample = MIN(sample, 2 * estimate);
+            table->adv_interval[id] = (guint32) ((7 * (guint64) estimate + sample) / 8);
+        }
+    }
+
+    table->last_arrival[id] = now;
+    table->arrival_epoch[id] = table->epoch;
+}
+
+guint binc_scan_table_get_adv_interval(const ScanTable *table, const Device *device) {
+    g_assert(table != NULL);
+
+    guint id = binc_device_get_id(device);
+    if (!is_tracked(table, id)) return 0;
+    return table->adv_interval[id];
+}
+
+void binc_scan_table_get_view(const ScanTable *table, ScanStateView *view) {
+    g_assert(table != NULL);
+    g_assert(view != NULL);
+
+    view->size = table->size;
+    view->devices = (const Device *const *) table->devices;
+    view->addresses = table->addresses;
+    view->rssi = table->rssi;
+    view->tx_power = table->tx_power;
+    view->last_seen = table->last_seen;
+    view->payload_hash = table->payload_hash;
+    view->adv_interval = table->adv_interval;
+}
+
+GList *binc_scan_table_find_not_seen_since(const ScanTable *table, guint max_age_seconds) {
+    g_assert(table != NULL);
+
+    gint64 oldest = g_get_monotonic_time() - (gint64) max_age_seconds * G_TIME_SPAN_SECOND;
+    GList *result = NULL;
+    for (guint id = 1; id < table->size; id++) {
+        // Devices that were never seen, e.g. devices BlueZ had cached, count as stale
+        if (table->devices[id] != NULL && (table->last_seen[id] == 0 || table->last_seen[id] < oldest)) {
+            result = g_list_prepend(result, table->devices[id]);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,63 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_SCAN_TABLE_H
+#define BINC_SCAN_TABLE_H
+
+#include <glib.h>
+#include "forward_decl.h"
+#include "adapter.h"
+
+typedef struct binc_scan_table ScanTable;
+
+ScanTable *binc_scan_table_create(void);
+
+void binc_scan_table_free(ScanTable *table);
+
+guint binc_scan_table_add(ScanTable *table, Device *device);
+
+void binc_scan_table_replace(ScanTable *table, guint id, Device *device);
+
+void binc_scan_table_remove(ScanTable *table, guint id);
+
+Device *binc_scan_table_get_device(const ScanTable *table, guint id);
+
+void binc_scan_table_update_address(ScanTable *table, const Device *device);
+
+void binc_scan_table_update_rssi(ScanTable *table, const Device *device);
+
+void binc_scan_table_update_tx_power(ScanTable *table, const Device *device);
+
+void binc_scan_table_update_payload(ScanTable *table, const Device *device);
+
+void binc_scan_table_start_epoch(ScanTable *table);
+
+void binc_scan_table_record_arrival(ScanTable *table, const Device *device, gint64 now);
+
+guint binc_scan_table_get_adv_interval(const ScanTable *table, const Device *device);
+
+void binc_scan_table_get_view(const ScanTable *table, ScanStateView *view);
+
+GList *binc_scan_table_find_not_seen_since(const ScanTable *table, guint max_age_seconds);
+
+#endif //BINC_SCAN_TABLE_H
@@ -0,0 +1,626 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include "smp_upload.h"
+#include "characteristic_internal.h"
+#include "device_internal.h"
+#include "dbus_transport.h"
+#include "logger.h"
+
+static const char *const TAG = "SmpUpload";
+
+#define SMP_HEADER_SIZE 8
+#define SMP_OP_WRITE 2
+#define SMP_OP_WRITE_RSP 3
+#define SMP_GROUP_IMAGE 1
+#define SMP_ID_IMAGE_UPLOAD 1
+
+#define CBOR_UINT 0
+#define CBOR_NEGINT 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+
+static const guint DEFAULT_WINDOW = 4;
+static const guint RESPONSE_TIMEOUT_MS = 5000;
+static const guint ATT_HEADER_SIZE = 3;
+static const guint DEFAULT_MTU = 23;
+
+typedef struct smp_request {
+    guint8 seq;
+    gsize end;
+} SmpRequest;
+
+struct binc_smp_upload {
+    GBytes *image; // Owned
+    guint8 image_slot;
+    Characteristic *characteristic; // Borrowed
+    GDBusConnection *connection; // Borrowed
+    WriteType write_type;
+    SmpUploadState state;
+    gsize confirmed;
+    gsize next_offset;
+    guint window;
+    gsize min_packet_size;
+    GQueue *requests; // Owned
+    guint8 next_seq;
+    GByteArray *response; // Owned
+    guint pending_calls;
+    guint timeout_id;
+    gint64 run_start;
+    gsize run_start_offset;
+    guint rc;
+    gboolean dispatching;
+    gboolean closed;
+
+    SmpUploadProgressCallback progress_callback;
+    SmpUploadStateChangedCallback state_callback;
+    void *user_data; // Borrowed
+};
+
+typedef struct cbor_reader {
+    const guint8 *data;
+    gsize length;
+    gsize pos;
+} CborReader;
+
+static gsize cbor_head_size(guint64 value) {
+    if (value < 24) return 1;
+    if (value <= G_MAXUINT8) return 2;
+    if (value <= G_MAXUINT16) return 3;
+    return 5;
+}
+
+static void cbor_put_head(GByteArray *out, guint8 major, guint64 value) {
+    guint8 head[5];
+    gsize size = cbor_head_size(value);
+    if (size == 1) {
+        head[0] = (guint8) ((major << 5) | value);
+    } else {
+        // Additional info 24, 25 and 26 mean the value follows in 1, 2 or 4 big endian bytes
+        head[0] = (guint8) ((major << 5) | (size == 2 ? 24 : size == 3 ? 25 : 26));
+        for (gsize i = 1; i < size; i++) {
+            head[i] = (guint8) (value >> (8 * (size - 1 - i)));
+        }
+    }
+    g_byte_array_append(out, head, (guint) size);
+}
+
+static void cbor_put_text(GByteArray *out, const char *text) {
+    gsize length = strlen(text);
+    cbor_put_head(out, CBOR_TEXT, length);
+    g_byte_array_append(out, (const guint8 *) text, (guint) length);
+}
+
+static gboolean cbor_get_head(CborReader *reader, guint8 *major, guint64 *value) {
+    if (reader->pos >= reader->length) return FALSE;
+
+    guint8 initial = reader->data[reader->pos++];
+    guint8 info = initial & 0x1F;
+    *major = initial >> 5;
+    if (info < 24) {
+        *value = info;
+        return TRUE;
+    }
+
+    // Indefinite lengths are not used by MCUmgr
+    if (info > 27) return FALSE;
+
+    gsize size = (gsize) 1 << (info - 24);
+    if (reader->pos + size > reader->length) return FALSE;
+
+    *value = 0;
+    for (gsize i = 0; i < size; i++) {
+        *value = (*value << 8) | reader->data[reader->pos++];
+    }
+    return TRUE;
+}
+
+static gboolean cbor_skip(CborReader *reader) {
+    guint8 major;
+    guint64 value;
+    if (!cbor_get_head(reader, &major, &value)) return FALSE;
+
+    switch (major) {
+        case CBOR_BYTES:
+        case CBOR_TEXT:
+            if (value > reader->length - reader->pos) return FALSE;
+            reader->pos += (gsize) value;
+            return TRUE;
+        case CBOR_ARRAY:
+        case CBOR_MAP:
+            for (guint64 i = 0; i < (major == CBOR_MAP ? value * 2 : value); i++) {
+                if (!cbor_skip(reader)) return FALSE;
+            }
+            return TRUE;
+        case CBOR_TAG:
+            return cbor_skip(reader);
+        default:
+            return TRUE;
+    }
+}
+
+static gboolean cbor_key_equals(const CborReader *reader, guint64 length, const char *key) {
+    return length == strlen(key) && memcmp(reader->data + reader->pos, key, (gsize) length) == 0;
+}
+
+// Find 'rc' and 'off' in a response, SMP version 2 puts the return code in an 'err' map
+static gboolean parse_response_map(CborReader *reader, guint64 count, guint *rc, guint64 *off, gboolean *has_off) {
+    for (guint64 i = 0; i < count; i++) {
+        guint8 major;
+        guint64 length;
+        if (!cbor_get_head(reader, &major, &length) || major != CBOR_TEXT) return FALSE;
+        if (length > reader->length - reader->pos) return FALSE;
+
+        gboolean is_rc = cbor_key_equals(reader, length, "rc");
+        gboolean is_off = cbor_key_equals(reader, length, "off");
+        gboolean is_err = cbor_key_equals(reader, length, "err");
+        reader->pos += (gsize) length;
+
+        gsize value_pos = reader->pos;
+        guint64 value;
+        if (!cbor_get_head(reader, &major, &value)) return FALSE;
+
+        if (is_rc && (major == CBOR_UINT || major == CBOR_NEGINT)) {
+            *rc = major == CBOR_UINT ? (guint) value : (guint) (value + 1);
+        } else if (is_off && major == CBOR_UINT) {
+            *off = value;
+            *has_off = TRUE;
+        } else if (is_err && major == CBOR_MAP) {
+            if (!parse_response_map(reader, value, rc, off, has_off)) return FALSE;
+        } else {
+            reader->pos = value_pos;
+            if (!cbor_skip(reader)) return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static gboolean parse_response(const guint8 *data, gsize length, guint *rc, guint64 *off, gboolean *has_off) {
+    CborReader reader = {.data = data, .length = length, .pos = 0};
+    guint8 major;
+    guint64 count;
+    if (!cbor_get_head(&reader, &major, &count) || major != CBOR_MAP) return FALSE;
+
+    return parse_response_map(&reader, count, rc, off, has_off);
+}
+
+static gsize get_image_size(const SmpUpload *upload) {
+    return g_bytes_get_size(upload->image);
+}
+
+static gsize get_packet_size(const SmpUpload *upload) {
+    guint mtu = binc_characteristic_get_mtu(upload->characteristic);
+    if (mtu == 0) mtu = DEFAULT_MTU;
+    return MAX(mtu - ATT_HEADER_SIZE, upload->min_packet_size);
+}
+
+static gsize get_overhead(const SmpUpload *upload, gsize offset) {
+    gsize total = get_image_size(upload);
+
+    // Map, 'off' and 'data' with the largest possible headers, so all chunks but the first have the same size.
+    // The first request also has 'len' and 'image'.
+    gsize overhead = SMP_HEADER_SIZE + 1 + 4 + cbor_head_size(total) + 5 + cbor_head_size(G_MAXUINT16);
+    if (offset == 0) {
+        overhead += 4 + cbor_head_size(total) + 6 + cbor_head_size(upload->image_slot);
+    }
+    return overhead;
+}
+
+static gsize get_chunk_size(const SmpUpload *upload, gsize offset) {
+    return MIN(get_packet_size(upload) - get_overhead(upload, offset), get_image_size(upload) - offset);
+}
+
+static GByteArray *create_upload_request(const SmpUpload *upload, guint8 seq, gsize offset, gsize length) {
+    const guint8 *image = g_bytes_get_data(upload->image, NULL);
+
+    GByteArray *packet = g_byte_array_sized_new((guint) get_packet_size(upload));
+    guint8 header[SMP_HEADER_SIZE] = {SMP_OP_WRITE, 0, 0, 0, 0, SMP_GROUP_IMAGE, seq, SMP_ID_IMAGE_UPLOAD};
+    g_byte_array_append(packet, header, SMP_HEADER_SIZE);
+
+    cbor_put_head(packet, CBOR_MAP, offset == 0 ? 4 : 2);
+    if (offset == 0) {
+        cbor_put_text(packet, "image");
+        cbor_put_head(packet, CBOR_UINT, upload->image_slot);
+        cbor_put_text(packet, "len");
+        cbor_put_head(packet, CBOR_UINT, get_image_size(upload));
+    }
+    cbor_put_text(packet, "off");
+    cbor_put_head(packet, CBOR_UINT, offset);
+    cbor_put_text(packet, "data");
+    cbor_put_head(packet, CBOR_BYTES, length);
+    g_byte_array_append(packet, image + offset, (guint) length);
+
+    // The header holds the length of the CBOR payload in big endian
+    gsize payload_length = packet->len - SMP_HEADER_SIZE;
+    packet->data[2] = (guint8) (payload_length >> 8);
+    packet->data[3] = (guint8) (payload_length & 0xFF);
+    return packet;
+}
+
+static void free_if_closed(SmpUpload *upload) {
+    // Calls in flight and responses that are being handled still use the upload
+    if (!upload->closed || upload->pending_calls > 0 || upload->dispatching) return;
+
+    g_queue_free_full(upload->requests, g_free);
+    upload->requests = NULL;
+    g_byte_array_free(upload->response, TRUE);
+    upload->response = NULL;
+    g_bytes_unref(upload->image);
+    upload->image = NULL;
+    g_free(upload);
+}
+
+static void detach(SmpUpload *upload) {
+    if (upload->timeout_id != 0) {
+        g_source_remove(upload->timeout_id);
+        upload->timeout_id = 0;
+    }
+
+    if (upload->characteristic != NULL) {
+        binc_characteristic_set_notify_listener(upload->characteristic, NULL, NULL, NULL);
+        upload->characteristic = NULL;
+    }
+
+    // Responses to requests that were sent already are ignored from now on
+    g_queue_clear_full(upload->requests, g_free);
+    g_byte_array_set_size(upload->response, 0);
+}
+
+static void set_state(SmpUpload *upload, SmpUploadState state, const GError *error) {
+    upload->state = state;
+    if (state != SMP_UPLOAD_RUNNING) {
+        detach(upload);
+        upload->next_offset = upload->confirmed;
+    }
+
+    if (upload->state_callback != NULL) {
+        upload->state_callback(upload, state, error);
+    }
+}
+
+static gboolean binc_internal_smp_timeout(gpointer user_data) {
+    SmpUpload *upload = (SmpUpload *) user_data;
+    g_assert(upload != NULL);
+
+    log_debug(TAG, "no response at offset %zu", upload->confirmed);
+    upload->timeout_id = 0;
+    set_state(upload, SMP_UPLOAD_PAUSED, NULL);
+    return G_SOURCE_REMOVE;
+}
+
+static void restart_timeout(SmpUpload *upload) {
+    if (upload->timeout_id != 0) {
+        g_source_remove(upload->timeout_id);
+    }
+    upload->timeout_id = g_timeout_add(RESPONSE_TIMEOUT_MS, binc_internal_smp_timeout, upload);
+}
+
+static void binc_internal_smp_call_cb(__attribute__((unused)) GObject *source_object,
+                                      GAsyncResult *res,
+                                      gpointer user_data);
+
+static void send_request(SmpUpload *upload) {
+    gsize offset = upload->next_offset;
+    gsize length = get_chunk_size(upload, offset);
+    guint8 seq = upload->next_seq++;
+
+    SmpRequest *request = g_new0(SmpRequest, 1);
+    request->seq = seq;
+    request->end = offset + length;
+    g_queue_push_tail(upload->requests, request);
+    upload->next_offset = request->end;
+
+    // Only requests larger than the mtu are split over several writes, the device reassembles them using the
+    // length in the header
+    GByteArray *packet = create_upload_request(upload, seq, offset, length);
+    guint mtu = binc_characteristic_get_mtu(upload->characteristic);
+    gsize fragment_size = (mtu > 0 ? mtu : DEFAULT_MTU) - ATT_HEADER_SIZE;
+    for (gsize sent = 0; sent < packet->len; sent += fragment_size) {
+        upload->pending_calls++;
+        binc_characteristic_write_async(upload->characteristic, packet->data + sent,
+                                        MIN(fragment_size, packet->len - sent), upload->write_type,
+                                        (GAsyncReadyCallback) binc_internal_smp_call_cb, upload);
+    }
+    g_byte_array_free(packet, TRUE);
+}
+
+static void send_window(SmpUpload *upload) {
+    gsize total = get_image_size(upload);
+    while (upload->state == SMP_UPLOAD_RUNNING && g_queue_get_length(upload->requests) < upload->window &&
+           upload->next_offset < total) {
+        send_request(upload);
+    }
+}
+
+static SmpRequest *take_request(SmpUpload *upload, guint8 seq) {
+    for (GList *iterator = upload->requests->head; iterator != NULL; iterator = iterator->next) {
+        SmpRequest *request = (SmpRequest *) iterator->data;
+        if (request->seq == seq) {
+            g_queue_delete_link(upload->requests, iterator);
+            return request;
+        }
+    }
+    return NULL;
+}
+
+static void handle_response(SmpUpload *upload, const guint8 *packet, gsize length) {
+    guint16 group = (guint16) ((packet[4] << 8) | packet[5]);
+    if (packet[0] != SMP_OP_WRITE_RSP || group != SMP_GROUP_IMAGE || packet[7] != SMP_ID_IMAGE_UPLOAD) {
+        log_debug(TAG, "ignoring response op=%u group=%u id=%u", packet[0], group, packet[7]);
+        return;
+    }
+
+    SmpRequest *request = take_request(upload, packet[6]);
+    if (request == NULL) return;
+
+    guint rc = 0;
+    guint64 off = 0;
+    gboolean has_off = FALSE;
+    gboolean valid = parse_response(packet + SMP_HEADER_SIZE, length - SMP_HEADER_SIZE, &rc, &off, &has_off);
+    gsize end = request->end;
+    g_free(request);
+
+    if (!valid || rc != 0 || !has_off || off > get_image_size(upload)) {
+        log_error(TAG, "upload rejected at offset %zu (rc %u)", upload->confirmed, rc);
+        upload->rc = rc;
+        set_state(upload, SMP_UPLOAD_FAILED, NULL);
+        return;
+    }
+
+    // The device reports the offset it expects next. When that isn't the end of the request, it dropped or
+    // rejected data, so go back to its offset and forget the requests that were sent after it.
+    upload->confirmed = (gsize) off;
+    if (off != end) {
+        log_debug(TAG, "device expects offset %lu instead of %zu", (unsigned long) off, end);
+        g_queue_clear_full(upload->requests, g_free);
+        upload->next_offset = (gsize) off;
+    }
+
+    restart_timeout(upload);
+    if (upload->progress_callback != NULL) {
+        upload->progress_callback(upload, upload->confirmed, get_image_size(upload),
+                                  binc_smp_upload_get_throughput(upload));
+    }
+
+    if (upload->closed || upload->state != SMP_UPLOAD_RUNNING) return;
+    if (upload->confirmed == get_image_size(upload)) {
+        log_debug(TAG, "upload done, %u bytes/s", binc_smp_upload_get_throughput(upload));
+        set_state(upload, SMP_UPLOAD_DONE, NULL);
+        return;
+    }
+    send_window(upload);
+}
+
+static void on_notify(__attribute__((unused)) Characteristic *characteristic, const GByteArray *byteArray,
+                      void *user_data) {
+    SmpUpload *upload = (SmpUpload *) user_data;
+    g_assert(upload != NULL);
+
+    // Responses may be split over several notifications
+    g_byte_array_append(upload->response, byteArray->data, byteArray->len);
+    upload->dispatching = TRUE;
+    while (!upload->closed && upload->state == SMP_UPLOAD_RUNNING && upload->response->len >= SMP_HEADER_SIZE) {
+        gsize length = SMP_HEADER_SIZE + (gsize) ((upload->response->data[2] << 8) | upload->response->data[3]);
+        if (upload->response->len < length) break;
+
+        handle_response(upload, upload->response->data, length);
+        if (upload->response->len >= length) {
+            g_byte_array_remove_range(upload->response, 0, (guint) length);
+        }
+    }
+    upload->dispatching = FALSE;
+    free_if_closed(upload);
+}
+
+static void on_detached(__attribute__((unused)) Characteristic *characteristic, void *user_data) {
+    SmpUpload *upload = (SmpUpload *) user_data;
+    g_assert(upload != NULL);
+
+    // The device disconnected or the characteristic is freed, so pause until started with a new characteristic
+    upload->characteristic = NULL;
+    if (upload->state == SMP_UPLOAD_RUNNING) {
+        log_debug(TAG, "device disconnected at offset %zu", upload->confirmed);
+        set_state(upload, SMP_UPLOAD_PAUSED, NULL);
+    }
+}
+
+// Returns TRUE if the call succeeded and the upload is still running
+static gboolean finish_call(SmpUpload *upload, GAsyncResult *res) {
+    GError *error = NULL;
+    GVariant *value = binc_dbus_call_finish(upload->connection, res, &error);
+    if (value != NULL) {
+        g_variant_unref(value);
+    }
+    upload->pending_calls--;
+
+    if (upload->closed) {
+        g_clear_error(&error);
+        free_if_closed(upload);
+        return FALSE;
+    }
+
+    if (error != NULL) {
+        log_error(TAG, "call failed (error %d: %s)", error->code, error->message);
+        if (upload->state == SMP_UPLOAD_RUNNING) {
+            set_state(upload, SMP_UPLOAD_PAUSED, error);
+        }
+        g_clear_error(&error);
+        return FALSE;
+    }
+    return upload->state == SMP_UPLOAD_RUNNING;
+}
+
+static void binc_internal_smp_call_cb(__attribute__((unused)) GObject *source_object,
+                                      GAsyncResult *res,
+                                      gpointer user_data) {
+    SmpUpload *upload = (SmpUpload *) user_data;
+    g_assert(upload != NULL);
+
+    finish_call(upload, res);
+}
+
+static void binc_internal_smp_start_notify_cb(__attribute__((unused)) GObject *source_object,
+                                              GAsyncResult *res,
+                                              gpointer user_data) {
+    SmpUpload *upload = (SmpUpload *) user_data;
+    g_assert(upload != NULL);
+
+    if (finish_call(upload, res)) {
+        send_window(upload);
+    }
+}
+
+SmpUpload *binc_smp_upload_create(GBytes *image, guint8 image_slot) {
+    g_assert(image != NULL);
+    g_assert(g_bytes_get_size(image) > 0);
+
+    SmpUpload *upload = g_new0(SmpUpload, 1);
+    upload->image = g_bytes_ref(image);
+    upload->image_slot = image_slot;
+    upload->state = SMP_UPLOAD_IDLE;
+    upload->window = DEFAULT_WINDOW;
+    upload->requests = g_queue_new();
+    upload->response = g_byte_array_new();
+    return upload;
+}
+
+void binc_smp_upload_free(SmpUpload *upload) {
+    g_assert(upload != NULL);
+
+    detach(upload);
+    upload->closed = TRUE;
+    free_if_closed(upload);
+}
+
+int binc_smp_upload_start(SmpUpload *upload, Characteristic *characteristic) {
+    g_return_val_if_fail (upload != NULL, EINVAL);
+    g_return_val_if_fail (characteristic != NULL, EINVAL);
+    g_return_val_if_fail (upload->state != SMP_UPLOAD_RUNNING && upload->state != SMP_UPLOAD_DONE, EINVAL);
+    g_return_val_if_fail (binc_characteristic_supports_notify(characteristic), EINVAL);
+
+    if (binc_characteristic_supports_write(characteristic, WITHOUT_RESPONSE)) {
+        upload->write_type = WITHOUT_RESPONSE;
+    } else if (binc_characteristic_supports_write(characteristic, WITH_RESPONSE)) {
+        upload->write_type = WITH_RESPONSE;
+    } else {
+        return EINVAL;
+    }
+
+    upload->characteristic = characteristic;
+    if (get_packet_size(upload) <= get_overhead(upload, 0)) {
+        log_error(TAG, "mtu %u is too small for a request", binc_characteristic_get_mtu(characteristic));
+        upload->characteristic = NULL;
+        return EINVAL;
+    }
+
+    upload->connection = binc_device_get_dbus_connection(binc_characteristic_get_device(characteristic));
+    upload->next_offset = upload->confirmed;
+    upload->run_start = g_get_monotonic_time();
+    upload->run_start_offset = upload->confirmed;
+    upload->rc = 0;
+    binc_characteristic_set_notify_listener(characteristic, on_notify, on_detached, upload);
+
+    log_debug(TAG, "starting upload at offset %zu of %zu", upload->confirmed, get_image_size(upload));
+    set_state(upload, SMP_UPLOAD_RUNNING, NULL);
+    restart_timeout(upload);
+
+    // Responses are notified, so wait for notify to be started before sending anything
+    if (binc_characteristic_is_notifying(characteristic)) {
+        send_window(upload);
+    } else {
+        upload->pending_calls++;
+        binc_characteristic_start_notify_async(characteristic,
+                                               (GAsyncReadyCallback) binc_internal_smp_start_notify_cb, upload);
+    }
+    return 0;
+}
+
+void binc_smp_upload_pause(SmpUpload *upload) {
+    g_assert(upload != NULL);
+
+    if (upload->state == SMP_UPLOAD_RUNNING) {
+        set_state(upload, SMP_UPLOAD_PAUSED, NULL);
+    }
+}
+
+void binc_smp_upload_set_min_packet_size(SmpUpload *upload, gsize size) {
+    g_assert(upload != NULL);
+    upload->min_packet_size = size;
+}
+
+void binc_smp_upload_set_window(SmpUpload *upload, guint window) {
+    g_assert(upload != NULL);
+    g_assert(window > 0);
+
+    upload->window = window;
+    send_window(upload);
+}
+
+SmpUploadState binc_smp_upload_get_state(const SmpUpload *upload) {
+    g_assert(upload != NULL);
+    return upload->state;
+}
+
+gsize binc_smp_upload_get_offset(const SmpUpload *upload) {
+    g_assert(upload != NULL);
+    return upload->confirmed;
+}
+
+guint binc_smp_upload_get_throughput(const SmpUpload *upload) {
+    g_assert(upload != NULL);
+
+    gint64 elapsed = g_get_monotonic_time() - upload->run_start;
+    if (upload->run_start == 0 || elapsed <= 0 || upload->confirmed <= upload->run_start_offset) return 0;
+
+    return (guint) ((gint64) (upload->confirmed - upload->run_start_offset) * G_USEC_PER_SEC / elapsed);
+}
+
+guint binc_smp_upload_get_rc(const SmpUpload *upload) {
+    g_assert(upload != NULL);
+    return upload->rc;
+}
+
+void binc_smp_upload_set_progress_cb(SmpUpload *upload, SmpUploadProgressCallback callback) {
+    g_assert(upload != NULL);
+    upload->progress_callback = callback;
+}
+
+void binc_smp_upload_set_state_changed_cb(SmpUpload *upload, SmpUploadStateChangedCallback callback) {
+    g_assert(upload != NULL);
+    upload->state_callback = callback;
+}
+
+void binc_smp_upload_set_user_data(SmpUpload *upload, void *user_data) {
+    g_assert(upload != NULL);
+    upload->user_data = user_data;
+}
+
+void *binc_smp_upload_get_user_data(const SmpUpload *upload) {
+    g_assert(upload != NULL);
+    return upload->user_data;
+}
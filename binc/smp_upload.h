@@ -0,0 +1,116 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_SMP_UPLOAD_H
+#define BINC_SMP_UPLOAD_H
+
+#include <glib.h>
+#include "forward_decl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SMP_SERVICE_UUID "8d53dc1d-1db7-4cd3-868b-8a527460aa84"
+#define SMP_CHARACTERISTIC_UUID "da2e7828-fbce-4e01-ae9e-261174997c48"
+
+typedef enum SmpUploadState {
+    SMP_UPLOAD_IDLE = 0, SMP_UPLOAD_RUNNING = 1, SMP_UPLOAD_PAUSED = 2, SMP_UPLOAD_DONE = 3, SMP_UPLOAD_FAILED = 4
+} SmpUploadState;
+
+// Called when the device acknowledged more of the image
+typedef void (*SmpUploadProgressCallback)(SmpUpload *upload, gsize offset, gsize total, guint bytes_per_second);
+
+/**
+ * Called when the upload state changes
+ *
+ * PAUSED is reported when a write failed, with its error, or when the device stopped responding, without an error.
+ * FAILED is reported when the device rejected the upload, get its return code with binc_smp_upload_get_rc().
+ */
+typedef void (*SmpUploadStateChangedCallback)(SmpUpload *upload, SmpUploadState state, const GError *error);
+
+/**
+ * Create an MCUmgr image upload
+ *
+ * @param image the firmware image, a reference is kept until the upload is freed
+ * @param image_slot the image number to upload to, 0 for the default image
+ * @return the upload, free with binc_smp_upload_free()
+ */
+SmpUpload *binc_smp_upload_create(GBytes *image, guint8 image_slot);
+
+void binc_smp_upload_free(SmpUpload *upload);
+
+/**
+ * Start or resume uploading to the SMP characteristic of a connected device
+ *
+ * The upload continues from the last offset the device acknowledged. It is paused when the device disconnects,
+ * so after reconnecting call this again with the characteristic of the reconnected device. Several requests are
+ * kept in flight and every request is sized to fit the MTU of the characteristic.
+ *
+ * @param upload the upload
+ * @param characteristic the SMP characteristic, it must support write and notify
+ * @return 0 if the upload started, EINVAL if it is running or done already, or the MTU is too small for a request
+ */
+int binc_smp_upload_start(SmpUpload *upload, Characteristic *characteristic);
+
+// Stop sending and stop using the characteristic, e.g. before disconnecting
+void binc_smp_upload_pause(SmpUpload *upload);
+
+/**
+ * Make requests at least this large, even if they don't fit the MTU
+ *
+ * Larger requests are split over several writes, so the device must reassemble them. MCUmgr only does that with
+ * CONFIG_MCUMGR_TRANSPORT_BT_REASSEMBLY enabled. Use it when the MTU is small, e.g. 128 for an MTU of 23.
+ *
+ * @param upload the upload
+ * @param size the minimum request size in bytes, 0 by default to size requests from the MTU only
+ */
+void binc_smp_upload_set_min_packet_size(SmpUpload *upload, gsize size);
+
+// Set the number of requests that may be waiting for a response, 4 by default
+void binc_smp_upload_set_window(SmpUpload *upload, guint window);
+
+SmpUploadState binc_smp_upload_get_state(const SmpUpload *upload);
+
+// Returns the offset up to which the device acknowledged the image
+gsize binc_smp_upload_get_offset(const SmpUpload *upload);
+
+// Returns the average number of bytes acknowledged per second since the upload was last started
+guint binc_smp_upload_get_throughput(const SmpUpload *upload);
+
+// Returns the MCUmgr return code of the device when the upload failed
+guint binc_smp_upload_get_rc(const SmpUpload *upload);
+
+void binc_smp_upload_set_progress_cb(SmpUpload *upload, SmpUploadProgressCallback callback);
+
+void binc_smp_upload_set_state_changed_cb(SmpUpload *upload, SmpUploadStateChangedCallback callback);
+
+void binc_smp_upload_set_user_data(SmpUpload *upload, void *user_data);
+
+void *binc_smp_upload_get_user_data(const SmpUpload *upload);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_SMP_UPLOAD_H
@@ -0,0 +1,292 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "stream_channel.h"
+#include "characteristic_internal.h"
+#include "device_internal.h"
+#include "dbus_transport.h"
+#include "ring_buffer.h"
+#include "logger.h"
+
+static const char *const TAG = "StreamChannel";
+
+static const gsize DEFAULT_BUFFER_SIZE = 4096;
+static const guint DEFAULT_CREDITS = 4;
+static const guint ATT_HEADER_SIZE = 3;
+static const guint DEFAULT_CHUNK_SIZE = 20;
+static const gsize FRAME_HEADER_SIZE = 2;
+
+struct binc_stream_channel {
+    Device *device; // Borrowed
+    Characteristic *tx; // Borrowed
+    Characteristic *rx; // Borrowed
+    GDBusConnection *connection; // Borrowed
+    gboolean framed;
+    WriteType write_type;
+    RingBuffer *tx_buffer; // Owned
+    RingBuffer *rx_buffer; // Owned
+    guint credits;
+    guint in_flight;
+    gboolean failed;
+    gboolean delivering;
+    gboolean closed;
+
+    StreamChannelReceiveCallback receive_callback;
+    StreamChannelDrainedCallback drained_callback;
+    StreamChannelErrorCallback error_callback;
+    void *user_data; // Borrowed
+};
+
+static void free_if_closed(StreamChannel *channel) {
+    // Writes in flight and callbacks that are running still use the channel
+    if (!channel->closed || channel->in_flight > 0 || channel->delivering) return;
+
+    binc_ring_buffer_free(channel->tx_buffer);
+    channel->tx_buffer = NULL;
+    binc_ring_buffer_free(channel->rx_buffer);
+    channel->rx_buffer = NULL;
+    g_free(channel);
+}
+
+static guint get_chunk_size(const StreamChannel *channel) {
+    guint mtu = binc_characteristic_get_mtu(channel->tx);
+    return mtu > ATT_HEADER_SIZE ? mtu - ATT_HEADER_SIZE : DEFAULT_CHUNK_SIZE;
+}
+
+static void send_next(StreamChannel *channel);
+
+static void binc_internal_stream_write_cb(__attribute__((unused)) GObject *source_object,
+                                          GAsyncResult *res,
+                                          gpointer user_data) {
+    StreamChannel *channel = (StreamChannel *) user_data;
+    g_assert(channel != NULL);
+
+    GError *error = NULL;
+    GVariant *value = binc_dbus_call_finish(channel->connection, res, &error);
+    if (value != NULL) {
+        g_variant_unref(value);
+    }
+    channel->in_flight--;
+
+    if (channel->closed) {
+        g_clear_error(&error);
+        free_if_closed(channel);
+        return;
+    }
+
+    if (error != NULL) {
+        log_error(TAG, "failed to write chunk (error %d: %s)", error->code, error->message);
+        channel->failed = TRUE;
+        if (channel->error_callback != NULL) {
+            channel->error_callback(channel, error);
+        }
+        g_clear_error(&error);
+        return;
+    }
+
+    send_next(channel);
+    if (channel->in_flight == 0 && binc_ring_buffer_get_length(channel->tx_buffer) == 0 &&
+        channel->drained_callback != NULL) {
+        channel->drained_callback(channel);
+    }
+}
+
+static void send_next(StreamChannel *channel) {
+    guint chunk_size = get_chunk_size(channel);
+    while (!channel->failed && channel->in_flight < channel->credits) {
+        gsize length = MIN(binc_ring_buffer_get_length(channel->tx_buffer), chunk_size);
+        if (length == 0) break;
+
+        // The data is copied into the message, so it can be consumed right away
+        const guint8 *chunk = binc_ring_buffer_peek(channel->tx_buffer, length);
+        channel->in_flight++;
+        binc_characteristic_write_async(channel->tx, chunk, length, channel->write_type,
+                                        (GAsyncReadyCallback) binc_internal_stream_write_cb, channel);
+        binc_ring_buffer_consume(channel->tx_buffer, length);
+    }
+}
+
+static void deliver_received(StreamChannel *channel) {
+    RingBuffer *rx_buffer = channel->rx_buffer;
+    while (!channel->closed && binc_ring_buffer_get_length(rx_buffer) > 0) {
+        gsize available = binc_ring_buffer_get_length(rx_buffer);
+        gsize offset = 0;
+        gsize length = available;
+        if (channel->framed) {
+            if (available < FRAME_HEADER_SIZE) return;
+
+            const guint8 *header = binc_ring_buffer_peek(rx_buffer, FRAME_HEADER_SIZE);
+            offset = FRAME_HEADER_SIZE;
+            length = (gsize) header[0] | ((gsize) header[1] << 8);
+            if (offset + length > available) return;
+        }
+
+        const guint8 *data = binc_ring_buffer_peek(rx_buffer, offset + length);
+        if (channel->receive_callback != NULL) {
+            channel->receive_callback(channel, data + offset, length);
+        }
+        binc_ring_buffer_consume(rx_buffer, offset + length);
+    }
+}
+
+static void on_rx_notify(__attribute__((unused)) Characteristic *characteristic, const GByteArray *byteArray,
+                         void *user_data) {
+    StreamChannel *channel = (StreamChannel *) user_data;
+    g_assert(channel != NULL);
+
+    if (channel->failed) return;
+
+    // Dropping data would corrupt the stream, so stop the channel instead
+    if (binc_ring_buffer_write(channel->rx_buffer, byteArray->data, byteArray->len) < byteArray->len) {
+        log_error(TAG, "receive buffer overflow, stopping channel");
+        channel->failed = TRUE;
+        if (channel->error_callback != NULL) {
+            GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_NO_SPACE, "receive buffer overflow");
+            channel->error_callback(channel, error);
+            g_error_free(error);
+        }
+        return;
+    }
+
+    channel->delivering = TRUE;
+    deliver_received(channel);
+    channel->delivering = FALSE;
+    free_if_closed(channel);
+}
+
+static void on_rx_detached(__attribute__((unused)) Characteristic *characteristic, void *user_data) {
+    StreamChannel *channel = (StreamChannel *) user_data;
+    g_assert(channel != NULL);
+
+    // The characteristics are gone once the device disconnected, so the channel can't be used anymore
+    channel->rx = NULL;
+    if (channel->failed) return;
+
+    log_debug(TAG, "device disconnected, stopping channel");
+    channel->failed = TRUE;
+    if (channel->error_callback != NULL) {
+        GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_CLOSED, "device disconnected");
+        channel->error_callback(channel, error);
+        g_error_free(error);
+    }
+}
+
+StreamChannel *binc_stream_channel_create(Characteristic *tx, Characteristic *rx, gboolean framed, gsize buffer_size) {
+    g_assert(tx != NULL);
+    g_assert(rx != NULL);
+    g_assert(binc_characteristic_supports_write(tx, WITH_RESPONSE) ||
+             binc_characteristic_supports_write(tx, WITHOUT_RESPONSE));
+    g_assert(binc_characteristic_supports_notify(rx));
+
+    StreamChannel *channel = g_new0(StreamChannel, 1);
+    channel->device = binc_characteristic_get_device(tx);
+    channel->tx = tx;
+    channel->rx = rx;
+    channel->connection = binc_device_get_dbus_connection(channel->device);
+    channel->framed = framed;
+    channel->write_type = binc_characteristic_supports_write(tx, WITHOUT_RESPONSE) ? WITHOUT_RESPONSE : WITH_RESPONSE;
+    channel->tx_buffer = binc_ring_buffer_create(buffer_size > 0 ? buffer_size : DEFAULT_BUFFER_SIZE);
+    channel->rx_buffer = binc_ring_buffer_create(buffer_size > 0 ? buffer_size : DEFAULT_BUFFER_SIZE);
+    channel->credits = DEFAULT_CREDITS;
+
+    binc_characteristic_set_notify_listener(rx, on_rx_notify, on_rx_detached, channel);
+    if (!binc_characteristic_is_notifying(rx)) {
+        binc_characteristic_start_notify(rx);
+    }
+    return channel;
+}
+
+void binc_stream_channel_free(StreamChannel *channel) {
+    g_assert(channel != NULL);
+
+    if (channel->rx != NULL) {
+        binc_characteristic_set_notify_listener(channel->rx, NULL, NULL, NULL);
+    }
+    channel->closed = TRUE;
+    free_if_closed(channel);
+}
+
+gsize binc_stream_channel_write(StreamChannel *channel, const guint8 *data, gsize length) {
+    g_assert(channel != NULL);
+    g_assert(data != NULL || length == 0);
+    g_assert(!channel->closed);
+
+    gsize accepted;
+    if (channel->framed) {
+        if (length > G_MAXUINT16 || FRAME_HEADER_SIZE + length > binc_ring_buffer_get_free(channel->tx_buffer)) {
+            return 0;
+        }
+
+        guint8 header[] = {(guint8) (length & 0xFF), (guint8) (length >> 8)};
+        binc_ring_buffer_write(channel->tx_buffer, header, sizeof(header));
+        accepted = binc_ring_buffer_write(channel->tx_buffer, data, length);
+    } else {
+        accepted = binc_ring_buffer_write(channel->tx_buffer, data, length);
+    }
+
+    send_next(channel);
+    return accepted;
+}
+
+void binc_stream_channel_set_credits(StreamChannel *channel, guint credits) {
+    g_assert(channel != NULL);
+    g_assert(credits > 0);
+
+    channel->credits = credits;
+    send_next(channel);
+}
+
+gsize binc_stream_channel_get_pending(const StreamChannel *channel) {
+    g_assert(channel != NULL);
+    return binc_ring_buffer_get_length(channel->tx_buffer);
+}
+
+void binc_stream_channel_set_receive_cb(StreamChannel *channel, StreamChannelReceiveCallback callback) {
+    g_assert(channel != NULL);
+    channel->receive_callback = callback;
+}
+
+void binc_stream_channel_set_drained_cb(StreamChannel *channel, StreamChannelDrainedCallback callback) {
+    g_assert(channel != NULL);
+    channel->drained_callback = callback;
+}
+
+void binc_stream_channel_set_error_cb(StreamChannel *channel, StreamChannelErrorCallback callback) {
+    g_assert(channel != NULL);
+    channel->error_callback = callback;
+}
+
+Device *binc_stream_channel_get_device(const StreamChannel *channel) {
+    g_assert(channel != NULL);
+    return channel->device;
+}
+
+void binc_stream_channel_set_user_data(StreamChannel *channel, void *user_data) {
+    g_assert(channel != NULL);
+    channel->user_data = user_data;
+}
+
+void *binc_stream_channel_get_user_data(const StreamChannel *channel) {
+    g_assert(channel != NULL);
+    return channel->user_data;
+}
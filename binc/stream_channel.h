@@ -0,0 +1,105 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_STREAM_CHANNEL_H
+#define BINC_STREAM_CHANNEL_H
+
+#include <glib.h>
+#include "forward_decl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Called for received data. In framed mode data is one complete frame, otherwise it is all data received so far.
+ * The data is borrowed from the receive buffer and only valid during the callback.
+ */
+typedef void (*StreamChannelReceiveCallback)(StreamChannel *channel, const guint8 *data, gsize length);
+
+// Called when all written data has been sent
+typedef void (*StreamChannelDrainedCallback)(StreamChannel *channel);
+
+/**
+ * Called when a chunk could not be written, received data didn't fit the receive buffer (G_IO_ERROR_NO_SPACE) or
+ * the device disconnected (G_IO_ERROR_CLOSED). The channel stops sending and receiving, so neither side sees a
+ * corrupted stream
+ */
+typedef void (*StreamChannelErrorCallback)(StreamChannel *channel, const GError *error);
+
+/**
+ * Create a byte stream over a pair of characteristics, like the Nordic UART Service
+ *
+ * Data is written to the tx characteristic in chunks that fit the MTU, and notify is started on the rx
+ * characteristic. Notifications of rx are delivered to the channel instead of to the device's notify callback.
+ * In framed mode every message is preceded by its length as a 16 bit little endian integer, so the receiver
+ * gets complete messages.
+ *
+ * @param tx the characteristic to write to
+ * @param rx the characteristic to receive notifications from
+ * @param framed whether messages are length prefixed
+ * @param buffer_size the size of the send and receive buffers, 0 for the default of 4096 bytes
+ * @return the channel, free with binc_stream_channel_free()
+ */
+StreamChannel *binc_stream_channel_create(Characteristic *tx, Characteristic *rx, gboolean framed, gsize buffer_size);
+
+void binc_stream_channel_free(StreamChannel *channel);
+
+/**
+ * Queue data for sending
+ *
+ * In framed mode the data is one message that is either accepted completely or not at all.
+ *
+ * @return the number of bytes accepted, less than length if the send buffer is full
+ */
+gsize binc_stream_channel_write(StreamChannel *channel, const guint8 *data, gsize length);
+
+/**
+ * Set the number of writes that may be waiting for a reply at the same time
+ *
+ * A write returns its credit when bluetoothd replies, which paces the channel to what the link can handle.
+ *
+ * @param channel the channel
+ * @param credits the number of credits, 4 by default
+ */
+void binc_stream_channel_set_credits(StreamChannel *channel, guint credits);
+
+gsize binc_stream_channel_get_pending(const StreamChannel *channel);
+
+void binc_stream_channel_set_receive_cb(StreamChannel *channel, StreamChannelReceiveCallback callback);
+
+void binc_stream_channel_set_drained_cb(StreamChannel *channel, StreamChannelDrainedCallback callback);
+
+void binc_stream_channel_set_error_cb(StreamChannel *channel, StreamChannelErrorCallback callback);
+
+Device *binc_stream_channel_get_device(const StreamChannel *channel);
+
+void binc_stream_channel_set_user_data(StreamChannel *channel, void *user_data);
+
+void *binc_stream_channel_get_user_data(const StreamChannel *channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_STREAM_CHANNEL_H
@@ -0,0 +1,106 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+/*
+ * Measures the per-event cost of the library itself by feeding synthetic Bluez events through the
+ * loopback transport, so neither D-Bus nor bluetoothd is involved.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include "adapter.h"
+#include "logger.h"
+#include "loopback.h"
+
+#define ADAPTER_PATH "/org/bluez/hci0"
+#define DEVICE_COUNT 2000
+#define RSSI_UPDATES_PER_DEVICE 25
+
+static guint64 discovery_results = 0;
+
+static void on_scan_result(Adapter *adapter, Device *device) {
+    discovery_results++;
+}
+
+static void run_pending_events(void) {
+    while (g_main_context_pending(NULL)) {
+        g_main_context_iteration(NULL, FALSE);
+    }
+}
+
+static void report(const char *name, guint count, gint64 start) {
+    gint64 elapsed = g_get_monotonic_time() - start;
+    printf("%-20s %8u events in %8.2f ms, %8.0f ns/event\n", name, count, (double) elapsed / 1000.0,
+           (double) elapsed * 1000.0 / (double) count);
+}
+
+int main(void) {
+    log_enabled(FALSE);
+
+    GDBusConnection *connection = binc_loopback_enable();
+    binc_loopback_add_adapter(ADAPTER_PATH, "00:11:22:33:44:55");
+
+    Adapter *adapter = binc_adapter_get_default(connection);
+    g_assert(adapter != NULL);
+    binc_adapter_set_discovery_cb(adapter, &on_scan_result);
+    binc_adapter_start_discovery(adapter);
+
+    GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(builder, "{sv}", "Discovering", g_variant_new_boolean(TRUE));
+    binc_loopback_properties_changed(ADAPTER_PATH, "org.bluez.Adapter1", g_variant_builder_end(builder));
+    g_variant_builder_unref(builder);
+    run_pending_events();
+
+    // Devices appearing
+    GPtrArray *device_paths = g_ptr_array_new_with_free_func(g_free);
+    gint64 start = g_get_monotonic_time();
+    for (guint i = 0; i < DEVICE_COUNT; i++) {
+        char *address = g_strdup_printf("C0:00:00:00:%02X:%02X", (i >> 8) & 0xFF, i & 0xFF);
+        g_ptr_array_add(device_paths, binc_loopback_device_appeared(ADAPTER_PATH, address, -60));
+        g_free(address);
+    }
+    run_pending_events();
+    report("device appeared", DEVICE_COUNT, start);
+
+    // Advertising updates of known devices
+    start = g_get_monotonic_time();
+    for (guint round = 0; round < RSSI_UPDATES_PER_DEVICE; round++) {
+        for (guint i = 0; i < device_paths->len; i++) {
+            GVariantBuilder *rssi_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+            g_variant_builder_add(rssi_builder, "{sv}", "RSSI", g_variant_new_int16((gint16) (-40 - (gint16) round)));
+            binc_loopback_properties_changed(g_ptr_array_index(device_paths, i), "org.bluez.Device1",
+                                             g_variant_builder_end(rssi_builder));
+            g_variant_builder_unref(rssi_builder);
+        }
+        run_pending_events();
+    }
+    report("rssi update", DEVICE_COUNT * RSSI_UPDATES_PER_DEVICE, start);
+
+    printf("%lu discovery results, %lu method calls\n", (unsigned long) discovery_results,
+           (unsigned long) binc_loopback_get_call_count());
+
+    g_ptr_array_free(device_paths, TRUE);
+    binc_adapter_free(adapter);
+    binc_loopback_disable();
+    return 0;
+}
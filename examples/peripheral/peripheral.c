@@ -59,6 +59,9 @@ void on_central_state_changed(Adapter *adapter, Device *device) {
     if (state == BINC_CONNECTED) {
         binc_adapter_stop_advertising(adapter, advertisement);
     } else if (state == BINC_DISCONNECTED){
+        if (app != NULL) {
+            binc_application_remove_central(app, binc_device_get_address(device));
+        }
         binc_adapter_start_advertising(adapter, advertisement);
     }
 }